@@ -44,6 +44,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/avstring.h"
 #include "libavutil/libm.h"
+#include "libavutil/timer.h"
 #include "libavformat/os_support.h"
 
 #include "libavformat/ffm.h" // not public API
@@ -56,6 +57,10 @@
 # include "libavfilter/vsrc_buffer.h"
 #endif
 
+#if HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
+
 #if HAVE_SYS_RESOURCE_H
 #include <sys/types.h>
 #include <sys/time.h>
@@ -72,6 +77,11 @@
 #include <sys/select.h>
 #endif
 
+#if HAVE_FORK
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
+
 #if HAVE_TERMIOS_H
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -112,6 +122,8 @@ typedef struct ChapterMap {
 } ChapterMap;
 
 static const OptionDef options[];
+static int64_t getcputime(void);
+static int64_t getthreadcputime(void);
 
 #define MAX_FILES 100
 #define MAX_STREAMS 1024    /* arbitrary sanity check value */
@@ -167,6 +179,7 @@ static int loop_output = AVFMT_NOOUTPUTLOOP;
 static int qp_hist = 0;
 #if CONFIG_AVFILTER
 static char *vfilters = NULL;
+static int filter_threads = 1;
 #endif
 
 static int intra_only = 0;
@@ -197,11 +210,16 @@ static int64_t input_ts_offset = 0;
 static int file_overwrite = 0;
 static AVDictionary *metadata;
 static int do_benchmark = 0;
+static int do_timer_probes = 0;
+static char *benchmark_stages_filename = NULL;
+static FILE *benchmark_stages_file;
+static float benchmark_stages_interval = 5;
 static int do_hex_dump = 0;
 static int do_pkt_dump = 0;
 static int do_psnr = 0;
 static int do_pass = 0;
 static const char *pass_logfilename_prefix;
+static int pass_segments = 0;
 static int audio_stream_copy = 0;
 static int video_stream_copy = 0;
 static int subtitle_stream_copy = 0;
@@ -216,6 +234,7 @@ static char *vstats_filename;
 static FILE *vstats_file;
 static int opt_programid = 0;
 static int copy_initial_nonkeyframes = 0;
+static int slice_output = 0;
 
 static int rate_emu = 0;
 
@@ -226,6 +245,7 @@ static int using_stdin = 0;
 static int verbose = 1;
 static int run_as_daemon  = 0;
 static int thread_count= 1;
+static int thread_pool_size = 0;
 static int q_pressed = 0;
 static int64_t video_size = 0;
 static int64_t audio_size = 0;
@@ -253,6 +273,19 @@ static AVBitStreamFilterContext *subtitle_bitstream_filters=NULL;
 
 #define DEFAULT_PASS_LOGFILENAME_PREFIX "ffmpeg2pass"
 
+/* accumulated cost of one processing stage, see -benchmark_stages */
+typedef struct StageTimer {
+    int64_t wall;            /* wall clock time spent in the stage, in us */
+    int64_t cpu;             /* process CPU time (user+sys) spent in the stage, in us */
+    int64_t calls;
+    int64_t start_wall;
+    int64_t start_cpu;
+} StageTimer;
+
+static StageTimer bench_demux;
+static StageTimer bench_mux;
+static StageTimer bench_sleep;
+
 struct InputStream;
 
 typedef struct OutputStream {
@@ -282,6 +315,7 @@ typedef struct OutputStream {
     float frame_aspect_ratio;
 
     /* forced key frames */
+    char *forced_keyframes;
     int64_t *forced_kf_pts;
     int forced_kf_count;
     int forced_kf_index;
@@ -307,6 +341,17 @@ typedef struct OutputStream {
 
    int sws_flags;
    AVDictionary *opts;
+
+   StageTimer bench_filter;
+#if !CONFIG_AVFILTER
+   StageTimer bench_scale;
+#endif
+   StageTimer bench_encode;
+
+   /* slice output, bytes of the current frame in bit_buffer which were
+      written as partial packets, and size of the last slice */
+   int slice_sent;
+   int slice_pending;
 } OutputStream;
 
 static OutputStream **output_streams_for_file[MAX_FILES] = { NULL };
@@ -328,6 +373,8 @@ typedef struct InputStream {
     int showed_multi_packet_warning;
     int is_past_recording_time;
     AVDictionary *opts;
+
+    StageTimer bench_decode;
 } InputStream;
 
 typedef struct InputFile {
@@ -364,6 +411,7 @@ static int configure_video_filters(InputStream *ist, OutputStream *ost)
     int ret;
 
     ost->graph = avfilter_graph_alloc();
+    ost->graph->nb_threads = filter_threads;
 
     if (ist->st->sample_aspect_ratio.num){
         sample_aspect_ratio = ist->st->sample_aspect_ratio;
@@ -542,6 +590,9 @@ static int ffmpeg_exit(int ret)
     for (i = 0; i < nb_input_streams; i++)
         av_dict_free(&input_streams[i].opts);
 
+    if (thread_pool_size)
+        avcodec_thread_pool_uninit();
+
     av_free(intra_matrix);
     av_free(inter_matrix);
 
@@ -549,6 +600,10 @@ static int ffmpeg_exit(int ret)
         fclose(vstats_file);
     av_free(vstats_filename);
 
+    if (benchmark_stages_file && benchmark_stages_file != stderr)
+        fclose(benchmark_stages_file);
+    av_free(benchmark_stages_filename);
+
     av_free(streamid_map);
     av_free(stream_maps);
     av_free(meta_data_maps);
@@ -783,6 +838,23 @@ get_sync_ipts(const OutputStream *ost)
     return (double)(ist->pts - start_time)/AV_TIME_BASE;
 }
 
+static void stage_start(StageTimer *t)
+{
+    if (!benchmark_stages_file)
+        return;
+    t->start_wall = av_gettime();
+    t->start_cpu  = getthreadcputime();
+}
+
+static void stage_stop(StageTimer *t)
+{
+    if (!benchmark_stages_file)
+        return;
+    t->wall += av_gettime() - t->start_wall;
+    t->cpu  += getthreadcputime() - t->start_cpu;
+    t->calls++;
+}
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx, AVBitStreamFilterContext *bsfc){
     int ret;
 
@@ -808,7 +880,9 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
         bsfc= bsfc->next;
     }
 
+    stage_start(&bench_mux);
     ret= av_interleaved_write_frame(s, pkt);
+    stage_stop(&bench_mux);
     if(ret < 0){
         print_error("av_interleaved_write_frame()", ret);
         ffmpeg_exit(1);
@@ -1009,8 +1083,10 @@ need_realloc:
 
             //FIXME pass ost->sync_opts as AVFrame.pts in avcodec_encode_audio()
 
+            stage_start(&ost->bench_encode);
             ret = avcodec_encode_audio(enc, audio_out, audio_out_size,
                                        (short *)audio_buf);
+            stage_stop(&ost->bench_encode);
             if (ret < 0) {
                 fprintf(stderr, "Audio encoding failed\n");
                 ffmpeg_exit(1);
@@ -1044,8 +1120,10 @@ need_realloc:
         }
 
         //FIXME pass ost->sync_opts as AVFrame.pts in avcodec_encode_audio()
+        stage_start(&ost->bench_encode);
         ret = avcodec_encode_audio(enc, audio_out, size_out,
                                    (short *)buftmp);
+        stage_stop(&ost->bench_encode);
         if (ret < 0) {
             fprintf(stderr, "Audio encoding failed\n");
             ffmpeg_exit(1);
@@ -1142,8 +1220,10 @@ static void do_subtitle_out(AVFormatContext *s,
         sub->pts              += av_rescale_q(sub->start_display_time, (AVRational){1, 1000}, AV_TIME_BASE_Q);
         sub->end_display_time -= sub->start_display_time;
         sub->start_display_time = 0;
+        stage_start(&ost->bench_encode);
         subtitle_out_size = avcodec_encode_subtitle(enc, subtitle_out,
                                                     subtitle_out_max_size, sub);
+        stage_stop(&ost->bench_encode);
         if (subtitle_out_size < 0) {
             fprintf(stderr, "Subtitle encoding failed\n");
             ffmpeg_exit(1);
@@ -1169,6 +1249,33 @@ static void do_subtitle_out(AVFormatContext *s,
 static int bit_buffer_size= 1024*256;
 static uint8_t *bit_buffer= NULL;
 
+/* Called by the encoder for each finished slice, the slices are written as
+ * partial packets. The last one is held back until the encoder returns, so
+ * that the final packet of the frame is never empty. */
+static void slice_output_callback(AVCodecContext *enc, void *data, int size, int mb_nb)
+{
+    OutputStream *ost = enc->opaque;
+    AVPacket pkt;
+
+    if (!size)
+        return;
+
+    if (ost->slice_pending) {
+        av_init_packet(&pkt);
+        pkt.stream_index = ost->index;
+        pkt.data  = bit_buffer + ost->slice_sent;
+        pkt.size  = ost->slice_pending;
+        pkt.flags = AV_PKT_FLAG_PARTIAL;
+        if (enc->coded_frame->pts != AV_NOPTS_VALUE)
+            pkt.pts = av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
+        if (enc->coded_frame->key_frame)
+            pkt.flags |= AV_PKT_FLAG_KEY;
+        write_frame(output_files[ost->file_index], &pkt, enc, NULL);
+        ost->slice_sent += ost->slice_pending;
+    }
+    ost->slice_pending = size;
+}
+
 static void do_video_out(AVFormatContext *s,
                          OutputStream *ost,
                          InputStream *ist,
@@ -1264,8 +1371,10 @@ static void do_video_out(AVFormatContext *s,
                 ffmpeg_exit(1);
             }
         }
+        stage_start(&ost->bench_scale);
         sws_scale(ost->img_resample_ctx, formatted_picture->data, formatted_picture->linesize,
               0, ost->resample_height, final_picture->data, final_picture->linesize);
+        stage_stop(&ost->bench_scale);
     }
 #endif
 
@@ -1316,17 +1425,19 @@ static void do_video_out(AVFormatContext *s,
                 big_picture.pict_type = AV_PICTURE_TYPE_I;
                 ost->forced_kf_index++;
             }
+            stage_start(&ost->bench_encode);
             ret = avcodec_encode_video(enc,
                                        bit_buffer, bit_buffer_size,
                                        &big_picture);
+            stage_stop(&ost->bench_encode);
             if (ret < 0) {
                 fprintf(stderr, "Video encoding failed\n");
                 ffmpeg_exit(1);
             }
 
             if(ret>0){
-                pkt.data= bit_buffer;
-                pkt.size= ret;
+                pkt.data= bit_buffer + ost->slice_sent;
+                pkt.size= ret - ost->slice_sent;
                 if(enc->coded_frame->pts != AV_NOPTS_VALUE)
                     pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
 /*av_log(NULL, AV_LOG_DEBUG, "encoder -> %"PRId64"/%"PRId64"\n",
@@ -1336,6 +1447,7 @@ static void do_video_out(AVFormatContext *s,
                 if(enc->coded_frame->key_frame)
                     pkt.flags |= AV_PKT_FLAG_KEY;
                 write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
+                ost->slice_sent = ost->slice_pending = 0;
                 *frame_size = ret;
                 video_size += ret;
                 //fprintf(stderr,"\nFrame: %3d size: %5d type: %d",
@@ -1523,6 +1635,94 @@ static void print_report(AVFormatContext **output_files,
     }
 }
 
+static void print_stage_timer(const char *name, const StageTimer *t)
+{
+    /* time not accounted as CPU is spent waiting, e.g. blocked on I/O */
+    fprintf(benchmark_stages_file,
+            "\"%s\":{\"calls\":%"PRId64",\"wall_us\":%"PRId64",\"cpu_us\":%"PRId64",\"wait_us\":%"PRId64"}",
+            name, t->calls, t->wall, t->cpu, FFMAX(t->wall - t->cpu, 0));
+}
+
+static int count_packets(AVPacketList *pktl)
+{
+    int n = 0;
+    for (; pktl; pktl = pktl->next)
+        n++;
+    return n;
+}
+
+/**
+ * Write the accumulated per-stage timings and queue occupancies as one
+ * line of JSON to the -benchmark_stages file.
+ */
+static void print_stage_report(OutputStream **ost_table, int nb_ostreams,
+                               int is_last_report)
+{
+    static int64_t last_time = -1;
+    int64_t cur_time = av_gettime();
+    int i;
+
+    if (!benchmark_stages_file)
+        return;
+    if (!is_last_report) {
+        if (last_time == -1)
+            last_time = cur_time;
+        if (cur_time - last_time < benchmark_stages_interval * 1000000)
+            return;
+        last_time = cur_time;
+    }
+
+    fprintf(benchmark_stages_file, "{\"final\":%d,\"time_us\":%"PRId64",\"cpu_us\":%"PRId64",",
+            is_last_report, cur_time - timer_start, getcputime());
+    print_stage_timer("demux", &bench_demux);
+    fprintf(benchmark_stages_file, ",");
+    print_stage_timer("mux", &bench_mux);
+    fprintf(benchmark_stages_file, ",");
+    print_stage_timer("sleep", &bench_sleep);
+
+    fprintf(benchmark_stages_file, ",\"input_files\":[");
+    for (i = 0; i < nb_input_files; i++)
+        fprintf(benchmark_stages_file, "%s{\"index\":%d,\"queued_packets\":%d}",
+                i ? "," : "", i, count_packets(input_files[i].ctx->packet_buffer));
+
+    fprintf(benchmark_stages_file, "],\"output_files\":[");
+    for (i = 0; i < nb_output_files; i++) {
+        AVFormatContext *os = output_files[i];
+        int j, queued = count_packets(os->packet_buffer);
+        for (j = 0; j < os->nb_streams; j++)
+            queued += count_packets(os->streams[j]->first_in_packet_buffer);
+        fprintf(benchmark_stages_file, "%s{\"index\":%d,\"queued_packets\":%d}",
+                i ? "," : "", i, queued);
+    }
+
+    fprintf(benchmark_stages_file, "],\"input_streams\":[");
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = &input_streams[i];
+        fprintf(benchmark_stages_file, "%s{\"file\":%d,\"stream\":%d,",
+                i ? "," : "", ist->file_index, ist->st->index);
+        print_stage_timer("decode", &ist->bench_decode);
+        fprintf(benchmark_stages_file, "}");
+    }
+
+    fprintf(benchmark_stages_file, "],\"output_streams\":[");
+    for (i = 0; i < nb_ostreams; i++) {
+        OutputStream *ost = ost_table[i];
+        fprintf(benchmark_stages_file, "%s{\"file\":%d,\"stream\":%d,",
+                i ? "," : "", ost->file_index, ost->index);
+        print_stage_timer("filter", &ost->bench_filter);
+        fprintf(benchmark_stages_file, ",");
+#if !CONFIG_AVFILTER
+        print_stage_timer("scale", &ost->bench_scale);
+        fprintf(benchmark_stages_file, ",");
+#endif
+        print_stage_timer("encode", &ost->bench_encode);
+        fprintf(benchmark_stages_file, ",\"fifo_bytes\":%d}",
+                ost->fifo ? av_fifo_size(ost->fifo) : 0);
+    }
+    fprintf(benchmark_stages_file, "]}\n");
+    fflush(benchmark_stages_file);
+}
+
 static void generate_silence(uint8_t* buf, enum AVSampleFormat sample_fmt, size_t size)
 {
     int fill_char = 0x00;
@@ -1601,8 +1801,10 @@ static int output_packet(InputStream *ist, int ist_index,
                 decoded_data_size= samples_size;
                     /* XXX: could avoid copy if PCM 16 bits with same
                        endianness as CPU */
+                stage_start(&ist->bench_decode);
                 ret = avcodec_decode_audio3(ist->st->codec, samples, &decoded_data_size,
                                             &avpkt);
+                stage_stop(&ist->bench_decode);
                 if (ret < 0)
                     return ret;
                 avpkt.data += ret;
@@ -1627,8 +1829,10 @@ static int output_packet(InputStream *ist, int ist_index,
                     avpkt.dts = ist->pts;
                     pkt_pts = AV_NOPTS_VALUE;
 
+                    stage_start(&ist->bench_decode);
                     ret = avcodec_decode_video2(ist->st->codec,
                                                 &picture, &got_output, &avpkt);
+                    stage_stop(&ist->bench_decode);
                     quality = same_quality ? picture.quality : 0;
                     if (ret < 0)
                         return ret;
@@ -1648,8 +1852,10 @@ static int output_packet(InputStream *ist, int ist_index,
                     pre_process_video_frame(ist, (AVPicture *)&picture, &buffer_to_free);
                     break;
             case AVMEDIA_TYPE_SUBTITLE:
+                stage_start(&ist->bench_decode);
                 ret = avcodec_decode_subtitle2(ist->st->codec,
                                                &subtitle, &got_output, &avpkt);
+                stage_stop(&ist->bench_decode);
                 if (ret < 0)
                     return ret;
                 if (!got_output) {
@@ -1690,7 +1896,9 @@ static int output_packet(InputStream *ist, int ist_index,
                         picture.sample_aspect_ratio = ist->st->sample_aspect_ratio;
                     picture.pts = ist->pts;
 
+                    stage_start(&ost->bench_filter);
                     av_vsrc_buffer_add_frame(ost->input_video_filter, &picture, AV_VSRC_BUF_FLAG_OVERWRITE);
+                    stage_stop(&ost->bench_filter);
                 }
             }
         }
@@ -1714,8 +1922,11 @@ static int output_packet(InputStream *ist, int ist_index,
         if (rate_emu) {
             int64_t pts = av_rescale(ist->pts, 1000000, AV_TIME_BASE);
             int64_t now = av_gettime() - ist->start;
-            if (pts > now)
+            if (pts > now) {
+                stage_start(&bench_sleep);
                 usleep(pts - now);
+                stage_stop(&bench_sleep);
+            }
         }
         /* if output time reached then transcode raw format,
            encode packets and output them */
@@ -1731,7 +1942,10 @@ static int output_packet(InputStream *ist, int ist_index,
                 while (frame_available) {
                     if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO && ost->output_video_filter) {
                         AVRational ist_pts_tb = ost->output_video_filter->inputs[0]->time_base;
-                        if (av_vsink_buffer_get_video_buffer_ref(ost->output_video_filter, &ost->picref, 0) < 0)
+                        stage_start(&ost->bench_filter);
+                        ret = av_vsink_buffer_get_video_buffer_ref(ost->output_video_filter, &ost->picref, 0);
+                        stage_stop(&ost->bench_filter);
+                        if (ret < 0)
                             goto cont;
                         if (ost->picref) {
                             avfilter_fill_frame_from_video_buffer_ref(&picture, ost->picref);
@@ -1893,13 +2107,17 @@ static int output_packet(InputStream *ist, int ist_index,
                                     generate_silence(audio_buf+fifo_bytes, enc->sample_fmt, frame_bytes - fifo_bytes);
                                 }
 
+                                stage_start(&ost->bench_encode);
                                 ret = avcodec_encode_audio(enc, bit_buffer, bit_buffer_size, (short *)audio_buf);
+                                stage_stop(&ost->bench_encode);
                                 pkt.duration = av_rescale((int64_t)enc->frame_size*ost->st->time_base.den,
                                                           ost->st->time_base.num, enc->sample_rate);
                                 enc->frame_size = fs_tmp;
                             }
                             if(ret <= 0) {
+                                stage_start(&ost->bench_encode);
                                 ret = avcodec_encode_audio(enc, bit_buffer, bit_buffer_size, NULL);
+                                stage_stop(&ost->bench_encode);
                             }
                             if (ret < 0) {
                                 fprintf(stderr, "Audio encoding failed\n");
@@ -1909,7 +2127,9 @@ static int output_packet(InputStream *ist, int ist_index,
                             pkt.flags |= AV_PKT_FLAG_KEY;
                             break;
                         case AVMEDIA_TYPE_VIDEO:
+                            stage_start(&ost->bench_encode);
                             ret = avcodec_encode_video(enc, bit_buffer, bit_buffer_size, NULL);
+                            stage_stop(&ost->bench_encode);
                             if (ret < 0) {
                                 fprintf(stderr, "Video encoding failed\n");
                                 ffmpeg_exit(1);
@@ -1927,11 +2147,12 @@ static int output_packet(InputStream *ist, int ist_index,
 
                         if(ret<=0)
                             break;
-                        pkt.data= bit_buffer;
-                        pkt.size= ret;
+                        pkt.data= bit_buffer + ost->slice_sent;
+                        pkt.size= ret - ost->slice_sent;
                         if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
                             pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
                         write_frame(os, &pkt, ost->st->codec, ost->bitstream_filters);
+                        ost->slice_sent = ost->slice_pending = 0;
                     }
                 }
             }
@@ -2360,6 +2581,8 @@ static int transcode(AVFormatContext **output_files,
                     ost->frame_rate = ost->enc->supported_framerates[idx];
                 }
                 codec->time_base = (AVRational){ost->frame_rate.den, ost->frame_rate.num};
+                if (ost->forced_keyframes)
+                    parse_forced_key_frames(ost->forced_keyframes, ost, codec);
                 if(   av_q2d(codec->time_base) < 0.001 && video_sync_method
                    && (video_sync_method==1 || (video_sync_method<0 && !(os->oformat->flags & AVFMT_VARIABLE_FPS)))){
                     av_log(os, AV_LOG_WARNING, "Frame rate very high for a muxer not effciciently supporting it.\n"
@@ -2445,6 +2668,18 @@ static int transcode(AVFormatContext **output_files,
                 memcpy(ost->st->codec->subtitle_header, dec->subtitle_header, dec->subtitle_header_size);
                 ost->st->codec->subtitle_header_size = dec->subtitle_header_size;
             }
+            if (slice_output && ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+                AVFormatContext *os = output_files[ost->file_index];
+                if (!(os->oformat->flags & AVFMT_ALLOW_PARTIAL) || ost->bitstream_filters) {
+                    snprintf(error, sizeof(error), "Slice output is not supported for output stream #%d.%d, "
+                             "the %s muxer does not accept partial packets or bitstream filters are used",
+                             ost->file_index, ost->index, os->oformat->name);
+                    ret = AVERROR(EINVAL);
+                    goto dump_format;
+                }
+                ost->st->codec->rtp_callback = slice_output_callback;
+                ost->st->codec->opaque       = ost;
+            }
             if (avcodec_open2(ost->st->codec, codec, &ost->opts) < 0) {
                 snprintf(error, sizeof(error), "Error while opening encoder for output stream #%d.%d - maybe incorrect parameters such as bit_rate, rate, width or height",
                         ost->file_index, ost->index);
@@ -2642,6 +2877,17 @@ static int transcode(AVFormatContext **output_files,
 
     timer_start = av_gettime();
 
+    if (benchmark_stages_filename) {
+        if (!strcmp(benchmark_stages_filename, "-"))
+            benchmark_stages_file = stderr;
+        else
+            benchmark_stages_file = fopen(benchmark_stages_filename, "w");
+        if (!benchmark_stages_file) {
+            perror(benchmark_stages_filename);
+            ffmpeg_exit(1);
+        }
+    }
+
     for(; received_sigterm == 0;) {
         int file_index, ist_index;
         AVPacket pkt;
@@ -2735,7 +2981,9 @@ static int transcode(AVFormatContext **output_files,
             if(no_packet_count){
                 no_packet_count=0;
                 memset(no_packet, 0, sizeof(no_packet));
+                stage_start(&bench_sleep);
                 usleep(10000);
+                stage_stop(&bench_sleep);
                 continue;
             }
             break;
@@ -2747,7 +2995,9 @@ static int transcode(AVFormatContext **output_files,
 
         /* read a frame from it and output it in the fifo */
         is = input_files[file_index].ctx;
+        stage_start(&bench_demux);
         ret= av_read_frame(is, &pkt);
+        stage_stop(&bench_demux);
         if(ret == AVERROR(EAGAIN)){
             no_packet[file_index]=1;
             no_packet_count++;
@@ -2833,6 +3083,7 @@ static int transcode(AVFormatContext **output_files,
 
         /* dump report by using the output first video and audio streams */
         print_report(output_files, ost_table, nb_ostreams, 0);
+        print_stage_report(ost_table, nb_ostreams, 0);
     }
 
     /* at the end of stream, we must flush the decoder buffers */
@@ -2853,6 +3104,7 @@ static int transcode(AVFormatContext **output_files,
 
     /* dump report by using the first video and audio streams */
     print_report(output_files, ost_table, nb_ostreams, 1);
+    print_stage_report(ost_table, nb_ostreams, 1);
 
     /* close each encoder */
     for(i=0;i<nb_ostreams;i++) {
@@ -2895,6 +3147,7 @@ static int transcode(AVFormatContext **output_files,
                 av_freep(&ost->st->codec->subtitle_header);
                 av_free(ost->resample_frame.data[0]);
                 av_free(ost->forced_kf_pts);
+                av_free(ost->forced_keyframes);
                 if (ost->video_resample)
                     sws_freeContext(ost->img_resample_ctx);
                 if (ost->resample)
@@ -3674,8 +3927,9 @@ static void new_video_stream(AVFormatContext *oc, int file_idx)
             }
         }
 
-        if (forced_key_frames)
-            parse_forced_key_frames(forced_key_frames, ost, video_enc);
+        /* the timestamps are parsed when the encoder time base is known */
+        ost->forced_keyframes = forced_key_frames;
+        forced_key_frames = NULL;
     }
     if (video_language) {
         av_dict_set(&st->metadata, "language", video_language, 0);
@@ -4024,6 +4278,47 @@ static int64_t getutime(void)
 #endif
 }
 
+static int64_t getcputime(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return (rusage.ru_utime.tv_sec + rusage.ru_stime.tv_sec) * 1000000LL +
+            rusage.ru_utime.tv_usec + rusage.ru_stime.tv_usec;
+#elif HAVE_GETPROCESSTIMES
+    HANDLE proc;
+    FILETIME c, e, k, u;
+    proc = GetCurrentProcess();
+    GetProcessTimes(proc, &c, &e, &k, &u);
+    return (((int64_t) u.dwHighDateTime << 32 | u.dwLowDateTime) +
+            ((int64_t) k.dwHighDateTime << 32 | k.dwLowDateTime)) / 10;
+#else
+    return av_gettime();
+#endif
+}
+
+/**
+ * CPU time of the calling thread, so that stage timers do not count the
+ * work done concurrently by codec and filter worker threads.
+ */
+static int64_t getthreadcputime(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+#elif HAVE_GETPROCESSTIMES
+    FILETIME c, e, k, u;
+
+    if (GetThreadTimes(GetCurrentThread(), &c, &e, &k, &u))
+        return (((int64_t) u.dwHighDateTime << 32 | u.dwLowDateTime) +
+                ((int64_t) k.dwHighDateTime << 32 | k.dwLowDateTime)) / 10;
+#endif
+    return getcputime();
+}
+
 static int64_t getmaxrss(void)
 {
 #if HAVE_GETRUSAGE && HAVE_STRUCT_RUSAGE_RU_MAXRSS
@@ -4407,6 +4702,12 @@ static const OptionDef options[] = {
     { "dframes", OPT_INT | HAS_ARG, {(void*)&max_frames[AVMEDIA_TYPE_DATA]}, "set the number of data frames to record", "number" },
     { "benchmark", OPT_BOOL | OPT_EXPERT, {(void*)&do_benchmark},
       "add timings for benchmarking" },
+    { "timer_probes", OPT_BOOL | OPT_EXPERT, {(void*)&do_timer_probes},
+      "enable the cycle counting probes and print their statistics at the end" },
+    { "benchmark_stages", HAS_ARG | OPT_STRING | OPT_EXPERT, {(void*)&benchmark_stages_filename},
+      "write per-stage timings as JSON lines to file ('-' for stderr)", "file" },
+    { "benchmark_stages_interval", HAS_ARG | OPT_FLOAT | OPT_EXPERT, {(void*)&benchmark_stages_interval},
+      "set the interval between -benchmark_stages reports in seconds", "seconds" },
     { "timelimit", HAS_ARG, {(void*)opt_timelimit}, "set max runtime in seconds", "limit" },
     { "dump", OPT_BOOL | OPT_EXPERT, {(void*)&do_pkt_dump},
       "dump each input packet" },
@@ -4418,6 +4719,7 @@ static const OptionDef options[] = {
     { "v", HAS_ARG, {(void*)opt_verbose}, "set ffmpeg verbosity level", "number" },
     { "target", HAS_ARG, {(void*)opt_target}, "specify target file type (\"vcd\", \"svcd\", \"dvd\", \"dv\", \"dv50\", \"pal-vcd\", \"ntsc-svcd\", ...)", "type" },
     { "threads",  HAS_ARG | OPT_EXPERT, {(void*)opt_thread_count}, "thread count", "count" },
+    { "thread_pool", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&thread_pool_size}, "share a pool of count threads between all slice threaded codecs", "count" },
     { "vsync", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&video_sync_method}, "video sync method", "" },
     { "async", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&audio_sync_method}, "audio sync method", "" },
     { "adrift_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT, {(void*)&audio_drift_threshold}, "audio drift threshold", "threshold" },
@@ -4456,6 +4758,7 @@ static const OptionDef options[] = {
       "use same quantizer as source (implies VBR)" },
     { "pass", HAS_ARG | OPT_VIDEO, {(void*)opt_pass}, "select the pass number (1 or 2)", "n" },
     { "passlogfile", HAS_ARG | OPT_VIDEO, {(void*)&opt_passlogfile}, "select two pass log file name prefix", "prefix" },
+    { "pass_segments", HAS_ARG | OPT_INT | OPT_VIDEO | OPT_EXPERT, {(void*)&pass_segments}, "run a two pass encode as n segments in parallel", "n" },
     { "deinterlace", OPT_BOOL | OPT_EXPERT | OPT_VIDEO, {(void*)&do_deinterlace},
       "deinterlace pictures" },
     { "psnr", OPT_BOOL | OPT_EXPERT | OPT_VIDEO, {(void*)&do_psnr}, "calculate PSNR of compressed frames" },
@@ -4463,6 +4766,7 @@ static const OptionDef options[] = {
     { "vstats_file", HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void*)opt_vstats_file}, "dump video coding statistics to file", "file" },
 #if CONFIG_AVFILTER
     { "vf", OPT_STRING | HAS_ARG, {(void*)&vfilters}, "video filters", "filter list" },
+    { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT | OPT_VIDEO, {(void*)&filter_threads}, "number of threads used by the video filters", "count" },
 #endif
     { "intra_matrix", HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void*)opt_intra_matrix}, "specify intra matrix coeffs", "matrix" },
     { "inter_matrix", HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void*)opt_inter_matrix}, "specify inter matrix coeffs", "matrix" },
@@ -4475,6 +4779,7 @@ static const OptionDef options[] = {
     { "force_fps", OPT_BOOL | OPT_EXPERT | OPT_VIDEO, {(void*)&force_fps}, "force the selected framerate, disable the best supported framerate selection" },
     { "streamid", HAS_ARG | OPT_EXPERT, {(void*)opt_streamid}, "set the value of an outfile streamid", "streamIndex:value" },
     { "force_key_frames", OPT_STRING | HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void *)&forced_key_frames}, "force key frames at specified timestamps", "timestamps" },
+    { "slice_output", OPT_BOOL | OPT_EXPERT | OPT_VIDEO, {(void*)&slice_output}, "write each encoded slice as soon as it is ready" },
 
     /* audio options */
     { "aframes", OPT_INT | HAS_ARG | OPT_AUDIO, {(void*)&max_frames[AVMEDIA_TYPE_AUDIO]}, "set the number of audio frames to record", "number" },
@@ -4520,6 +4825,502 @@ static const OptionDef options[] = {
     { NULL, },
 };
 
+/* parallel two pass encoding */
+
+#define MAX_SEGMENTS 64
+
+/* Both passes of a segment start this long before the segment, so that
+ * their rate control has settled when the segment starts, like in a single
+ * encode of the whole file. The frames before the segment are dropped. */
+#define SEGMENT_PREROLL (2 * AV_TIME_BASE)
+
+typedef struct Segment {
+    int64_t start;                  ///< start time in the output, in AV_TIME_BASE units
+    int64_t preroll_start;          ///< start time of the encode in the output, in AV_TIME_BASE units
+    int nb_frames;                  ///< number of video frames, 0 for the last segment
+    int first_frame;                ///< index of the first frame in the merged statistics
+    int preroll;                    ///< number of video frames encoded before the segment
+    char ss[32], t[32], frames[16], offset[16];
+    char preroll_ss[32], preroll_t[32], preroll_frames[16], preroll_kf[32];
+    char filename[1024];
+    char logprefix[1024];
+} Segment;
+
+typedef struct KeyFrame {
+    int64_t ts;
+    int frame;
+} KeyFrame;
+
+static void format_time(char *buf, int size, int64_t t)
+{
+    snprintf(buf, size, "%"PRId64".%06d", t / AV_TIME_BASE, (int)(t % AV_TIME_BASE));
+}
+
+/**
+ * Split the first input file into at most nb_segments segments of about the
+ * same number of video frames, each starting at a keyframe. The encode of
+ * each segment but the first starts at an earlier keyframe, at most
+ * SEGMENT_PREROLL and one segment before it.
+ * @return the number of segments
+ */
+static int find_segments(Segment *seg, int nb_segments)
+{
+    AVFormatContext *ic = input_files[0].ctx;
+    int64_t file_start = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    KeyFrame *keys = NULL;
+    AVStream *st = NULL;
+    AVPacket pkt;
+    int nb_keys = 0, nb_frames = 0, nb = 1, i, k, p, last = 0, last_key = 0;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        if (ic->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+            st = ic->streams[i];
+            break;
+        }
+    }
+    if (!st) {
+        fprintf(stderr, "-pass_segments needs a video stream in the first input file\n");
+        return AVERROR(EINVAL);
+    }
+
+    /* demuxing is cheap compared to encoding, read the whole file once */
+    while (av_read_frame(ic, &pkt) >= 0) {
+        if (pkt.stream_index == st->index) {
+            int64_t ts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+            if ((pkt.flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE) {
+                keys = grow_array(keys, sizeof(*keys), &nb_keys, nb_keys + 1);
+                keys[nb_keys - 1].ts    = av_rescale_rnd(ts, (int64_t)st->time_base.num * AV_TIME_BASE,
+                                                         st->time_base.den, AV_ROUND_DOWN);
+                keys[nb_keys - 1].frame = nb_frames;
+            }
+            nb_frames++;
+        }
+        av_free_packet(&pkt);
+    }
+
+    for (i = 1, k = 0; i < nb_segments; i++) {
+        int target = (int64_t)nb_frames * i / nb_segments;
+
+        while (k + 1 < nb_keys && FFABS(keys[k + 1].frame - target) <= FFABS(keys[k].frame - target))
+            k++;
+        if (k >= nb_keys || keys[k].frame <= last)
+            continue;
+        /* the segment is read from its keyframe on by seeking in the input,
+         * its output timestamps start at 0 */
+        seg[nb].start = keys[k].ts + input_files[0].ts_offset;
+        format_time(seg[nb].ss, sizeof(seg[nb].ss), keys[k].ts - file_start);
+        seg[nb - 1].nb_frames = keys[k].frame - last;
+
+        for (p = k; p > last_key && keys[k].ts - keys[p].ts < SEGMENT_PREROLL; p--);
+        seg[nb].preroll = keys[k].frame - keys[p].frame;
+        format_time(seg[nb].preroll_ss, sizeof(seg[nb].preroll_ss), keys[p].ts - file_start);
+        format_time(seg[nb].preroll_kf, sizeof(seg[nb].preroll_kf), keys[k].ts - keys[p].ts);
+        seg[nb].preroll_start = keys[p].ts + input_files[0].ts_offset;
+
+        last     = keys[k].frame;
+        last_key = k;
+        nb++;
+    }
+    av_free(keys);
+
+    for (i = 0; i + 1 < nb; i++) {
+        format_time(seg[i].t, sizeof(seg[i].t), seg[i + 1].start - seg[i].start);
+        snprintf(seg[i].frames, sizeof(seg[i].frames), "%d", seg[i].nb_frames);
+        format_time(seg[i].preroll_t, sizeof(seg[i].preroll_t), seg[i + 1].start - seg[i].preroll_start);
+        snprintf(seg[i].preroll_frames, sizeof(seg[i].preroll_frames), "%d", seg[i].preroll + seg[i].nb_frames);
+    }
+    return nb;
+}
+
+static void free_args(char **args)
+{
+    int i;
+
+    for (i = 0; args[i]; i++)
+        av_free(args[i]);
+    av_free(args);
+}
+
+/**
+ * Build the command line of one pass of one segment: the original one
+ * without -pass_segments, with the seek to the segment added before the
+ * first input file, and its length, the pass and the segment output file
+ * added before the output file name. Both passes start with the preroll
+ * of the segment, the first pass forces a keyframe where the segment starts
+ * and the second one reads the statistics of the preroll frames.
+ */
+static char **segment_args(int argc, char **argv, int out_index,
+                           Segment *seg, int pass, const char *logprefix)
+{
+    const char **args = av_mallocz((argc + 22) * sizeof(*args));
+    char **ret = NULL;
+    int preroll = seg->preroll;
+    int i, n = 0, seek = (preroll ? seg->preroll_start : seg->start) != 0;
+
+    if (!args)
+        return NULL;
+    args[n++] = argv[0];
+    args[n++] = "-v";
+    args[n++] = "-1";
+    args[n++] = "-loglevel";
+    args[n++] = "error";
+    args[n++] = "-y";
+    for (i = 1; i < out_index; i++) {
+        if (!strcmp(argv[i], "-pass_segments")) {
+            i++;
+            continue;
+        }
+        if (seek && !strcmp(argv[i], "-i")) {
+            args[n++] = "-ss";
+            args[n++] = preroll ? seg->preroll_ss : seg->ss;
+            seek = 0;
+        }
+        args[n++] = argv[i];
+    }
+    if (seg->nb_frames) {
+        args[n++] = "-vframes";
+        args[n++] = preroll ? seg->preroll_frames : seg->frames;
+        args[n++] = "-t";
+        args[n++] = preroll ? seg->preroll_t : seg->t;
+    }
+    if (pass == 1 && preroll) {
+        args[n++] = "-force_key_frames";
+        args[n++] = seg->preroll_kf;
+    }
+    args[n++] = "-pass";
+    args[n++] = pass == 1 ? "1" : "2";
+    args[n++] = "-passlogfile";
+    args[n++] = logprefix;
+    if (pass == 2 && seg->first_frame) {
+        snprintf(seg->offset, sizeof(seg->offset), "%d", seg->first_frame - seg->preroll);
+        args[n++] = "-rc_stats_offset";
+        args[n++] = seg->offset;
+    }
+    args[n++] = seg->filename;
+
+    /* execvp() wants modifiable strings */
+    ret = av_mallocz((n + 1) * sizeof(*ret));
+    for (i = 0; ret && i < n; i++) {
+        if (!(ret[i] = av_strdup(args[i]))) {
+            free_args(ret);
+            ret = NULL;
+        }
+    }
+    av_free(args);
+    return ret;
+}
+
+/**
+ * Run one pass of all segments as concurrent ffmpeg processes.
+ */
+static int run_segments(int argc, char **argv, int out_index,
+                        Segment *seg, int nb_segments, int pass, const char *prefix)
+{
+#if HAVE_FORK
+    pid_t pid[MAX_SEGMENTS];
+    int i, status, ret = 0;
+
+    if (verbose >= 0)
+        fprintf(stderr, "Pass %d: encoding %d segments in parallel\n", pass, nb_segments);
+    fflush(stdout);
+    fflush(stderr);
+    for (i = 0; i < nb_segments; i++) {
+        char **args = segment_args(argc, argv, out_index, &seg[i], pass,
+                                   pass == 1 ? seg[i].logprefix : prefix);
+        if (!args) {
+            pid[i] = -1;
+            ret = AVERROR(ENOMEM);
+            continue;
+        }
+        pid[i] = fork();
+        if (!pid[i]) {
+            int fd = open("/dev/null", O_RDONLY);
+            if (fd >= 0)
+                dup2(fd, 0);
+            execvp(args[0], args);
+            fprintf(stderr, "Cannot run '%s': %s\n", args[0], strerror(errno));
+            _exit(1);
+        }
+        free_args(args);
+        if (pid[i] < 0) {
+            fprintf(stderr, "Cannot start segment %d: %s\n", i, strerror(errno));
+            ret = AVERROR(errno);
+        }
+    }
+    for (i = 0; i < nb_segments; i++) {
+        if (pid[i] < 0)
+            continue;
+        if (waitpid(pid[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "Pass %d of segment %d failed\n", pass, i);
+            ret = AVERROR(EINVAL);
+        }
+    }
+    return ret;
+#else
+    fprintf(stderr, "-pass_segments is not supported on this system\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int segment_log_name(char *buf, int size, const char *prefix, int stream)
+{
+    if (snprintf(buf, size, "%s-%d.log", prefix, stream) >= size) {
+        fprintf(stderr, "Log file name for prefix '%s' is too long\n", prefix);
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+/**
+ * Concatenate the pass 1 statistics of the segments into the log file a
+ * normal second pass would read, so that rate control distributes the bits
+ * over the whole file. The frames of the preroll of each segment are
+ * dropped, including the B-frames coded after the keyframe starting the
+ * segment, and the others are renumbered in display and coding order.
+ */
+static int merge_pass1_stats(Segment *seg, int nb_segments, const char *prefix)
+{
+    int i, k, nb_streams = 0;
+
+    for (i = 0; i < output_files[0]->nb_streams; i++) {
+        char logfilename[1024];
+        int nb_frames = 0;
+        FILE *f;
+
+        if (segment_log_name(logfilename, sizeof(logfilename), seg[0].logprefix, i) < 0)
+            return AVERROR(EINVAL);
+        if (avio_check(logfilename, AVIO_FLAG_READ) < 0)
+            continue;
+        if (segment_log_name(logfilename, sizeof(logfilename), prefix, i) < 0)
+            return AVERROR(EINVAL);
+        f = fopen(logfilename, "wb");
+        if (!f) {
+            fprintf(stderr, "Cannot write log file '%s': %s\n", logfilename, strerror(errno));
+            return AVERROR(errno);
+        }
+        for (k = 0; k < nb_segments; k++) {
+            char *buf, *p, *next;
+            const char *prev;
+            size_t size;
+            int coded = 0;
+
+            if (segment_log_name(logfilename, sizeof(logfilename), seg[k].logprefix, i) < 0 ||
+                read_file(logfilename, &buf, &size) < 0) {
+                fclose(f);
+                return AVERROR(EINVAL);
+            }
+            if (!nb_streams)
+                seg[k].first_frame = nb_frames;
+            if (seg[k].first_frame != nb_frames) {
+                fprintf(stderr, "Streams #0.%d and #0.0 have a different number of frames in segment %d\n", i, k);
+                av_free(buf);
+                fclose(f);
+                return AVERROR(EINVAL);
+            }
+            for (p = buf, prev = ""; (next = strchr(p, ';')); prev = p, p = next + 1) {
+                int in, out, type, n = 0;
+
+                *next = 0;
+                if (sscanf(p, " in:%d out:%d %n", &in, &out, &n) < 2 || !n) {
+                    fprintf(stderr, "Log file '%s' cannot be used with -pass_segments\n", logfilename);
+                    av_free(buf);
+                    fclose(f);
+                    return AVERROR(EINVAL);
+                }
+                /* the statistics of the last frame are written again when
+                 * the encoder is flushed */
+                if (!strcmp(p, prev) || in < seg[k].preroll)
+                    continue;
+                /* the second pass starts the segment with a keyframe */
+                if (!coded && (sscanf(p + n, "type:%d", &type) < 1 || type != AV_PICTURE_TYPE_I)) {
+                    fprintf(stderr, "Segment %d does not start with a keyframe in the first pass\n", k);
+                    av_free(buf);
+                    fclose(f);
+                    return AVERROR(EINVAL);
+                }
+                in -= seg[k].preroll;
+                fprintf(f, "in:%d out:%d %s;\n", in + seg[k].first_frame, coded++ + seg[k].first_frame, p + n);
+                nb_frames = FFMAX(nb_frames, seg[k].first_frame + in + 1);
+            }
+            av_free(buf);
+        }
+        fclose(f);
+        nb_streams++;
+    }
+    if (!nb_streams) {
+        fprintf(stderr, "No stream was encoded with two pass rate control\n");
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+/**
+ * Remux the encoded segments one after the other into the output file,
+ * without the packets of their preroll.
+ */
+static int concat_segments(Segment *seg, int nb_segments)
+{
+    AVFormatContext *oc = output_files[0], *out, *ic = NULL;
+    AVPacket pkt;
+    int i, k, ret = 0;
+
+    out = avformat_alloc_context();
+    if (!out)
+        return AVERROR(ENOMEM);
+    out->oformat = oc->oformat;
+    av_strlcpy(out->filename, oc->filename, sizeof(out->filename));
+    out->preload   = oc->preload;
+    out->max_delay = oc->max_delay;
+    /* take over the file opened by opt_output_file() */
+    out->pb = oc->pb;
+    oc->pb  = NULL;
+
+    for (k = 0; k < nb_segments && ret >= 0; k++) {
+        if ((ret = avformat_open_input(&ic, seg[k].filename, NULL, NULL)) < 0 ||
+            (ret = avformat_find_stream_info(ic, NULL)) < 0) {
+            print_error(seg[k].filename, ret);
+            break;
+        }
+        if (!k) {
+            for (i = 0; i < ic->nb_streams && ret >= 0; i++) {
+                AVStream *ist = ic->streams[i], *st = av_new_stream(out, ist->id);
+                unsigned int tag;
+
+                if (!st) {
+                    ret = AVERROR(ENOMEM);
+                    break;
+                }
+                ret = avcodec_copy_context(st->codec, ist->codec);
+                tag = st->codec->codec_tag;
+                if (out->oformat->codec_tag &&
+                    av_codec_get_id(out->oformat->codec_tag, tag) != st->codec->codec_id)
+                    st->codec->codec_tag = 0;
+                if (!st->codec->time_base.num || !st->codec->time_base.den)
+                    st->codec->time_base = ist->time_base;
+                st->time_base           = ist->time_base;
+                st->r_frame_rate        = ist->r_frame_rate;
+                st->avg_frame_rate      = ist->avg_frame_rate;
+                st->sample_aspect_ratio = st->codec->sample_aspect_ratio;
+            }
+            av_dict_copy(&out->metadata, ic->metadata, 0);
+            if (ret >= 0 && (ret = avformat_write_header(out, NULL)) < 0)
+                fprintf(stderr, "Could not write header for output file '%s'\n", out->filename);
+        } else if (ic->nb_streams != out->nb_streams) {
+            fprintf(stderr, "Segment '%s' has %d streams instead of %d\n",
+                    seg[k].filename, ic->nb_streams, out->nb_streams);
+            ret = AVERROR(EINVAL);
+        }
+
+        while (ret >= 0 && av_read_frame(ic, &pkt) >= 0) {
+            AVStream *ist = ic->streams[pkt.stream_index];
+            AVStream *st  = out->streams[pkt.stream_index];
+            int64_t offset = av_rescale_q(seg[k].preroll_start, AV_TIME_BASE_Q, st->time_base);
+            int64_t ts     = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+
+            if (seg[k].preroll && ts != AV_NOPTS_VALUE &&
+                av_compare_ts(ts, ist->time_base, seg[k].start - seg[k].preroll_start, AV_TIME_BASE_Q) < 0) {
+                av_free_packet(&pkt);
+                continue;
+            }
+            if (pkt.pts != AV_NOPTS_VALUE)
+                pkt.pts = av_rescale_q(pkt.pts, ist->time_base, st->time_base) + offset;
+            if (pkt.dts != AV_NOPTS_VALUE)
+                pkt.dts = av_rescale_q(pkt.dts, ist->time_base, st->time_base) + offset;
+            pkt.duration = av_rescale_q(pkt.duration, ist->time_base, st->time_base);
+            ret = av_interleaved_write_frame(out, &pkt);
+            av_free_packet(&pkt);
+        }
+        av_close_input_file(ic);
+        ic = NULL;
+    }
+    if (ret >= 0)
+        ret = av_write_trailer(out);
+    if (!(out->oformat->flags & AVFMT_NOFILE))
+        avio_close(out->pb);
+    avformat_free_context(out);
+    return ret;
+}
+
+/**
+ * Two pass encoding of the first input file, split into pass_segments
+ * segments starting at keyframes which are encoded by concurrent ffmpeg
+ * processes. The first passes run in parallel, their statistics are merged
+ * so that the second passes, which run in parallel too, share a single bit
+ * allocation over the whole file, and the encoded segments are then
+ * concatenated without reencoding.
+ */
+static int segmented_two_pass(int argc, char **argv)
+{
+    const char *prefix = pass_logfilename_prefix ? pass_logfilename_prefix : DEFAULT_PASS_LOGFILENAME_PREFIX;
+    const char *filename = output_files[0]->filename, *ext;
+    Segment *seg;
+    int i, k, nb_segments, out_index, ret;
+
+    if (nb_output_files != 1 || do_pass || start_time || recording_time != INT64_MAX) {
+        fprintf(stderr, "-pass_segments needs a single output file and cannot be combined with -pass, or -ss and -t as output options\n");
+        return AVERROR(EINVAL);
+    }
+    for (out_index = argc - 1; out_index > 0; out_index--)
+        if (!strcmp(argv[out_index], filename))
+            break;
+    if (out_index <= 0 || (output_files[0]->oformat->flags & AVFMT_NOFILE)) {
+        fprintf(stderr, "-pass_segments needs the output to be a regular file\n");
+        return AVERROR(EINVAL);
+    }
+    for (i = 0; i < nb_output_streams_for_file[0]; i++) {
+        OutputStream *ost = output_streams_for_file[0][i];
+        AVCodec *enc = ost->enc;
+
+        if (ost->st->codec->codec_type != AVMEDIA_TYPE_VIDEO || !enc)
+            continue;
+        if (ost->forced_keyframes) {
+            fprintf(stderr, "-pass_segments cannot be combined with -force_key_frames\n");
+            return AVERROR(EINVAL);
+        }
+        if (!enc->priv_class ||
+            !av_opt_find(&enc->priv_class, "rc_stats_offset", NULL, 0, 0)) {
+            fprintf(stderr, "Encoder '%s' does not support -pass_segments\n", enc->name);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    seg = av_mallocz(FFMIN(pass_segments, MAX_SEGMENTS) * sizeof(*seg));
+    if (!seg)
+        return AVERROR(ENOMEM);
+    nb_segments = find_segments(seg, FFMIN(pass_segments, MAX_SEGMENTS));
+    if (nb_segments < 0) {
+        av_free(seg);
+        return nb_segments;
+    }
+    ext = strrchr(filename, '.');
+    if (!ext || strchr(ext, '/'))
+        ext = "";
+    for (k = 0; k < nb_segments; k++) {
+        if (snprintf(seg[k].logprefix, sizeof(seg[k].logprefix), "%s-seg%d", prefix, k) >= sizeof(seg[k].logprefix) ||
+            snprintf(seg[k].filename, sizeof(seg[k].filename), "%s%s", seg[k].logprefix, ext) >= sizeof(seg[k].filename)) {
+            fprintf(stderr, "Log file prefix '%s' is too long for -pass_segments\n", prefix);
+            av_free(seg);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    if ((ret = run_segments(argc, argv, out_index, seg, nb_segments, 1, prefix)) >= 0 &&
+        (ret = merge_pass1_stats(seg, nb_segments, prefix)) >= 0 &&
+        (ret = run_segments(argc, argv, out_index, seg, nb_segments, 2, prefix)) >= 0)
+        ret = concat_segments(seg, nb_segments);
+
+    for (k = 0; k < nb_segments; k++) {
+        char logfilename[1024];
+
+        unlink(seg[k].filename);
+        for (i = 0; i < output_files[0]->nb_streams; i++)
+            if (segment_log_name(logfilename, sizeof(logfilename), seg[k].logprefix, i) >= 0)
+                unlink(logfilename);
+    }
+    av_free(seg);
+    return ret;
+}
+
 int main(int argc, char **argv)
 {
     int64_t ti;
@@ -4573,6 +5374,14 @@ int main(int argc, char **argv)
         ffmpeg_exit(1);
     }
 
+    if (thread_pool_size && avcodec_thread_pool_init(thread_pool_size) < 0) {
+        fprintf(stderr, "Could not create a pool of %d threads\n", thread_pool_size);
+        ffmpeg_exit(1);
+    }
+    if (pass_segments > 1)
+        return ffmpeg_exit(segmented_two_pass(argc, argv) < 0);
+
+    ff_timer_probes_enable(do_timer_probes);
     ti = getutime();
     if (transcode(output_files, nb_output_files, input_files, nb_input_files,
                   stream_maps, nb_stream_maps) < 0)
@@ -4582,6 +5391,8 @@ int main(int argc, char **argv)
         int maxrss = getmaxrss() / 1024;
         printf("bench: utime=%0.3fs maxrss=%ikB\n", ti / 1000000.0, maxrss);
     }
+    if (do_timer_probes)
+        ff_timer_probes_dump(NULL, AV_LOG_INFO);
 
     return ffmpeg_exit(0);
 }
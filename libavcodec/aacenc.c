@@ -174,6 +174,7 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     AACEncContext *s = avctx->priv_data;
     int i;
     const uint8_t *sizes[2];
+    uint8_t grouping[AAC_MAX_CHANNELS];
     int lengths[2];
 
     avctx->frame_size = 1024;
@@ -200,6 +201,7 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     s->samplerate_index = i;
 
     dsputil_init(&s->dsp, avctx);
+    ff_aacencdsp_init(&s->aacdsp);
     ff_mdct_init(&s->mdct1024, 11, 0, 1.0);
     ff_mdct_init(&s->mdct128,   8, 0, 1.0);
     // window init
@@ -219,12 +221,20 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
     sizes[1]   = swb_size_128[i];
     lengths[0] = ff_aac_num_swb_1024[i];
     lengths[1] = ff_aac_num_swb_128[i];
-    ff_psy_init(&s->psy, avctx, 2, sizes, lengths, s->chan_map[0], &s->chan_map[1]);
+    for (i = 0; i < s->chan_map[0]; i++)
+        grouping[i] = s->chan_map[i + 1] == TYPE_CPE;
+    ff_psy_init(&s->psy, avctx, 2, sizes, lengths, s->chan_map[0], grouping);
     s->psypp = ff_psy_preprocess_init(avctx);
     s->coder = &ff_aac_coders[2];
 
     s->lambda = avctx->global_quality ? avctx->global_quality : 120;
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        s->thread_ctx = av_malloc(sizeof(*s->thread_ctx) * avctx->thread_count);
+        if (!s->thread_ctx)
+            return AVERROR(ENOMEM);
+    }
+
     ff_aac_tableinit();
 
     return 0;
@@ -494,13 +504,63 @@ static void put_bitstream_info(AVCodecContext *avctx, AACEncContext *s,
     put_bits(&s->pb, 12 - padbits, 0);
 }
 
+/**
+ * Search scalefactors, codebooks and stereo coding for one channel element.
+ * Runs in parallel for all elements of a frame, using a private copy of the
+ * context for the scratch buffers of the coefficient coder.
+ */
+static int search_element_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *ts = s->thread_ctx ? &s->thread_ctx[threadnr] : s;
+    FFPsyWindowInfo *wi = arg;
+    ChannelElement *cpe = &s->cpe[jobnr];
+    int i, ch, w, g, chans, start_ch = 0;
+
+    for (i = 0; i < jobnr; i++)
+        start_ch += s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+    chans = s->chan_map[jobnr+1] == TYPE_CPE ? 2 : 1;
+    wi   += start_ch;
+
+    for (ch = 0; ch < chans; ch++) {
+        ts->cur_channel = start_ch + ch;
+        s->coder->search_for_quantizers(avctx, ts, &cpe->ch[ch], s->lambda);
+    }
+    cpe->common_window = 0;
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    ts->cur_channel = start_ch;
+    if (s->options.stereo_mode && cpe->common_window) {
+        if (s->options.stereo_mode > 0) {
+            IndividualChannelStream *ics = &cpe->ch[0].ics;
+            for (w = 0; w < ics->num_windows; w += ics->group_len[w])
+                for (g = 0;  g < ics->num_swb; g++)
+                    cpe->ms_mask[w*16+g] = 1;
+        } else if (s->coder->search_for_ms) {
+            s->coder->search_for_ms(ts, cpe, s->lambda);
+        }
+    }
+    adjust_frame_information(ts, cpe, chans);
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx,
                             uint8_t *frame, int buf_size, void *data)
 {
     AACEncContext *s = avctx->priv_data;
     int16_t *samples = s->samples, *samples2, *la;
     ChannelElement *cpe;
-    int i, ch, w, g, chans, tag, start_ch;
+    int i, ch, w, chans, tag, start_ch;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
 
@@ -579,47 +639,29 @@ static int aac_encode_frame(AVCodecContext *avctx,
         if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & CODEC_FLAG_BITEXACT))
             put_bitstream_info(avctx, s, LIBAVCODEC_IDENT);
         start_ch = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
             tag      = s->chan_map[i+1];
             chans    = tag == TYPE_CPE ? 2 : 1;
             cpe      = &s->cpe[i];
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++)
                 coeffs[ch] = cpe->ch[ch].coeffs;
             s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch * 2 + ch;
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            cpe->common_window = 0;
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            s->cur_channel = start_ch * 2;
-            if (s->options.stereo_mode && cpe->common_window) {
-                if (s->options.stereo_mode > 0) {
-                    IndividualChannelStream *ics = &cpe->ch[0].ics;
-                    for (w = 0; w < ics->num_windows; w += ics->group_len[w])
-                        for (g = 0;  g < ics->num_swb; g++)
-                            cpe->ms_mask[w*16+g] = 1;
-                } else if (s->coder->search_for_ms) {
-                    s->coder->search_for_ms(s, cpe, s->lambda);
-                }
-            }
-            adjust_frame_information(s, cpe, chans);
+            start_ch += chans;
+        }
+        if (s->thread_ctx)
+            for (i = 0; i < avctx->thread_count; i++)
+                memcpy(&s->thread_ctx[i], s, offsetof(AACEncContext, cur_channel));
+        avctx->execute2(avctx, search_element_thread, windows, NULL, s->chan_map[0]);
+        start_ch = 0;
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -672,6 +714,7 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_psy_preprocess_end(s->psypp);
     av_freep(&s->samples);
     av_freep(&s->cpe);
+    av_freep(&s->thread_ctx);
     return 0;
 }
 
@@ -699,7 +742,8 @@ AVCodec ff_aac_encoder = {
     .init           = aac_encode_init,
     .encode         = aac_encode_frame,
     .close          = aac_encode_end,
-    .capabilities = CODEC_CAP_SMALL_LAST_FRAME | CODEC_CAP_DELAY | CODEC_CAP_EXPERIMENTAL,
+    .capabilities = CODEC_CAP_SMALL_LAST_FRAME | CODEC_CAP_DELAY | CODEC_CAP_EXPERIMENTAL |
+                    CODEC_CAP_SLICE_THREADS,
     .sample_fmts = (const enum AVSampleFormat[]){AV_SAMPLE_FMT_S16,AV_SAMPLE_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("Advanced Audio Coding"),
     .priv_class = &aacenc_class,
@@ -27,6 +27,7 @@
 #include "dsputil.h"
 
 #include "aac.h"
+#include "aacencdsp.h"
 
 #include "psymodel.h"
 
@@ -58,6 +59,7 @@ typedef struct AACEncContext {
     FFTContext mdct1024;                         ///< long (1024 samples) frame transform context
     FFTContext mdct128;                          ///< short (128 samples) frame transform context
     DSPContext  dsp;
+    AACEncDSPContext aacdsp;
     int16_t *samples;                            ///< saved preprocessed input
 
     int samplerate_index;                        ///< MPEG-4 samplerate index
@@ -67,9 +69,12 @@ typedef struct AACEncContext {
     FFPsyContext psy;
     struct FFPsyPreprocessContext* psypp;
     AACCoefficientsEncoder *coder;
-    int cur_channel;
     int last_frame;
     float lambda;
+    struct AACEncContext *thread_ctx;            ///< per-thread copies used for the quantizer search, NULL if unthreaded
+
+    /* the fields below are scratch space private to each thread copy */
+    int cur_channel;
     DECLARE_ALIGNED(16, int,   qcoefs)[96];      ///< quantized coefficients
     DECLARE_ALIGNED(32, float, scoefs)[1024];    ///< scaled coefficients
 } AACEncContext;
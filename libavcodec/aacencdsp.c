@@ -0,0 +1,57 @@
+/*
+ * AAC encoder DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/libm.h"
+
+#include <math.h>
+#include "libavutil/common.h"
+#include "aacencdsp.h"
+
+static void abs_pow34_c(float *out, const float *in, int size)
+{
+    int i;
+    for (i = 0; i < size; i++) {
+        float a = fabsf(in[i]);
+        out[i] = sqrtf(a * sqrtf(a));
+    }
+}
+
+static void quant_bands_c(int *out, const float *in, const float *scaled,
+                          int size, float Q34, int is_signed, int maxval)
+{
+    int i;
+    double qc;
+    for (i = 0; i < size; i++) {
+        qc = scaled[i] * Q34;
+        out[i] = (int)FFMIN(qc + 0.4054, (double)maxval);
+        if (is_signed && in[i] < 0.0f) {
+            out[i] = -out[i];
+        }
+    }
+}
+
+av_cold void ff_aacencdsp_init(AACEncDSPContext *c)
+{
+    c->abs_pow34   = abs_pow34_c;
+    c->quant_bands = quant_bands_c;
+
+    if (HAVE_MMX)
+        ff_aacencdsp_init_x86(c);
+}
@@ -0,0 +1,51 @@
+/*
+ * AAC encoder DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_AACENCDSP_H
+#define AVCODEC_AACENCDSP_H
+
+typedef struct AACEncDSPContext {
+    /**
+     * Calculate |in|^(3/4) for each element of an array.
+     * @param out   output array
+     * @param in    input array, may be unaligned
+     * @param size  number of elements
+     *              constraints: multiple of 4 greater than 0
+     */
+    void (*abs_pow34)(float *out, const float *in, int size);
+
+    /**
+     * Quantize scaled coefficients with a given step:
+     * out[i] = min(scaled[i] * Q34 + 0.4054, maxval), with the sign of
+     * in[i] restored if is_signed is set.
+     * @param out     quantized values
+     * @param in      original coefficients, only used for their sign
+     * @param scaled  |in|^(3/4), as returned by abs_pow34()
+     * @param size    number of elements
+     *                constraints: multiple of 4 greater than 0
+     */
+    void (*quant_bands)(int *out, const float *in, const float *scaled,
+                        int size, float Q34, int is_signed, int maxval);
+} AACEncDSPContext;
+
+void ff_aacencdsp_init(AACEncDSPContext *c);
+void ff_aacencdsp_init_x86(AACEncDSPContext *c);
+
+#endif /* AVCODEC_AACENCDSP_H */
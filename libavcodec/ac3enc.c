@@ -1959,15 +1959,14 @@ int ff_ac3_validate_metadata(AC3EncodeContext *s)
 
 
 /**
- * Finalize encoding and free any memory allocated by the encoder.
+ * Free the buffers and MDCT of an encoder context.
  */
-av_cold int ff_ac3_encode_close(AVCodecContext *avctx)
+static av_cold void free_context(AC3EncodeContext *s)
 {
     int blk, ch;
-    AC3EncodeContext *s = avctx->priv_data;
 
     av_freep(&s->windowed_samples);
-    for (ch = 0; ch < s->channels; ch++)
+    for (ch = 0; s->planar_samples && ch < s->channels; ch++)
         av_freep(&s->planar_samples[ch]);
     av_freep(&s->planar_samples);
     av_freep(&s->bap_buffer);
@@ -1996,7 +1995,28 @@ av_cold int ff_ac3_encode_close(AVCodecContext *avctx)
         av_freep(&block->cpl_coord_mant);
     }
 
+    av_freep(&s->frame_buf);
+
     s->mdct_end(s);
+}
+
+
+/**
+ * Finalize encoding and free any memory allocated by the encoder.
+ */
+av_cold int ff_ac3_encode_close(AVCodecContext *avctx)
+{
+    AC3EncodeContext *s = avctx->priv_data;
+    int i;
+
+    for (i = 0; i < s->nb_frame_ctx; i++) {
+        free_context(s->frame_ctx[i]);
+        av_freep(&s->frame_ctx[i]);
+    }
+    av_freep(&s->frame_ctx);
+    s->nb_frame_ctx = 0;
+
+    free_context(s);
 
     av_freep(&avctx->coded_frame);
     return 0;
@@ -2351,6 +2371,45 @@ alloc_fail:
 }
 
 
+/**
+ * Allocate one frame context per thread, so that frames can be encoded in
+ * parallel. Only the bit count used to pad the frame size and the overlap of
+ * the input samples are carried over from one frame to the next, so these
+ * are kept in the main context and copied to the frame context along with
+ * the input samples when a frame is queued.
+ * Must be called before the buffers of the main context are allocated.
+ */
+static av_cold int allocate_frame_contexts(AC3EncodeContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int i, ret;
+
+    FF_ALLOCZ_OR_GOTO(avctx, s->frame_ctx, avctx->thread_count *
+                      sizeof(*s->frame_ctx), alloc_fail);
+    for (i = 0; i < avctx->thread_count; i++) {
+        AC3EncodeContext *fs = av_malloc(sizeof(*fs));
+        if (!fs)
+            goto alloc_fail;
+        memcpy(fs, s, sizeof(*fs));
+        fs->frame_ctx    = NULL;
+        fs->nb_frame_ctx = 0;
+        s->frame_ctx[s->nb_frame_ctx++] = fs;
+
+        ret = fs->mdct_init(fs);
+        if (ret)
+            return ret;
+        ret = allocate_buffers(fs);
+        if (ret)
+            return ret;
+        FF_ALLOC_OR_GOTO(avctx, fs->frame_buf, s->frame_size_min + 2, alloc_fail);
+    }
+
+    return 0;
+alloc_fail:
+    return AVERROR(ENOMEM);
+}
+
+
 /**
  * Initialize the encoder.
  */
@@ -2407,6 +2466,15 @@ av_cold int ff_ac3_encode_init(AVCodecContext *avctx)
 
     bit_alloc_init(s);
 
+    dsputil_init(&s->dsp, avctx);
+    ff_ac3dsp_init(&s->ac3dsp, avctx->flags & CODEC_FLAG_BITEXACT);
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        ret = allocate_frame_contexts(s);
+        if (ret)
+            goto init_fail;
+    }
+
     ret = s->mdct_init(s);
     if (ret)
         goto init_fail;
@@ -2417,9 +2485,6 @@ av_cold int ff_ac3_encode_init(AVCodecContext *avctx)
 
     avctx->coded_frame= avcodec_alloc_frame();
 
-    dsputil_init(&s->dsp, avctx);
-    ff_ac3dsp_init(&s->ac3dsp, avctx->flags & CODEC_FLAG_BITEXACT);
-
     dprint_options(s);
 
     return 0;
@@ -245,6 +245,15 @@ typedef struct AC3EncodeContext {
     uint8_t *ref_bap     [AC3_MAX_CHANNELS][AC3_MAX_BLOCKS]; ///< bit allocation pointers (bap)
     int ref_bap_set;                                         ///< indicates if ref_bap pointers have been set
 
+    /* frames encoded in parallel with slice threads */
+    struct AC3EncodeContext **frame_ctx;    ///< contexts encoding the queued frames, one per thread
+    int nb_frame_ctx;                       ///< number of frame contexts, 0 if frames are encoded serially
+    int next_output;                        ///< frame context holding the next frame to output
+    int nb_queued;                          ///< number of frames waiting to be encoded
+    int nb_encoded;                         ///< number of encoded frames waiting to be output
+    uint8_t *frame_buf;                     ///< output buffer of a frame context
+    int frame_ret;                          ///< encoded size or error code of a frame context
+
     /* fixed vs. float function pointers */
     void (*mdct_end)(struct AC3EncodeContext *s);
     int  (*mdct_init)(struct AC3EncodeContext *s);
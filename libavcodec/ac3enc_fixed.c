@@ -128,6 +128,7 @@ AVCodec ff_ac3_fixed_encoder = {
     .init           = ac3_fixed_encode_init,
     .encode         = ff_ac3_fixed_encode_frame,
     .close          = ff_ac3_encode_close,
+    .capabilities   = CODEC_CAP_DELAY | CODEC_CAP_SLICE_THREADS,
     .sample_fmts = (const enum AVSampleFormat[]){AV_SAMPLE_FMT_S16,AV_SAMPLE_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("ATSC A/52A (AC-3)"),
     .priv_class = &ac3enc_class,
@@ -405,26 +405,13 @@ static void compute_rematrixing_strategy(AC3EncodeContext *s)
 
 
 /**
- * Encode a single AC-3 frame.
+ * Encode a single AC-3 frame from the input samples already deinterleaved
+ * into the context.
  */
-int AC3_NAME(encode_frame)(AVCodecContext *avctx, unsigned char *frame,
-                           int buf_size, void *data)
+static int encode_frame_data(AC3EncodeContext *s, unsigned char *frame)
 {
-    AC3EncodeContext *s = avctx->priv_data;
-    const SampleType *samples = data;
     int ret;
 
-    if (s->options.allow_per_frame_metadata) {
-        ret = ff_ac3_validate_metadata(s);
-        if (ret)
-            return ret;
-    }
-
-    if (s->bit_alloc.sr_code == 1 || s->eac3)
-        ff_ac3_adjust_frame_size(s);
-
-    deinterleave_input_samples(s, samples);
-
     apply_mdct(s);
 
     if (s->fixed_point)
@@ -450,7 +437,7 @@ int AC3_NAME(encode_frame)(AVCodecContext *avctx, unsigned char *frame,
 
     ret = ff_ac3_compute_bit_allocation(s);
     if (ret) {
-        av_log(avctx, AV_LOG_ERROR, "Bit allocation failed. Try increasing the bitrate.\n");
+        av_log(s->avctx, AV_LOG_ERROR, "Bit allocation failed. Try increasing the bitrate.\n");
         return ret;
     }
 
@@ -462,3 +449,102 @@ int AC3_NAME(encode_frame)(AVCodecContext *avctx, unsigned char *frame,
 
     return s->frame_size;
 }
+
+
+/**
+ * Copy the current input samples and frame parameters to the next free
+ * frame context.
+ */
+static void queue_frame(AC3EncodeContext *s)
+{
+    AC3EncodeContext *fs;
+    int ch;
+
+    fs = s->frame_ctx[(s->next_output + s->nb_encoded + s->nb_queued) %
+                      s->nb_frame_ctx];
+
+    for (ch = 0; ch < s->channels; ch++) {
+        memcpy(fs->planar_samples[ch], s->planar_samples[ch],
+               AC3_BLOCK_SIZE * (s->num_blocks + 1) * sizeof(**s->planar_samples));
+    }
+    fs->frame_size = s->frame_size;
+
+    /* metadata may have been changed since the previous frame */
+    fs->options                 = s->options;
+    fs->center_mix_level        = s->center_mix_level;
+    fs->surround_mix_level      = s->surround_mix_level;
+    fs->ltrt_center_mix_level   = s->ltrt_center_mix_level;
+    fs->ltrt_surround_mix_level = s->ltrt_surround_mix_level;
+    fs->loro_center_mix_level   = s->loro_center_mix_level;
+    fs->loro_surround_mix_level = s->loro_surround_mix_level;
+
+    s->nb_queued++;
+}
+
+
+static int encode_frame_thread(AVCodecContext *avctx, void *arg, int jobnr,
+                               int threadnr)
+{
+    AC3EncodeContext *s  = avctx->priv_data;
+    AC3EncodeContext *fs = s->frame_ctx[(s->next_output + jobnr) % s->nb_frame_ctx];
+
+    fs->frame_ret = encode_frame_data(fs, fs->frame_buf);
+    return 0;
+}
+
+
+/**
+ * Encode a single AC-3 frame.
+ *
+ * With slice threading, frames are queued until there is one per frame
+ * context and are then encoded in parallel. The output is delayed by the
+ * number of frame contexts minus one, and queued frames are flushed when
+ * called with no input samples.
+ */
+int AC3_NAME(encode_frame)(AVCodecContext *avctx, unsigned char *frame,
+                           int buf_size, void *data)
+{
+    AC3EncodeContext *s = avctx->priv_data;
+    const SampleType *samples = data;
+    AC3EncodeContext *fs;
+    int ret;
+
+    if (!samples && !s->nb_frame_ctx)
+        return 0;
+
+    if (samples) {
+        if (s->options.allow_per_frame_metadata) {
+            ret = ff_ac3_validate_metadata(s);
+            if (ret)
+                return ret;
+        }
+
+        if (s->bit_alloc.sr_code == 1 || s->eac3)
+            ff_ac3_adjust_frame_size(s);
+
+        deinterleave_input_samples(s, samples);
+
+        if (!s->nb_frame_ctx)
+            return encode_frame_data(s, frame);
+
+        queue_frame(s);
+    }
+
+    if (!s->nb_encoded && s->nb_queued &&
+        (s->nb_queued == s->nb_frame_ctx || !samples)) {
+        avctx->execute2(avctx, encode_frame_thread, NULL, NULL, s->nb_queued);
+        s->nb_encoded = s->nb_queued;
+        s->nb_queued  = 0;
+    }
+    if (!s->nb_encoded)
+        return 0;
+
+    fs = s->frame_ctx[s->next_output];
+    s->next_output = (s->next_output + 1) % s->nb_frame_ctx;
+    s->nb_encoded--;
+
+    if (fs->frame_ret < 0)
+        return fs->frame_ret;
+    memcpy(frame, fs->frame_buf, fs->frame_ret);
+    return fs->frame_ret;
+}
@@ -457,6 +457,7 @@ enum Motion_Est_ID {
     ME_UMH,         ///< uneven multi-hexagon search
     ME_ITER,        ///< iterative search
     ME_TESA,        ///< transformed exhaustive search algorithm
+    ME_HIER,        ///< hierarchical search on a downscaled pyramid, refined by EPZS
 };
 
 enum AVDiscard{
@@ -846,6 +847,7 @@ typedef struct AVPacket {
 } AVPacket;
 #define AV_PKT_FLAG_KEY     0x0001 ///< The packet contains a keyframe
 #define AV_PKT_FLAG_CORRUPT 0x0002 ///< The packet content is corrupted
+#define AV_PKT_FLAG_PARTIAL 0x0004 ///< The packet contains only the start of a frame, the rest follows in the next packets of the stream
 
 /**
  * Audio Video Frame.
@@ -1378,6 +1380,12 @@ typedef struct AVCodecContext {
     /* with a Start Code (it should). H.263 does.   */
     /* mb_nb contains the number of macroblocks     */
     /* encoded in the RTP payload.                  */
+    /* The packets are passed in bitstream order as */
+    /* soon as they are complete and together they  */
+    /* cover the whole output of the frame, so the  */
+    /* data can be sent before the encode call has  */
+    /* returned. data points into the output buffer */
+    /* of the encode call.                          */
     void (*rtp_callback)(struct AVCodecContext *avctx, void *data, int size, int mb_nb);
 
     /* statistics, used for 2-pass encoding */
@@ -2879,9 +2887,11 @@ typedef struct AVCodecContext {
     int thread_type;
 #define FF_THREAD_FRAME   1 //< Decode more than one frame at once
 #define FF_THREAD_SLICE   2 //< Decode more than one part of a single frame at once
+#define FF_THREAD_HYBRID  4 //< Decode more than one frame at once, and the parts of each frame in parallel
 
     /**
      * Which multithreading methods are in use by the codec.
+     * Hybrid threading is reported as FF_THREAD_FRAME|FF_THREAD_SLICE.
      * - encoding: Set by libavcodec.
      * - decoding: Set by libavcodec.
      */
@@ -3737,6 +3747,29 @@ int avcodec_default_execute(AVCodecContext *c, int (*func)(AVCodecContext *c2, v
 int avcodec_default_execute2(AVCodecContext *c, int (*func)(AVCodecContext *c2, void *arg2, int, int),void *arg, int *ret, int count);
 //FIXME func typedef
 
+/**
+ * Create a process-wide pool of threads which executes the execute() and
+ * execute2() jobs of all codec contexts using slice threading, instead of
+ * each context spawning its own threads. Contexts opened afterwards use
+ * the pool; avctx->thread_count then limits how many of their jobs run at
+ * once. Jobs of concurrent execute() calls from different contexts are
+ * served in turn, and the calling thread runs jobs of its own call as well.
+ *
+ * Frame threading still creates one thread per frame being decoded, as
+ * these block waiting for each other's progress.
+ *
+ * @param thread_count number of threads in the pool, usually the number of
+ *                     CPU cores
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int avcodec_thread_pool_init(int thread_count);
+
+/**
+ * Stop and free the threads created by avcodec_thread_pool_init().
+ * No codec context using the pool may be open.
+ */
+void avcodec_thread_pool_uninit(void);
+
 #if FF_API_AVCODEC_OPEN
 /**
  * Initialize the AVCodecContext to use the given AVCodec. Prior to using this
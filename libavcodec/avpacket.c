@@ -19,10 +19,147 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include <windows.h>
+#endif
 #include "avcodec.h"
+#include "internal.h"
 #include "libavutil/avassert.h"
 #include "bytestream.h"
 
+/*
+ * Packet payload pool.
+ *
+ * Payloads are rounded up to a power of two size class and returned to a
+ * per class free list by ff_packet_pool_destruct() instead of av_free(), so
+ * that a steady stream of similarly sized packets does not hit the system
+ * allocator. av_new_packet() and av_dup_packet() do not use the pool, as
+ * their callers may release the payload with av_destruct_packet(); lavf
+ * uses it through ff_packet_pool_new_packet() and ff_packet_pool_dup_packet()
+ * for the packets it returns from av_read_frame(). Each block is preceded
+ * by a header recording its class; the header is POOL_HEADER_SIZE bytes so
+ * the payload keeps av_malloc() alignment.
+ */
+#define POOL_MIN_SHIFT    8     /* 256 bytes */
+#define POOL_CLASSES      13    /* up to 1 MiB */
+#define POOL_HEADER_SIZE  32
+#define POOL_MAX_BLOCKS   64
+#define POOL_MAX_BYTES    (8 << 20)
+
+typedef struct PoolBlock {
+    struct PoolBlock *next;
+    int cls;                    /* -1 for blocks too large to be pooled */
+} PoolBlock;
+
+static PoolBlock *pool_free[POOL_CLASSES];
+static int        pool_count[POOL_CLASSES];
+
+#if HAVE_PTHREADS
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK()   pthread_mutex_lock(&pool_lock)
+#define POOL_UNLOCK() pthread_mutex_unlock(&pool_lock)
+#elif HAVE_W32THREADS
+static volatile LONG pool_lock;
+#define POOL_LOCK()   while (InterlockedExchange(&pool_lock, 1)) Sleep(0)
+#define POOL_UNLOCK() InterlockedExchange(&pool_lock, 0)
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+static inline PoolBlock *pool_block(void *ptr)
+{
+    return (PoolBlock *)((uint8_t *)ptr - POOL_HEADER_SIZE);
+}
+
+static inline int pool_block_size(int cls)
+{
+    return 1 << (cls + POOL_MIN_SHIFT);
+}
+
+void *ff_packet_pool_alloc(unsigned int size)
+{
+    PoolBlock *block = NULL;
+    int cls = 0;
+
+    if (size > INT_MAX - POOL_HEADER_SIZE)
+        return NULL;
+    while (cls < POOL_CLASSES && size > pool_block_size(cls))
+        cls++;
+
+    if (cls < POOL_CLASSES) {
+        POOL_LOCK();
+        if ((block = pool_free[cls])) {
+            pool_free[cls] = block->next;
+            pool_count[cls]--;
+        }
+        POOL_UNLOCK();
+        if (!block)
+            block = av_malloc(POOL_HEADER_SIZE + pool_block_size(cls));
+    } else {
+        cls   = -1;
+        block = av_malloc(POOL_HEADER_SIZE + size);
+    }
+    if (!block)
+        return NULL;
+    block->cls = cls;
+    return (uint8_t *)block + POOL_HEADER_SIZE;
+}
+
+void ff_packet_pool_free(void *ptr)
+{
+    PoolBlock *block;
+    int cls;
+
+    if (!ptr)
+        return;
+    block = pool_block(ptr);
+    cls   = block->cls;
+
+    if (cls >= 0) {
+        POOL_LOCK();
+        if (pool_count[cls] < FFMIN(POOL_MAX_BLOCKS,
+                                    POOL_MAX_BYTES / pool_block_size(cls))) {
+            block->next    = pool_free[cls];
+            pool_free[cls] = block;
+            pool_count[cls]++;
+            block = NULL;
+        }
+        POOL_UNLOCK();
+    }
+    av_free(block);
+}
+
+/**
+ * Return the number of bytes usable at ptr, which must have been returned
+ * by ff_packet_pool_alloc(), or 0 if unknown.
+ */
+static int pool_capacity(void *ptr)
+{
+    int cls = pool_block(ptr)->cls;
+    return cls >= 0 ? pool_block_size(cls) : 0;
+}
+
+static void destruct_side_data(AVPacket *pkt)
+{
+    int i;
+
+    for (i = 0; i < pkt->side_data_elems; i++)
+        av_free(pkt->side_data[i].data);
+    av_freep(&pkt->side_data);
+    pkt->side_data_elems = 0;
+}
+
+void ff_packet_pool_destruct(AVPacket *pkt)
+{
+    ff_packet_pool_free(pkt->data);
+    pkt->data = NULL; pkt->size = 0;
+    destruct_side_data(pkt);
+}
+
 void av_destruct_packet_nofree(AVPacket *pkt)
 {
     pkt->data = NULL; pkt->size = 0;
@@ -32,15 +169,10 @@ void av_destruct_packet_nofree(AVPacket *pkt)
 
 void av_destruct_packet(AVPacket *pkt)
 {
-    int i;
-
     av_free(pkt->data);
     pkt->data = NULL; pkt->size = 0;
 
-    for (i = 0; i < pkt->side_data_elems; i++)
-        av_free(pkt->side_data[i].data);
-    av_freep(&pkt->side_data);
-    pkt->side_data_elems = 0;
+    destruct_side_data(pkt);
 }
 
 void av_init_packet(AVPacket *pkt)
@@ -57,11 +189,12 @@ void av_init_packet(AVPacket *pkt)
     pkt->side_data_elems = 0;
 }
 
-int av_new_packet(AVPacket *pkt, int size)
+static int new_packet(AVPacket *pkt, int size, int pooled)
 {
     uint8_t *data= NULL;
     if((unsigned)size < (unsigned)size + FF_INPUT_BUFFER_PADDING_SIZE)
-        data = av_malloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
+        data = pooled ? ff_packet_pool_alloc(size + FF_INPUT_BUFFER_PADDING_SIZE) :
+                        av_malloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
     if (data){
         memset(data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
     }else
@@ -70,12 +203,22 @@ int av_new_packet(AVPacket *pkt, int size)
     av_init_packet(pkt);
     pkt->data = data;
     pkt->size = size;
-    pkt->destruct = av_destruct_packet;
+    pkt->destruct = pooled ? ff_packet_pool_destruct : av_destruct_packet;
     if(!data)
         return AVERROR(ENOMEM);
     return 0;
 }
 
+int av_new_packet(AVPacket *pkt, int size)
+{
+    return new_packet(pkt, size, 0);
+}
+
+int ff_packet_pool_new_packet(AVPacket *pkt, int size)
+{
+    return new_packet(pkt, size, 1);
+}
+
 void av_shrink_packet(AVPacket *pkt, int size)
 {
     if (pkt->size <= size) return;
@@ -88,12 +231,24 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
     void *new_ptr;
     av_assert0((unsigned)pkt->size <= INT_MAX - FF_INPUT_BUFFER_PADDING_SIZE);
     if (!pkt->size)
-        return av_new_packet(pkt, grow_by);
+        return new_packet(pkt, grow_by, pkt->destruct == ff_packet_pool_destruct);
     if ((unsigned)grow_by > INT_MAX - (pkt->size + FF_INPUT_BUFFER_PADDING_SIZE))
         return -1;
-    new_ptr = av_realloc(pkt->data, pkt->size + grow_by + FF_INPUT_BUFFER_PADDING_SIZE);
-    if (!new_ptr)
-        return AVERROR(ENOMEM);
+    if (pkt->destruct == ff_packet_pool_destruct) {
+        int new_size = pkt->size + grow_by + FF_INPUT_BUFFER_PADDING_SIZE;
+        if (new_size > pool_capacity(pkt->data)) {
+            new_ptr = ff_packet_pool_alloc(new_size);
+            if (!new_ptr)
+                return AVERROR(ENOMEM);
+            memcpy(new_ptr, pkt->data, pkt->size);
+            ff_packet_pool_free(pkt->data);
+        } else
+            new_ptr = pkt->data;
+    } else {
+        new_ptr = av_realloc(pkt->data, pkt->size + grow_by + FF_INPUT_BUFFER_PADDING_SIZE);
+        if (!new_ptr)
+            return AVERROR(ENOMEM);
+    }
     pkt->data = new_ptr;
     pkt->size += grow_by;
     memset(pkt->data + pkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
@@ -118,7 +273,7 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
         dst = data; \
     } while(0)
 
-int av_dup_packet(AVPacket *pkt)
+static int dup_packet(AVPacket *pkt, int pooled)
 {
     AVPacket tmp_pkt;
 
@@ -127,8 +282,15 @@ int av_dup_packet(AVPacket *pkt)
 
         pkt->data      = NULL;
         pkt->side_data = NULL;
-        DUP_DATA(pkt->data, tmp_pkt.data, pkt->size, 1);
-        pkt->destruct = av_destruct_packet;
+        pkt->destruct  = pooled ? ff_packet_pool_destruct : av_destruct_packet;
+        if ((unsigned)pkt->size > (unsigned)pkt->size + FF_INPUT_BUFFER_PADDING_SIZE)
+            goto failed_alloc;
+        pkt->data = pooled ? ff_packet_pool_alloc(pkt->size + FF_INPUT_BUFFER_PADDING_SIZE) :
+                             av_malloc(pkt->size + FF_INPUT_BUFFER_PADDING_SIZE);
+        if (!pkt->data)
+            goto failed_alloc;
+        memcpy(pkt->data, tmp_pkt.data, pkt->size);
+        memset(pkt->data + pkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
 
         if (pkt->side_data_elems) {
             int i;
@@ -144,10 +306,20 @@ int av_dup_packet(AVPacket *pkt)
     }
     return 0;
 failed_alloc:
-    av_destruct_packet(pkt);
+    pkt->destruct(pkt);
     return AVERROR(ENOMEM);
 }
 
+int av_dup_packet(AVPacket *pkt)
+{
+    return dup_packet(pkt, 0);
+}
+
+int ff_packet_pool_dup_packet(AVPacket *pkt)
+{
+    return dup_packet(pkt, 1);
+}
+
 void av_free_packet(AVPacket *pkt)
 {
     if (pkt) {
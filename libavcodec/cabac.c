@@ -49,8 +49,6 @@ static const uint8_t lps_range[64][4]= {
 {  6,  8,  9, 11}, {  6,  7,  9, 10}, {  6,  7,  8,  9}, {  2,  2,  2,  2},
 };
 
-uint8_t ff_h264_mlps_state[4*64];
-uint8_t ff_h264_lps_range[4*2*64];
 uint8_t ff_h264_lps_state[2*64];
 uint8_t ff_h264_mps_state[2*64];
 
@@ -76,7 +74,16 @@ static const uint8_t lps_state[64]= {
  36,36,37,37,37,38,38,63,
 };
 
-const uint8_t ff_h264_norm_shift[512]= {
+static const uint8_t last_coeff_flag_offset_8x8[63] = {
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8
+};
+
+/* norm_shift, followed by lps_range, mlps_state and last_coeff_flag_offset_8x8,
+ * which are set in ff_init_cabac_states() */
+uint8_t ff_h264_cabac_tables[512 + 4*2*64 + 4*64 + 63]= {
  9,8,7,7,6,6,6,6,5,5,5,5,5,5,5,5,
  4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
@@ -150,13 +157,19 @@ void ff_init_cabac_states(CABACContext *c){
         ff_h264_mps_state[2*i+1]= 2*mps_state[i]+1;
 
         if( i ){
+            ff_h264_lps_state[2*i+0]=
             ff_h264_mlps_state[128-2*i-1]= 2*lps_state[i]+0;
+            ff_h264_lps_state[2*i+1]=
             ff_h264_mlps_state[128-2*i-2]= 2*lps_state[i]+1;
         }else{
+            ff_h264_lps_state[2*i+0]=
             ff_h264_mlps_state[128-2*i-1]= 1;
+            ff_h264_lps_state[2*i+1]=
             ff_h264_mlps_state[128-2*i-2]= 0;
         }
     }
+    memcpy(ff_h264_last_coeff_flag_offset_8x8, last_coeff_flag_offset_8x8,
+           sizeof(last_coeff_flag_offset_8x8));
 }
 
 #ifdef TEST
@@ -300,11 +313,104 @@ static void put_cabac_ueg(CABACContext *c, uint8_t * state, int v, int max, int
     }
 }
 
+#if ARCH_X86 && HAVE_7REGS && HAVE_EBX_AVAILABLE
+#include "x86/h264_i386.h"
+
+#define SIG_BLOCKS 4096
+
+/**
+ * put a significance map the way H.264 codes it: a significant flag per
+ * coefficient, followed by a last flag for the significant ones; the flag of
+ * the last coefficient is not coded.
+ */
+static void put_significance(CABACContext *c, uint8_t *sig_state, uint8_t *last_state,
+                             const uint8_t *sig_off, const uint8_t *last_off,
+                             int max_coeff, const int *index, int coeff_count){
+    int i, n= 0;
+
+    for(i=0; i<max_coeff-1 && n<coeff_count; i++){
+        int sig= index[n] == i;
+        put_cabac(c, sig_state + sig_off[i], sig);
+        if(sig){
+            n++;
+            put_cabac(c, last_state + last_off[i], n == coeff_count);
+        }
+    }
+}
+
+/**
+ * Check the significance map decoders of the H.264 decoder against the
+ * encoder. Returns the number of failures.
+ */
+static int test_significance(AVLFG *prng){
+    static uint8_t buf[SIG_BLOCKS*20 + 16];
+    static int index[SIG_BLOCKS][64], count[SIG_BLOCKS], max[SIG_BLOCKS];
+    static const int max_coeffs[4]= { 4, 15, 16, 64 };
+    uint8_t ctx_enc[128], ctx_dec[128], sig_off[64], linear[64];
+    CABACContext c;
+    int i, j, fails= 0;
+
+    for(i=0; i<64; i++){
+        sig_off[i]= av_lfg_get(prng) % 15;
+        linear[i]= i;
+    }
+    for(i=0; i<128; i++)
+        ctx_enc[i]= ctx_dec[i]= av_lfg_get(prng) % 126;
+
+    ff_init_cabac_encoder(&c, buf, sizeof(buf));
+    ff_init_cabac_states(&c);
+    for(i=0; i<SIG_BLOCKS; i++){
+        int density= av_lfg_get(prng) % 8 + 1;
+        max[i]= max_coeffs[av_lfg_get(prng) & 3];
+        count[i]= 0;
+        for(j=0; j<max[i]; j++)
+            if(av_lfg_get(prng) % 8 < density)
+                index[i][count[i]++]= j;
+        if(!count[i])
+            index[i][count[i]++]= av_lfg_get(prng) % max[i];
+
+        if(max[i] == 64)
+            put_significance(&c, ctx_enc, ctx_enc + 64, sig_off,
+                             ff_h264_last_coeff_flag_offset_8x8, 64, index[i], count[i]);
+        else
+            put_significance(&c, ctx_enc, ctx_enc + 64, linear, linear,
+                             max[i], index[i], count[i]);
+    }
+    put_cabac_terminate(&c, 1);
+
+    ff_init_cabac_decoder(&c, buf, sizeof(buf));
+    for(i=0; i<SIG_BLOCKS; i++){
+        int dec[64], n;
+
+        if(max[i] == 64)
+            n= decode_significance_8x8_x86(&c, ctx_dec, dec, ctx_dec + 64, sig_off);
+        else
+            n= decode_significance_x86(&c, max[i], ctx_dec, dec, 64);
+
+        if(n != count[i] || memcmp(dec, index[i], n*sizeof(*dec))){
+            av_log(NULL, AV_LOG_ERROR, "CABAC significance map failure at %d\n", i);
+            fails++;
+            break;
+        }
+    }
+    if(memcmp(ctx_enc, ctx_dec, sizeof(ctx_enc))){
+        av_log(NULL, AV_LOG_ERROR, "CABAC significance map context state mismatch\n");
+        fails++;
+    }
+    if(!get_cabac_terminate(&c)){
+        av_log(NULL, AV_LOG_ERROR, "CABAC significance map desync\n");
+        fails++;
+    }
+    return fails;
+}
+#endif
+
 int main(void){
     CABACContext c;
     uint8_t b[9*SIZE];
     uint8_t r[9*SIZE];
     int i;
+    int fails= 0;
     uint8_t state[10]= {0};
     AVLFG prng;
 
@@ -348,15 +454,19 @@ STOP_TIMER("put_cabac_ueg")
 
     for(i=0; i<SIZE; i++){
 START_TIMER
-        if( (r[i]&1) != get_cabac_bypass(&c) )
+        if( (r[i]&1) != get_cabac_bypass(&c) ){
             av_log(NULL, AV_LOG_ERROR, "CABAC bypass failure at %d\n", i);
+            fails++;
+        }
 STOP_TIMER("get_cabac_bypass")
     }
 
     for(i=0; i<SIZE; i++){
 START_TIMER
-        if( (r[i]&1) != get_cabac(&c, state) )
+        if( (r[i]&1) != get_cabac(&c, state) ){
             av_log(NULL, AV_LOG_ERROR, "CABAC failure at %d\n", i);
+            fails++;
+        }
 STOP_TIMER("get_cabac")
     }
 #if 0
@@ -377,7 +487,11 @@ STOP_TIMER("get_cabac_ueg")
     if(!get_cabac_terminate(&c))
         av_log(NULL, AV_LOG_ERROR, "where's the Terminator?\n");
 
-    return 0;
+#if ARCH_X86 && HAVE_7REGS && HAVE_EBX_AVAILABLE
+    fails += test_significance(&prng);
+#endif
+
+    return !!fails;
 }
 
 #endif /* TEST */
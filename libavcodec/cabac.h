@@ -50,11 +50,22 @@ typedef struct CABACContext{
     PutBitContext pb;
 }CABACContext;
 
-extern uint8_t ff_h264_mlps_state[4*64];
-extern uint8_t ff_h264_lps_range[4*2*64];  ///< rangeTabLPS
+/**
+ * The tables used by the decoder, in one array so that asm can address all
+ * of them relative to a single register in position independent code.
+ */
+#define H264_NORM_SHIFT_OFFSET                 0
+#define H264_LPS_RANGE_OFFSET                  512
+#define H264_MLPS_STATE_OFFSET                 1024
+#define H264_LAST_COEFF_FLAG_OFFSET_8x8_OFFSET 1280
+
+extern uint8_t ff_h264_cabac_tables[512 + 4*2*64 + 4*64 + 63];
+#define ff_h264_norm_shift  (ff_h264_cabac_tables + H264_NORM_SHIFT_OFFSET)
+#define ff_h264_lps_range   (ff_h264_cabac_tables + H264_LPS_RANGE_OFFSET)  ///< rangeTabLPS
+#define ff_h264_mlps_state  (ff_h264_cabac_tables + H264_MLPS_STATE_OFFSET)
+#define ff_h264_last_coeff_flag_offset_8x8 (ff_h264_cabac_tables + H264_LAST_COEFF_FLAG_OFFSET_8x8_OFFSET)
 extern uint8_t ff_h264_mps_state[2*64];     ///< transIdxMPS
 extern uint8_t ff_h264_lps_state[2*64];     ///< transIdxLPS
-extern const uint8_t ff_h264_norm_shift[512];
 
 #if ARCH_X86
 #   include "x86/cabac.h"
@@ -168,6 +179,7 @@ static int av_unused get_cabac(CABACContext *c, uint8_t * const state){
     return get_cabac_inline(c,state);
 }
 
+#ifndef get_cabac_bypass
 static int av_unused get_cabac_bypass(CABACContext *c){
     int range;
     c->low += c->low;
@@ -183,6 +195,7 @@ static int av_unused get_cabac_bypass(CABACContext *c){
         return 1;
     }
 }
+#endif
 
 
 #ifndef get_cabac_bypass_sign
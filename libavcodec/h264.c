@@ -810,6 +810,10 @@ static void free_tables(H264Context *h, int free_rbsp){
         }
         if (i) av_freep(&h->thread_context[i]);
     }
+
+    av_freep(&h->deblock_context);
+    ff_thread_progress_free(&h->recon_progress);
+    ff_thread_progress_free(&h->deblock_progress);
 }
 
 static void init_dequant8_coeff_table(H264Context *h){
@@ -962,6 +966,7 @@ fail:
 }
 
 static int decode_nal_units(H264Context *h, const uint8_t *buf, int buf_size);
+static int init_slice_thread_contexts(H264Context *h);
 
 static av_cold void common_init(H264Context *h){
     MpegEncContext * const s = &h->s;
@@ -1138,15 +1143,25 @@ static int decode_update_thread_context(AVCodecContext *dst, const AVCodecContex
         memcpy(&h->s + 1, &h1->s + 1, sizeof(H264Context) - sizeof(MpegEncContext)); //copy all fields after MpegEnc
         memset(h->sps_buffers, 0, sizeof(h->sps_buffers));
         memset(h->pps_buffers, 0, sizeof(h->pps_buffers));
+        memset(h->thread_context, 0, sizeof(h->thread_context));
+        h->thread_context[0] = h;
+        h->deblock_context  = NULL;
+        h->recon_progress   = NULL;
+        h->deblock_progress = NULL;
+        h->deblock_lag      = 0;
         ff_h264_alloc_tables(h);
-        context_init(h);
 
         for(i=0; i<2; i++){
             h->rbsp_buffer[i] = NULL;
             h->rbsp_buffer_size[i] = 0;
         }
 
-        h->thread_context[0] = h;
+        // hybrid threading, the slice contexts of src belong to its thread
+        if (s->avctx->active_thread_type&FF_THREAD_SLICE) {
+            if (init_slice_thread_contexts(h) < 0)
+                return -1;
+        } else
+            context_init(h);
 
         // frame_start may not be called for the next thread (if it's decoding a bottom field)
         // so this has to be allocated here
@@ -2054,11 +2069,14 @@ static void av_noinline hl_decode_mb_444_simple(H264Context *h){
     hl_decode_mb_444_internal(h, 1, 0);
 }
 
+FF_TIMER_PROBE(h264_hl_decode_mb_probe, "h264_hl_decode_mb");
+
 void ff_h264_hl_decode_mb(H264Context *h){
     MpegEncContext * const s = &h->s;
     const int mb_xy= h->mb_xy;
     const int mb_type = s->current_picture.f.mb_type[mb_xy];
     int is_complex = CONFIG_SMALL || h->is_complex || IS_INTRA_PCM(mb_type) || s->qscale == 0;
+    FF_TIMER_PROBE_START(h264_hl_decode_mb_probe);
 
     if (CHROMA444) {
         if(is_complex || h->pixel_shift)
@@ -2071,6 +2089,7 @@ void ff_h264_hl_decode_mb(H264Context *h){
         hl_decode_mb_simple_16(h);
     } else
         hl_decode_mb_simple_8(h);
+    FF_TIMER_PROBE_STOP(h264_hl_decode_mb_probe);
 }
 
 static int pred_weight_table(H264Context *h){
@@ -2340,6 +2359,34 @@ static void init_scan_tables(H264Context *h){
     }
 }
 
+/**
+ * Allocate and initialize the contexts used to decode slices in parallel.
+ */
+static int init_slice_thread_contexts(H264Context *h){
+    MpegEncContext * const s = &h->s;
+    int i;
+
+    for(i = 1; i < s->avctx->thread_count; i++) {
+        H264Context *c;
+        c = h->thread_context[i] = av_malloc(sizeof(H264Context));
+        memcpy(c, h->s.thread_context[i], sizeof(MpegEncContext));
+        memset(&c->s + 1, 0, sizeof(H264Context) - sizeof(MpegEncContext));
+        c->h264dsp = h->h264dsp;
+        c->sps = h->sps;
+        c->pps = h->pps;
+        c->pixel_shift = h->pixel_shift;
+        init_scan_tables(c);
+        clone_tables(c, h, i);
+    }
+
+    for(i = 0; i < s->avctx->thread_count; i++)
+        if (context_init(h->thread_context[i]) < 0) {
+            av_log(h->s.avctx, AV_LOG_ERROR, "context_init() failed.\n");
+            return -1;
+        }
+    return 0;
+}
+
 static int field_end(H264Context *h, int in_setup){
     MpegEncContext * const s = &h->s;
     AVCodecContext * const avctx= s->avctx;
@@ -2627,24 +2674,8 @@ static int decode_slice_header(H264Context *h, H264Context *h0){
                 return -1;
             }
         } else {
-            for(i = 1; i < s->avctx->thread_count; i++) {
-                H264Context *c;
-                c = h->thread_context[i] = av_malloc(sizeof(H264Context));
-                memcpy(c, h->s.thread_context[i], sizeof(MpegEncContext));
-                memset(&c->s + 1, 0, sizeof(H264Context) - sizeof(MpegEncContext));
-                c->h264dsp = h->h264dsp;
-                c->sps = h->sps;
-                c->pps = h->pps;
-                c->pixel_shift = h->pixel_shift;
-                init_scan_tables(c);
-                clone_tables(c, h, i);
-            }
-
-            for(i = 0; i < s->avctx->thread_count; i++)
-                if (context_init(h->thread_context[i]) < 0) {
-                    av_log(h->s.avctx, AV_LOG_ERROR, "context_init() failed.\n");
-                    return -1;
-                }
+            if (init_slice_thread_contexts(h) < 0)
+                return -1;
         }
     }
 
@@ -3250,6 +3281,8 @@ static int fill_filter_caches(H264Context *h, int mb_type){
     return 0;
 }
 
+FF_TIMER_PROBE(h264_loop_filter_probe, "h264_loop_filter");
+
 static void loop_filter(H264Context *h, int start_x, int end_x){
     MpegEncContext * const s = &h->s;
     uint8_t  *dest_y, *dest_cb, *dest_cr;
@@ -3257,6 +3290,13 @@ static void loop_filter(H264Context *h, int start_x, int end_x){
     const int end_mb_y= s->mb_y + FRAME_MBAFF;
     const int old_slice_type= h->slice_type;
     const int pixel_shift = h->pixel_shift;
+    FF_TIMER_PROBE_START(h264_loop_filter_probe);
+
+    if (h->deblock_lag) {
+        /* hand the macroblocks over to the loop filter in deblock_context */
+        h->deblock_end = s->mb_y * s->mb_width + end_x;
+        ff_thread_progress_set(h->recon_progress, h->deblock_end);
+    }
 
     if(h->deblocking_filter) {
         for(mb_x= start_x; mb_x<end_x; mb_x++){
@@ -3308,6 +3348,7 @@ static void loop_filter(H264Context *h, int start_x, int end_x){
     s->mb_y= end_mb_y - FRAME_MBAFF;
     h->chroma_qp[0] = get_chroma_qp(h, 0, s->qscale);
     h->chroma_qp[1] = get_chroma_qp(h, 1, s->qscale);
+    FF_TIMER_PROBE_STOP(h264_loop_filter_probe);
 }
 
 static void predict_field_decoding_flag(H264Context *h){
@@ -3322,16 +3363,16 @@ static void predict_field_decoding_flag(H264Context *h){
 }
 
 /**
- * Draw edges and report progress for the last MB row.
+ * Draw edges and report progress for MB row mb_y.
  */
-static void decode_finish_row(H264Context *h){
+static void finish_row(H264Context *h, int mb_y, int deblocking_filter){
     MpegEncContext * const s = &h->s;
-    int top = 16*(s->mb_y >> FIELD_PICTURE);
+    int top = 16*(mb_y >> FIELD_PICTURE);
     int height = 16 << FRAME_MBAFF;
     int deblock_border = (16 + 4) << FRAME_MBAFF;
     int pic_height = 16*s->mb_height >> FIELD_PICTURE;
 
-    if (h->deblocking_filter) {
+    if (deblocking_filter) {
         if((top + height) >= pic_height)
             height += deblock_border;
 
@@ -3349,12 +3390,27 @@ static void decode_finish_row(H264Context *h){
 
     ff_draw_horiz_band(s, top, height);
 
-    if (s->dropable) return;
+    if (s->dropable || h->parallel_slices) return;
 
     ff_thread_report_progress((AVFrame*)s->current_picture_ptr, top + height - 1,
                              s->picture_structure==PICT_BOTTOM_FIELD);
 }
 
+/**
+ * Draw edges and report progress for the last MB row, or, while the loop
+ * filter lags behind, for the rows it is done with.
+ */
+static void decode_finish_row(H264Context *h){
+    MpegEncContext * const s = &h->s;
+
+    if (h->deblock_lag) {
+        int rows = ff_thread_progress_wait(h->deblock_progress, 0);
+        for (; h->finished_rows < rows; h->finished_rows++)
+            finish_row(h, h->finished_rows, 1);
+    } else
+        finish_row(h, s->mb_y, h->deblocking_filter);
+}
+
 static int decode_slice(struct AVCodecContext *avctx, void *arg){
     H264Context *h = *(void**)arg;
     MpegEncContext * const s = &h->s;
@@ -3490,6 +3546,95 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
     }
 }
 
+/**
+ * Run the loop filter of the slice started in h, one MB row behind
+ * reconstruction: filtering a row changes the bottom lines of the row
+ * above, so it may only start once the next row has been predicted from
+ * the unfiltered samples.
+ */
+static int deblock_slice(H264Context *h){
+    MpegEncContext * const s = &h->s;
+    int mb_y    = s->mb_y;
+    int start_x = s->mb_x;
+
+    while (mb_y < s->mb_height) {
+        int end = ff_thread_progress_wait(h->recon_progress, (mb_y + 2) * s->mb_width);
+        int end_x;
+
+        if (end == INT_MAX)
+            end = h->deblock_end;
+        end_x = FFMIN(end - mb_y * s->mb_width, s->mb_width);
+        if (end_x > start_x) {
+            s->mb_y = mb_y;
+            loop_filter(h, start_x, end_x);
+        }
+        if (end_x < s->mb_width)
+            break;
+        ff_thread_progress_set(h->deblock_progress, ++mb_y);
+        start_x = 0;
+    }
+    return 0;
+}
+
+static int decode_slice_wavefront(AVCodecContext *avctx, void *arg){
+    H264Context *h = *(void**)arg;
+    int ret;
+
+    if (!h->deblock_lag)
+        return deblock_slice(h);
+
+    ret = decode_slice(avctx, arg);
+    h->deblock_context->deblock_end = h->deblock_end;
+    ff_thread_progress_set(h->recon_progress, INT_MAX);
+    return ret;
+}
+
+/**
+ * Decode a slice with its loop filter running in parallel, see
+ * deblock_slice(). Reconstruction then sees the picture exactly as without
+ * any loop filter, so it runs with deblocking disabled.
+ */
+static int decode_slice_deblock_lagging(H264Context *h){
+    MpegEncContext * const s = &h->s;
+    H264Context *hd = h->deblock_context;
+    H264Context *contexts[2] = { h, hd };
+    int ret[2];
+
+    memcpy(hd, h, sizeof(H264Context));
+    hd->deblock_lag   = 0;
+
+    h->deblock_lag    = 1;
+    h->deblock_end    = s->mb_y * s->mb_width + s->mb_x;
+    h->finished_rows  = s->mb_y;
+    ff_thread_progress_set(h->recon_progress,   h->deblock_end);
+    ff_thread_progress_set(h->deblock_progress, s->mb_y);
+    h->deblocking_filter = 0;
+
+    s->avctx->execute(s->avctx, decode_slice_wavefront, contexts, ret, 2, sizeof(void*));
+
+    h->deblocking_filter = hd->deblocking_filter;
+    decode_finish_row(h);
+    h->deblock_lag = 0;
+
+    return ret[0];
+}
+
+static int init_deblock_context(H264Context *h){
+    if (h->deblock_context)
+        return 0;
+
+    h->deblock_context  = av_malloc(sizeof(H264Context));
+    h->recon_progress   = ff_thread_progress_alloc();
+    h->deblock_progress = ff_thread_progress_alloc();
+    if (!h->deblock_context || !h->recon_progress || !h->deblock_progress) {
+        av_freep(&h->deblock_context);
+        ff_thread_progress_free(&h->recon_progress);
+        ff_thread_progress_free(&h->deblock_progress);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
 /**
  * Call decode_slice() for each context.
  *
@@ -3505,6 +3650,10 @@ static int execute_decode_slices(H264Context *h, int context_count){
     if (s->avctx->hwaccel || s->avctx->codec->capabilities&CODEC_CAP_HWACCEL_VDPAU)
         return 0;
     if(context_count == 1) {
+        if (HAVE_PTHREADS && h->deblocking_filter && !FIELD_PICTURE && !FRAME_MBAFF &&
+            (avctx->active_thread_type&FF_THREAD_SLICE) && avctx->thread_count > 1 &&
+            init_deblock_context(h) >= 0)
+            return decode_slice_deblock_lagging(h);
         return decode_slice(avctx, &h);
     } else {
         for(i = 1; i < context_count; i++) {
@@ -3512,11 +3661,15 @@ static int execute_decode_slices(H264Context *h, int context_count){
             hx->s.error_recognition = avctx->error_recognition;
             hx->s.error_count = 0;
             hx->x264_build= h->x264_build;
+            hx->parallel_slices = 1;
         }
+        h->parallel_slices = 1;
 
         avctx->execute(avctx, (void *)decode_slice,
                        h->thread_context, NULL, context_count, sizeof(void*));
 
+        h->parallel_slices = 0;
+
         /* pull back stuff from slices to master context */
         hx = h->thread_context[context_count - 1];
         s->mb_x = hx->s.mb_x;
@@ -534,9 +534,31 @@ typedef struct H264Context{
      */
     int single_decode_warning;
 
+    /**
+     * 1 while this context decodes a slice in parallel with other slices
+     * of the same picture. Rows may then complete out of order, so
+     * progress is only reported once all slices are done.
+     */
+    int parallel_slices;
+
     int last_slice_type;
     /** @} */
 
+    /**
+     * @name Members for wavefront deblocking
+     * With slice threading, a picture decoded one slice at a time has its
+     * loop filter run in deblock_context by another job, one macroblock
+     * row behind reconstruction.
+     * @{
+     */
+    struct H264Context *deblock_context;
+    struct ThreadProgress *recon_progress;   ///< reconstructed MBs handed to the loop filter, as mb_y*mb_width+mb_x
+    struct ThreadProgress *deblock_progress; ///< number of MB rows the loop filter is done with
+    int deblock_lag;    ///< 1 in the reconstructing context while the loop filter lags behind
+    int deblock_end;    ///< end of the slice for the loop filter, valid once recon_progress is INT_MAX
+    int finished_rows;  ///< number of MB rows decode_finish_row() was done for
+    /** @} */
+
     /**
      * pic_struct in picture timing SEI message
      */
@@ -55,4 +55,42 @@ int ff_match_2uint16(const uint16_t (*tab)[2], int size, int a, int b);
 
 unsigned int ff_toupper4(unsigned int x);
 
+/**
+ * Allocate a packet payload buffer of at least size bytes from the packet
+ * pool. The caller is responsible for including FF_INPUT_BUFFER_PADDING_SIZE.
+ * The buffer must be released with ff_packet_pool_free() or, once attached
+ * to an AVPacket, by setting its destruct callback to
+ * ff_packet_pool_destruct(); it must not be passed to av_free()/av_realloc().
+ */
+void *ff_packet_pool_alloc(unsigned int size);
+
+/**
+ * Return a buffer allocated with ff_packet_pool_alloc() to the pool.
+ */
+void ff_packet_pool_free(void *ptr);
+
+/**
+ * AVPacket destruct callback for payloads allocated from the packet pool.
+ */
+void ff_packet_pool_destruct(AVPacket *pkt);
+
+/**
+ * Same as av_new_packet(), but with the payload allocated from the packet
+ * pool. The packet must be released with av_free_packet().
+ */
+int ff_packet_pool_new_packet(AVPacket *pkt, int size);
+
+/**
+ * Same as av_dup_packet(), but with the payload allocated from the packet
+ * pool. The packet must be released with av_free_packet().
+ */
+int ff_packet_pool_dup_packet(AVPacket *pkt);
+
+/**
+ * Close a codec context that was opened by a codec for its own use, from
+ * within that codec's close callback. This is avcodec_close() without the
+ * codec lock, which the caller already holds.
+ */
+void ff_codec_close_nested(AVCodecContext *avctx);
+
 #endif /* AVCODEC_INTERNAL_H */
@@ -146,6 +146,112 @@ static int estimate_best_order(double *ref, int min_order, int max_order)
     return est;
 }
 
+/**
+ * Compute the residual of LPC prediction, two samples at a time.
+ */
+#define LPC1(x) {\
+    int c = coefs[(x)-1];\
+    p0   += c * s;\
+    s     = smp[i-(x)+1];\
+    p1   += c * s;\
+}
+
+static av_always_inline void lpc_compute_residual_unrolled(int32_t *res,
+                                    const int32_t *smp, int n, int order,
+                                    const int32_t *coefs, int shift, int big)
+{
+    int i;
+    for (i = order; i < n; i += 2) {
+        int s  = smp[i-order];
+        int p0 = 0, p1 = 0;
+        if (big) {
+            switch (order) {
+            case 32: LPC1(32)
+            case 31: LPC1(31)
+            case 30: LPC1(30)
+            case 29: LPC1(29)
+            case 28: LPC1(28)
+            case 27: LPC1(27)
+            case 26: LPC1(26)
+            case 25: LPC1(25)
+            case 24: LPC1(24)
+            case 23: LPC1(23)
+            case 22: LPC1(22)
+            case 21: LPC1(21)
+            case 20: LPC1(20)
+            case 19: LPC1(19)
+            case 18: LPC1(18)
+            case 17: LPC1(17)
+            case 16: LPC1(16)
+            case 15: LPC1(15)
+            case 14: LPC1(14)
+            case 13: LPC1(13)
+            case 12: LPC1(12)
+            case 11: LPC1(11)
+            case 10: LPC1(10)
+            case  9: LPC1( 9)
+                     LPC1( 8)
+                     LPC1( 7)
+                     LPC1( 6)
+                     LPC1( 5)
+                     LPC1( 4)
+                     LPC1( 3)
+                     LPC1( 2)
+                     LPC1( 1)
+            }
+        } else {
+            switch (order) {
+            case  8: LPC1( 8)
+            case  7: LPC1( 7)
+            case  6: LPC1( 6)
+            case  5: LPC1( 5)
+            case  4: LPC1( 4)
+            case  3: LPC1( 3)
+            case  2: LPC1( 2)
+            case  1: LPC1( 1)
+            }
+        }
+        res[i  ] = smp[i  ] - (p0 >> shift);
+        res[i+1] = smp[i+1] - (p1 >> shift);
+    }
+}
+
+
+static void lpc_compute_residual_c(int32_t *res, const int32_t *smp, int n,
+                                   int order, const int32_t *coefs, int shift)
+{
+    int i;
+    for (i = 0; i < order; i++)
+        res[i] = smp[i];
+#if CONFIG_SMALL
+    for (i = order; i < n; i += 2) {
+        int j;
+        int s  = smp[i];
+        int p0 = 0, p1 = 0;
+        for (j = 0; j < order; j++) {
+            int c = coefs[j];
+            p1   += c * s;
+            s     = smp[i-j-1];
+            p0   += c * s;
+        }
+        res[i  ] = smp[i  ] - (p0 >> shift);
+        res[i+1] = smp[i+1] - (p1 >> shift);
+    }
+#else
+    switch (order) {
+    case  1: lpc_compute_residual_unrolled(res, smp, n, 1, coefs, shift, 0); break;
+    case  2: lpc_compute_residual_unrolled(res, smp, n, 2, coefs, shift, 0); break;
+    case  3: lpc_compute_residual_unrolled(res, smp, n, 3, coefs, shift, 0); break;
+    case  4: lpc_compute_residual_unrolled(res, smp, n, 4, coefs, shift, 0); break;
+    case  5: lpc_compute_residual_unrolled(res, smp, n, 5, coefs, shift, 0); break;
+    case  6: lpc_compute_residual_unrolled(res, smp, n, 6, coefs, shift, 0); break;
+    case  7: lpc_compute_residual_unrolled(res, smp, n, 7, coefs, shift, 0); break;
+    case  8: lpc_compute_residual_unrolled(res, smp, n, 8, coefs, shift, 0); break;
+    default: lpc_compute_residual_unrolled(res, smp, n, order, coefs, shift, 1); break;
+    }
+#endif
+}
+
 /**
  * Calculate LPC coefficients for multiple orders
  *
@@ -256,6 +362,7 @@ av_cold int ff_lpc_init(LPCContext *s, int blocksize, int max_order,
 
     s->lpc_apply_welch_window = lpc_apply_welch_window_c;
     s->lpc_compute_autocorr   = lpc_compute_autocorr_c;
+    s->lpc_compute_residual   = lpc_compute_residual_c;
 
     if (HAVE_MMX)
         ff_lpc_init_x86(s);
@@ -78,6 +78,20 @@ typedef struct LPCContext {
      */
     void (*lpc_compute_autocorr)(const double *data, int len, int lag,
                                  double *autoc);
+    /**
+     * Compute the residual of LPC prediction on input samples.
+     * @param res    output residual, the first order values are copies of
+     *               the input samples.
+     *               constraints: array size must be at least len+1.
+     * @param smp    input samples
+     *               constraints: must have at least len+1 readable values.
+     * @param len    number of input samples
+     * @param order  prediction order
+     * @param coefs  quantized LPC coefficients
+     * @param shift  right shift applied to the prediction
+     */
+    void (*lpc_compute_residual)(int32_t *res, const int32_t *smp, int len,
+                                 int order, const int32_t *coefs, int shift);
 } LPCContext;
 
 
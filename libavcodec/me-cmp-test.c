@@ -0,0 +1,226 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * me_cmp_func test and benchmark.
+ * Checks every optimized comparison function of DSPContext against its C
+ * version; with -t it also reports the cycles per call of both.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "libavutil/cpu.h"
+#include "libavutil/lfg.h"
+#include "libavutil/timer.h"
+#include "dsputil.h"
+#include "mpegvideo.h"
+
+#undef exit
+#undef printf
+
+#define WIDTH  64
+#define HEIGHT 64
+#define NB_ITS 200
+
+DECLARE_ALIGNED(16, static uint8_t, img1)[WIDTH * HEIGHT];
+DECLARE_ALIGNED(16, static uint8_t, img2)[WIDTH * HEIGHT];
+
+/* quant_psnr, bit and rd need a fully initialized encoder and are left out;
+ * dct_sad and dct_max are C functions built on the diff_pixels, fdct and
+ * sum_abs_dctelem members, so they are optimized through those */
+static const struct {
+    const char *name;
+    int offset;
+    int uses_fdct;
+} tables[] = {
+    { "sad",            offsetof(DSPContext, sad)            },
+    { "sse",            offsetof(DSPContext, sse)            },
+    { "hadamard8_diff", offsetof(DSPContext, hadamard8_diff) },
+    { "dct_sad",        offsetof(DSPContext, dct_sad),     1 },
+    { "dct264_sad",     offsetof(DSPContext, dct264_sad)     },
+    { "dct_max",        offsetof(DSPContext, dct_max),     1 },
+    { "vsad",           offsetof(DSPContext, vsad)           },
+    { "vsse",           offsetof(DSPContext, vsse)           },
+    { "nsse",           offsetof(DSPContext, nsse)           },
+    { "w53",            offsetof(DSPContext, w53)            },
+    { "w97",            offsetof(DSPContext, w97)            },
+};
+
+/* index into the tables, block width and height */
+static const int sizes[][3] = {
+    { 0, 16, 16 },
+    { 1,  8,  8 },
+    { 4, 16, 16 },
+    { 5,  8,  8 },
+};
+
+static void fill_random(AVLFG *prng, uint8_t *tab, int size)
+{
+    int i;
+    for (i = 0; i < size; i++)
+        tab[i] = av_lfg_get(prng) % 256;
+}
+
+#ifdef AV_READ_TIME
+#define get_time() AV_READ_TIME()
+#else
+static int64_t get_time(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec) * 1000;
+}
+#endif
+
+int dummy;
+
+/**
+ * @return the average time of one call, in cycles if AV_READ_TIME is
+ *         available and in nanoseconds otherwise
+ */
+static double bench(me_cmp_func func, MpegEncContext *s, int w, int h)
+{
+    uint64_t t;
+    int x, y, it, sum = 0;
+
+    t = get_time();
+    for (it = 0; it < NB_ITS; it++)
+        for (y = 0; y <= HEIGHT - h - 1; y++)
+            for (x = 0; x <= WIDTH - w - 1; x += w)
+                sum += func(s, img1 + y * WIDTH + x, img2 + y * WIDTH + x + 1,
+                            WIDTH, h);
+    t = get_time() - t;
+    emms_c();
+    dummy = sum; /* avoid optimization */
+    return (double)t / (NB_ITS * (HEIGHT - h) * ((WIDTH - 1) / w));
+}
+
+static int check(me_cmp_func func, me_cmp_func ref_func,
+                 MpegEncContext *s, MpegEncContext *ref_s, int w, int h)
+{
+    int x, y, d1, d2;
+
+    for (y = 0; y <= HEIGHT - h - 1; y++) {
+        for (x = 0; x <= WIDTH - w - 1; x += w) {
+            uint8_t *pix1 = img1 + y * WIDTH + x;
+            uint8_t *pix2 = img2 + y * WIDTH + x + (y & 7);
+            d1 = func    (s,     pix1, pix2, WIDTH, h);
+            emms_c();
+            d2 = ref_func(ref_s, pix1, pix2, WIDTH, h);
+            if (d1 != d2) {
+                printf("error at %d,%d: opt=%d c=%d\n", x, y, d1, d2);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void help(void)
+{
+    printf("me-cmp-test [-t]\n"
+           "-t  speed test\n");
+}
+
+int main(int argc, char **argv)
+{
+    AVCodecContext *ctx;
+    MpegEncContext copt, cref, cfdct;
+    AVLFG prng;
+    int c, i, j, it, ret = 0;
+    int speed = 0;
+
+    for (;;) {
+        c = getopt(argc, argv, "ht");
+        if (c == -1)
+            break;
+        switch (c) {
+        case 't':
+            speed = 1;
+            break;
+        default:
+        case 'h':
+            help();
+            return 0;
+        }
+    }
+
+    printf("ffmpeg me_cmp test\n");
+
+    dsputil_static_init();
+
+    ctx = avcodec_alloc_context3(NULL);
+    ctx->flags |= CODEC_FLAG_BITEXACT;
+    ctx->nsse_weight = 8;
+
+    memset(&copt, 0, sizeof(copt));
+    memset(&cref, 0, sizeof(cref));
+    copt.avctx = cref.avctx = ctx;
+    dsputil_init(&copt.dsp, ctx);
+    av_force_cpu_flags(0);
+    dsputil_init(&cref.dsp, ctx);
+    /* the optimized fdct is not bitexact with the C one, it is checked by
+     * dct-test; compare the functions using it with a C context using it */
+    cfdct = cref;
+    cfdct.dsp.fdct = copt.dsp.fdct;
+
+    av_lfg_init(&prng, 1);
+    fill_random(&prng, img1, WIDTH * HEIGHT);
+    fill_random(&prng, img2, WIDTH * HEIGHT);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tables); i++) {
+        for (j = 0; j < FF_ARRAY_ELEMS(sizes); j++) {
+            int idx = sizes[j][0], w = sizes[j][1], h = sizes[j][2];
+            me_cmp_func opt = ((me_cmp_func *)((uint8_t *)&copt.dsp + tables[i].offset))[idx];
+            me_cmp_func ref = ((me_cmp_func *)((uint8_t *)&cref.dsp + tables[i].offset))[idx];
+
+            char size[8];
+
+            if (!ref)
+                continue;
+
+            snprintf(size, sizeof(size), "%dx%d", w, h);
+            printf("%-14s[%d] %5s", tables[i].name, idx, size);
+            if (speed)
+                printf("  c: %7.1f", bench(ref, &cref, w, h));
+            if (opt != ref || tables[i].uses_fdct) {
+                for (it = 0; it < 20; it++) {
+                    fill_random(&prng, img1, WIDTH * HEIGHT);
+                    fill_random(&prng, img2, WIDTH * HEIGHT);
+                    if (check(opt, ref, &copt, tables[i].uses_fdct ? &cfdct : &cref, w, h) < 0) {
+                        ret = 1;
+                        break;
+                    }
+                }
+                if (speed)
+                    printf("  opt: %7.1f", bench(opt, &copt, w, h));
+            }
+            printf("\n");
+        }
+    }
+    av_free(ctx);
+
+    return ret;
+}
@@ -37,6 +37,7 @@
 #include "libavutil/avassert.h"
 #include "avcodec.h"
 #include "dsputil.h"
+#include "thread.h"
 #include "mjpeg.h"
 #include "mjpegdec.h"
 #include "jpeglsdec.h"
@@ -63,19 +64,48 @@ static int build_vlc(VLC *vlc, const uint8_t *bits_table, const uint8_t *val_tab
     return init_vlc_sparse(vlc, 9, nb_codes, huff_size, 1, 1, huff_code, 2, 2, huff_sym, 2, 2, use_static);
 }
 
+/**
+ * Build the VLCs of one DHT table and remember the table definition, so that
+ * other frame threads can rebuild them.
+ */
+static int init_huffman_table(MJpegDecodeContext *s, int class, int index,
+                              const uint8_t *bits_table, const uint8_t *val_table)
+{
+    int i, n = 0, code_max = 0;
+
+    for(i=1;i<=16;i++)
+        n += bits_table[i];
+    for(i=0;i<n;i++)
+        code_max = FFMAX(code_max, val_table[i]);
+
+    memcpy(s->huff_bits[class][index], bits_table, 17);
+    memcpy(s->huff_vals[class][index], val_table, n);
+    memset(s->huff_vals[class][index] + n, 0, 256 - n);
+
+    /* build VLC and flush previous vlc if present */
+    free_vlc(&s->vlcs[class][index]);
+    av_log(s->avctx, AV_LOG_DEBUG, "class=%d index=%d nb_codes=%d\n",
+           class, index, code_max + 1);
+    if(build_vlc(&s->vlcs[class][index], bits_table, val_table, code_max + 1, 0, class > 0) < 0)
+        return -1;
+
+    if(class>0){
+        free_vlc(&s->vlcs[2][index]);
+        if(build_vlc(&s->vlcs[2][index], bits_table, val_table, code_max + 1, 0, 0) < 0)
+            return -1;
+    }
+    return 0;
+}
+
 static void build_basic_mjpeg_vlc(MJpegDecodeContext * s) {
-    build_vlc(&s->vlcs[0][0], ff_mjpeg_bits_dc_luminance,
-              ff_mjpeg_val_dc, 12, 0, 0);
-    build_vlc(&s->vlcs[0][1], ff_mjpeg_bits_dc_chrominance,
-              ff_mjpeg_val_dc, 12, 0, 0);
-    build_vlc(&s->vlcs[1][0], ff_mjpeg_bits_ac_luminance,
-              ff_mjpeg_val_ac_luminance, 251, 0, 1);
-    build_vlc(&s->vlcs[1][1], ff_mjpeg_bits_ac_chrominance,
-              ff_mjpeg_val_ac_chrominance, 251, 0, 1);
-    build_vlc(&s->vlcs[2][0], ff_mjpeg_bits_ac_luminance,
-              ff_mjpeg_val_ac_luminance, 251, 0, 0);
-    build_vlc(&s->vlcs[2][1], ff_mjpeg_bits_ac_chrominance,
-              ff_mjpeg_val_ac_chrominance, 251, 0, 0);
+    init_huffman_table(s, 0, 0, ff_mjpeg_bits_dc_luminance,
+                       ff_mjpeg_val_dc);
+    init_huffman_table(s, 0, 1, ff_mjpeg_bits_dc_chrominance,
+                       ff_mjpeg_val_dc);
+    init_huffman_table(s, 1, 0, ff_mjpeg_bits_ac_luminance,
+                       ff_mjpeg_val_ac_luminance);
+    init_huffman_table(s, 1, 1, ff_mjpeg_bits_ac_chrominance,
+                       ff_mjpeg_val_ac_chrominance);
 }
 
 av_cold int ff_mjpeg_decode_init(AVCodecContext *avctx)
@@ -120,6 +150,147 @@ av_cold int ff_mjpeg_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+static av_cold int mjpeg_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    uint8_t bits_table[17];
+    uint8_t val_table[256];
+    int i, j;
+
+    s->avctx = avctx;
+    s->picture_ptr = &s->picture;
+    s->buffer_size = 0;
+    s->buffer = NULL;
+    s->qscale_table = NULL;
+    s->ljpeg_buffer = NULL;
+    s->ljpeg_buffer_size = 0;
+    s->restart_offsets = NULL;
+    s->restart_offsets_size = 0;
+    s->restart_rets = NULL;
+    s->restart_rets_size = 0;
+    for(i=0; i<MAX_COMPONENTS; i++) {
+        s->blocks[i] = NULL;
+        s->last_nnz[i] = NULL;
+    }
+
+    /* the VLC tables belong to the first thread, rebuild our own */
+    for(i=0;i<2;i++) {
+        for(j=0;j<4;j++) {
+            int defined = !!s->vlcs[i][j].table;
+            memset(&s->vlcs[i][j], 0, sizeof(VLC));
+            if (i)
+                memset(&s->vlcs[2][j], 0, sizeof(VLC));
+            if (!defined)
+                continue;
+            memcpy(bits_table, s->huff_bits[i][j], sizeof(bits_table));
+            memcpy(val_table,  s->huff_vals[i][j], sizeof(val_table));
+            if (init_huffman_table(s, i, j, bits_table, val_table) < 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int mjpeg_decode_update_thread_context(AVCodecContext *dst,
+                                              const AVCodecContext *src)
+{
+    MJpegDecodeContext *s = dst->priv_data;
+    const MJpegDecodeContext *s1 = src->priv_data;
+    int i, j;
+
+    if (dst == src)
+        return 0;
+
+    /* DQT and DHT segments may be left out in later frames, carry the
+       tables over from the previous frame */
+    memcpy(s->quant_matrixes, s1->quant_matrixes, sizeof(s->quant_matrixes));
+    memcpy(s->qscale, s1->qscale, sizeof(s->qscale));
+    for(i=0;i<2;i++) {
+        for(j=0;j<4;j++) {
+            if (!memcmp(s->huff_bits[i][j], s1->huff_bits[i][j], 17) &&
+                !memcmp(s->huff_vals[i][j], s1->huff_vals[i][j], 256))
+                continue;
+            if (init_huffman_table(s, i, j, s1->huff_bits[i][j],
+                                   s1->huff_vals[i][j]) < 0)
+                return -1;
+        }
+    }
+
+    /* frame size, field pairing and the state set by APPx, COM and LSE
+       segments also last across frames */
+    if (s1->width && (s->width != s1->width || !s->qscale_table)) {
+        av_freep(&s->qscale_table);
+        s->qscale_table = av_mallocz((s1->width+15)/16);
+        if (!s->qscale_table)
+            return AVERROR(ENOMEM);
+    }
+    s->width         = s1->width;
+    s->height        = s1->height;
+    s->first_picture = s1->first_picture;
+    s->interlaced    = s1->interlaced;
+    s->bottom_field  = s1->bottom_field;
+    s->picture.interlaced_frame = s1->picture.interlaced_frame;
+    s->picture.top_field_first  = s1->picture.top_field_first;
+    s->restart_interval = s1->restart_interval;
+    s->buggy_avid    = s1->buggy_avid;
+    s->cs_itu601     = s1->cs_itu601;
+    s->flipped       = s1->flipped;
+    s->rgb           = s1->rgb;
+    s->rct           = s1->rct;
+    s->pegasus_rct   = s1->pegasus_rct;
+    s->maxval        = s1->maxval;
+    s->t1            = s1->t1;
+    s->t2            = s1->t2;
+    s->t3            = s1->t3;
+    s->reset         = s1->reset;
+    return 0;
+}
+
+/**
+ * Check whether the rest of the packet holds segments that change the
+ * state the next frame thread starts from. A 0xff byte in entropy coded
+ * data is always followed by 0x00 or an RST marker, so only real segments
+ * (or bytes inside other segments, which is harmless) can match.
+ */
+static int state_changes_follow(const uint8_t *buf, const uint8_t *buf_end)
+{
+    while (buf_end - buf >= 2) {
+        buf = memchr(buf, 0xff, buf_end - buf - 1);
+        if (!buf)
+            return 0;
+        buf++;
+        switch (*buf) {
+        case DQT: case DHT: case DRI: case COM: case LSE:
+        case SOF0: case SOF1: case SOF2: case SOF3: case SOF48:
+            return 1;
+        }
+        if (*buf >= APP0 && *buf <= APP15)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Let the next frame thread start from the current state.
+ * @param buf     rest of the packet, NULL once the frame is decoded
+ * @param buf_end end of the packet
+ *
+ * Setup is finished at the first scan of the frame, unless later segments
+ * may still change the state or the frame is interlaced; the field pairing
+ * is only settled at the EOI markers, so interlaced frames are decoded one
+ * after another.
+ */
+static void mjpeg_finish_setup(MJpegDecodeContext *s,
+                               const uint8_t *buf, const uint8_t *buf_end)
+{
+    if (s->setup_finished || !(s->avctx->active_thread_type & FF_THREAD_FRAME))
+        return;
+    if (buf && (s->interlaced || state_changes_follow(buf, buf_end)))
+        return;
+    s->setup_finished = 1;
+    ff_thread_finish_setup(s->avctx);
+}
+
 
 /* quantize tables */
 int ff_mjpeg_decode_dqt(MJpegDecodeContext *s)
@@ -159,7 +330,7 @@ int ff_mjpeg_decode_dqt(MJpegDecodeContext *s)
 /* decode huffman tables and build VLC decoders */
 int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
 {
-    int len, index, i, class, n, v, code_max;
+    int len, index, i, class, n;
     uint8_t bits_table[17];
     uint8_t val_table[256];
 
@@ -175,6 +346,7 @@ int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
         if (index >= 4)
             return -1;
         n = 0;
+        bits_table[0] = 0;
         for(i=1;i<=16;i++) {
             bits_table[i] = get_bits(&s->gb, 8);
             n += bits_table[i];
@@ -183,29 +355,12 @@ int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
         if (len < n || n > 256)
             return -1;
 
-        code_max = 0;
-        for(i=0;i<n;i++) {
-            v = get_bits(&s->gb, 8);
-            if (v > code_max)
-                code_max = v;
-            val_table[i] = v;
-        }
+        for(i=0;i<n;i++)
+            val_table[i] = get_bits(&s->gb, 8);
         len -= n;
 
-        /* build VLC and flush previous vlc if present */
-        free_vlc(&s->vlcs[class][index]);
-        av_log(s->avctx, AV_LOG_DEBUG, "class=%d index=%d nb_codes=%d\n",
-               class, index, code_max + 1);
-        if(build_vlc(&s->vlcs[class][index], bits_table, val_table, code_max + 1, 0, class > 0) < 0){
-            return -1;
-        }
-
-        if(class>0){
-            free_vlc(&s->vlcs[2][index]);
-            if(build_vlc(&s->vlcs[2][index], bits_table, val_table, code_max + 1, 0, 0) < 0){
+        if (init_huffman_table(s, class, index, bits_table, val_table) < 0)
             return -1;
-            }
-        }
     }
     return 0;
 }
@@ -348,9 +503,9 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     }
 
     if(s->picture_ptr->data[0])
-        s->avctx->release_buffer(s->avctx, s->picture_ptr);
+        ff_thread_release_buffer(s->avctx, s->picture_ptr);
 
-    if(s->avctx->get_buffer(s->avctx, s->picture_ptr) < 0){
+    if(ff_thread_get_buffer(s->avctx, s->picture_ptr) < 0){
         av_log(s->avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return -1;
     }
@@ -386,10 +541,10 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb, int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0)
     {
         av_log(s->avctx, AV_LOG_WARNING, "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n", 0, dc_index,
@@ -398,46 +553,47 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if(code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, DCTELEM *block,
-                        int component, int dc_index, int ac_index, int16_t *quant_matrix)
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        DCTELEM *block, int component, int dc_index, int ac_index,
+                        int16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return -1;
     }
-    val = val * quant_matrix[0] + s->last_dc[component];
-    s->last_dc[component] = val;
+    val = val * quant_matrix[0] + last_dc[component];
+    last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if(code){
             if(code > MIN_CACHE_BITS - 16){
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
             }
             {
-                int cache=GET_CACHE(re,&s->gb);
+                int cache=GET_CACHE(re,gb);
                 int sign=(~cache)>>31;
                 level = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -447,7 +603,7 @@ static int decode_block(MJpegDecodeContext *s, DCTELEM *block,
             block[j] = level * quant_matrix[j];
         }
     }while(i<63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -457,7 +613,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, DCTELEM *block, int comp
 {
     int val;
     s->dsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return -1;
@@ -660,7 +816,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int predictor, int point
                 PREDICT(pred, topleft[i], top[i], left[i], modified_predictor);
 
                 left[i]=
-                buffer[mb_x][i]= mask & (pred + (mjpeg_decode_dc(s, s->dc_index[i]) << point_transform));
+                buffer[mb_x][i]= mask & (pred + (mjpeg_decode_dc(s, &s->gb, s->dc_index[i]) << point_transform));
             }
 
             if (s->restart_interval && !--s->restart_count) {
@@ -733,7 +889,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor, int point
 
                         if (s->interlaced && s->bottom_field)
                             ptr += linesize >> 1;
-                        *ptr= pred + (mjpeg_decode_dc(s, s->dc_index[i]) << point_transform);
+                        *ptr= pred + (mjpeg_decode_dc(s, &s->gb, s->dc_index[i]) << point_transform);
 
                         if (++x == h) {
                             x = 0;
@@ -758,7 +914,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor, int point
 
                         ptr = s->picture.data[c] + (linesize * (v * mb_y + y)) + (h * mb_x + x); //FIXME optimize this crap
                         PREDICT(pred, ptr[-linesize-1], ptr[-linesize], ptr[-1], predictor);
-                        *ptr= pred + (mjpeg_decode_dc(s, s->dc_index[i]) << point_transform);
+                        *ptr= pred + (mjpeg_decode_dc(s, &s->gb, s->dc_index[i]) << point_transform);
                         if (++x == h) {
                             x = 0;
                             y++;
@@ -790,6 +946,81 @@ static av_always_inline void mjpeg_copy_block(uint8_t *dst, const uint8_t *src,
     }
 }
 
+/**
+ * Baseline scan whose restart intervals are decoded in parallel.
+ */
+typedef struct RestartScan {
+    uint8_t *data[MAX_COMPONENTS];
+    int linesize[MAX_COMPONENTS];
+    int nb_components;
+    int start;                  ///< offset of the entropy coded data in buffer
+    int size;                   ///< size of the unescaped scan in buffer
+} RestartScan;
+
+/**
+ * Decode one restart interval of a baseline scan, an execute2() job.
+ * Every interval begins byte aligned after an RST marker with reset DC
+ * predictors, so intervals do not depend on each other.
+ */
+static int decode_restart_interval(AVCodecContext *avctx, void *arg,
+                                   int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    const RestartScan *scan = arg;
+    GetBitContext gb;
+    int last_dc[MAX_COMPONENTS];
+    LOCAL_ALIGNED_16(DCTELEM, block, [64]);
+    int start  = jobnr ? s->restart_offsets[jobnr - 1] : scan->start;
+    int end    = jobnr < s->nb_restart_markers ? s->restart_offsets[jobnr] - 2 : scan->size;
+    int mb     = jobnr * s->restart_interval;
+    int mb_end = FFMIN(mb + s->restart_interval, s->mb_width * s->mb_height);
+    int i;
+
+    if (end < start)
+        return -1;
+    init_get_bits(&gb, s->buffer + start, (end - start) * 8);
+    for (i = 0; i < scan->nb_components; i++)
+        last_dc[i] = 1024;
+
+    for (; mb < mb_end; mb++) {
+        int mb_x = mb % s->mb_width;
+        int mb_y = mb / s->mb_width;
+
+        if (get_bits_count(&gb) > gb.size_in_bits) {
+            av_log(avctx, AV_LOG_ERROR, "overread %d\n", get_bits_count(&gb) - gb.size_in_bits);
+            return -1;
+        }
+        for (i = 0; i < scan->nb_components; i++) {
+            int c = s->comp_index[i];
+            int h = s->h_scount[i];
+            int v = s->v_scount[i];
+            int linesize = scan->linesize[c];
+            int x = 0, y = 0, j;
+
+            for (j = 0; j < s->nb_blocks[i]; j++) {
+                int block_offset = (((linesize * (v * mb_y + y) * 8) +
+                                     (h * mb_x + x) * 8) >> avctx->lowres);
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += linesize >> 1;
+                s->dsp.clear_block(block);
+                if (decode_block(s, &gb, last_dc, block, i,
+                                 s->dc_index[i], s->ac_index[i],
+                                 s->quant_matrixes[ s->quant_index[c] ]) < 0) {
+                    av_log(avctx, AV_LOG_ERROR, "error y=%d x=%d\n", mb_y, mb_x);
+                    return -1;
+                }
+                s->dsp.idct_put(scan->data[c] + block_offset, linesize, block);
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, int Al,
                              const uint8_t *mb_bitmask, const AVFrame *reference){
     int i, mb_x, mb_y;
@@ -821,6 +1052,32 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, i
         }
     }
 
+    if (!s->progressive && !mb_bitmask && s->restart_interval &&
+        (s->avctx->active_thread_type & FF_THREAD_SLICE) && s->avctx->thread_count > 1) {
+        int nb_intervals = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                           s->restart_interval;
+
+        if (s->nb_restart_markers >= nb_intervals - 1) {
+            RestartScan scan;
+
+            av_fast_malloc(&s->restart_rets, &s->restart_rets_size,
+                           nb_intervals * sizeof(*s->restart_rets));
+            if (!s->restart_rets)
+                return AVERROR(ENOMEM);
+            memcpy(scan.data,     data,     sizeof(scan.data));
+            memcpy(scan.linesize, linesize, sizeof(scan.linesize));
+            scan.nb_components = nb_components;
+            scan.start = get_bits_count(&s->gb) >> 3;
+            scan.size  = s->gb.size_in_bits >> 3;
+            s->avctx->execute2(s->avctx, decode_restart_interval, &scan,
+                               s->restart_rets, nb_intervals);
+            for (i = 0; i < nb_intervals; i++)
+                if (s->restart_rets[i] < 0)
+                    return s->restart_rets[i];
+            return 0;
+        }
+    }
+
     for(mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for(mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -854,7 +1111,7 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, i
                             mjpeg_copy_block(ptr, reference_data[c] + block_offset, linesize[c], s->avctx->lowres);
                         } else {
                         s->dsp.clear_block(s->block);
-                        if(decode_block(s, s->block, i,
+                        if(decode_block(s, &s->gb, s->last_dc, s->block, i,
                                      s->dc_index[i], s->ac_index[i],
                                      s->quant_matrixes[ s->quant_index[c] ]) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR, "error y=%d x=%d\n", mb_y, mb_x);
@@ -1305,7 +1562,11 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                 {
                     const uint8_t *src = *buf_ptr;
                     uint8_t *dst = s->buffer;
+                    /* remember where restart intervals start for slice threads */
+                    int record_rst = s->restart_interval &&
+                                     (s->avctx->active_thread_type & FF_THREAD_SLICE);
 
+                    s->nb_restart_markers = 0;
                     while (src<buf_end)
                     {
                         uint8_t x = *(src++);
@@ -1317,9 +1578,21 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                                 while (src < buf_end && x == 0xff)
                                     x = *(src++);
 
-                                if (x >= 0xd0 && x <= 0xd7)
+                                if (x >= 0xd0 && x <= 0xd7) {
                                     *(dst++) = x;
-                                else if (x)
+                                    if (record_rst) {
+                                        int *offsets = av_fast_realloc(s->restart_offsets,
+                                                                       &s->restart_offsets_size,
+                                                                       (s->nb_restart_markers + 1) * sizeof(int));
+                                        if (!offsets) {
+                                            record_rst = 0;
+                                            s->nb_restart_markers = 0;
+                                        } else {
+                                            s->restart_offsets = offsets;
+                                            s->restart_offsets[s->nb_restart_markers++] = dst - s->buffer;
+                                        }
+                                    }
+                                } else if (x)
                                     break;
                             }
                         }
@@ -1379,9 +1652,9 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
     return start_code;
 }
 
-int ff_mjpeg_decode_frame(AVCodecContext *avctx,
-                              void *data, int *data_size,
-                              AVPacket *avpkt)
+static int decode_frame(AVCodecContext *avctx,
+                        void *data, int *data_size,
+                        AVPacket *avpkt)
 {
     const uint8_t *buf = avpkt->data;
     int buf_size = avpkt->size;
@@ -1507,6 +1780,7 @@ eoi_parser:
                         av_log(avctx, AV_LOG_WARNING, "Can not process SOS before SOF, skipping\n");
                         break;
                     }
+                    mjpeg_finish_setup(s, buf_ptr, buf_end);
                     ff_mjpeg_decode_sos(s, NULL, NULL);
                     /* buggy avid puts EOI every 10-20th frame */
                     /* if restart period is over process EOI */
@@ -1553,18 +1827,34 @@ the_end:
     return buf_ptr - buf;
 }
 
+int ff_mjpeg_decode_frame(AVCodecContext *avctx,
+                          void *data, int *data_size,
+                          AVPacket *avpkt)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    int ret;
+
+    s->setup_finished = 0;
+    ret = decode_frame(avctx, data, data_size, avpkt);
+    /* frames without a scan still pass their state on */
+    mjpeg_finish_setup(s, NULL, NULL);
+    return ret;
+}
+
 av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
 {
     MJpegDecodeContext *s = avctx->priv_data;
     int i, j;
 
     if (s->picture_ptr && s->picture_ptr->data[0])
-        avctx->release_buffer(avctx, s->picture_ptr);
+        ff_thread_release_buffer(avctx, s->picture_ptr);
 
     av_free(s->buffer);
     av_free(s->qscale_table);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size=0;
+    av_freep(&s->restart_offsets);
+    av_freep(&s->restart_rets);
 
     for(i=0;i<3;i++) {
         for(j=0;j<4;j++)
@@ -1585,9 +1875,11 @@ AVCodec ff_mjpeg_decoder = {
     .init           = ff_mjpeg_decode_init,
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
-    .capabilities   = CODEC_CAP_DR1,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS | CODEC_CAP_SLICE_THREADS,
     .max_lowres = 3,
     .long_name = NULL_IF_CONFIG_SMALL("MJPEG (Motion JPEG)"),
+    .init_thread_copy = ONLY_IF_THREADS_ENABLED(mjpeg_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(mjpeg_decode_update_thread_context),
 };
 
 AVCodec ff_thp_decoder = {
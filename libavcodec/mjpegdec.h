@@ -46,6 +46,10 @@ typedef struct MJpegDecodeContext {
     int16_t quant_matrixes[4][64];
     VLC vlcs[3][4];
     int qscale[4];      ///< quantizer scale calculated from quant_matrixes
+    uint8_t huff_bits[2][4][17];  ///< code lengths the DC/AC VLCs were built from
+    uint8_t huff_vals[2][4][256]; ///< symbols the DC/AC VLCs were built from
+
+    int setup_finished; ///< the next frame thread was allowed to start
 
     int org_height;  /* size given at codec init */
     int first_picture;    /* true if decoding first picture */
@@ -94,6 +98,11 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *restart_offsets;   ///< offsets in buffer right after each RST marker of the current scan
+    unsigned int restart_offsets_size;
+    int *restart_rets;      ///< return values of the restart interval jobs
+    unsigned int restart_rets_size;
+    int nb_restart_markers;
 
     int buggy_avid;
     int cs_itu601;
@@ -33,6 +33,7 @@
 //#define DEBUG
 #include <assert.h>
 
+#include "libavutil/opt.h"
 #include "avcodec.h"
 #include "dsputil.h"
 #include "mpegvideo.h"
@@ -245,6 +246,12 @@ void ff_mjpeg_encode_picture_header(MpegEncContext *s)
     put_bits(&s->pb, 8, 0); /* select matrix */
 #endif
 
+    if (s->mjpeg_restart_rows) {
+        put_marker(&s->pb, DRI);
+        put_bits(&s->pb, 16, 4);
+        put_bits(&s->pb, 16, s->mjpeg_restart_rows * s->mb_width);
+    }
+
     /* scan header */
     put_marker(&s->pb, SOS);
     put_bits(&s->pb, 16, 12); /* length */
@@ -274,6 +281,8 @@ void ff_mjpeg_encode_picture_header(MpegEncContext *s)
     }
 
     put_bits(&s->pb, 8, 0); /* Ah/Al (not used) */
+
+    s->mjpeg_ctx->esc_pos = put_bits_count(&s->pb) >> 3;
 }
 
 static void escape_FF(MpegEncContext *s, int start)
@@ -336,14 +345,32 @@ void ff_mjpeg_encode_stuffing(PutBitContext * pbc)
     if(length) put_bits(pbc, length, (1<<length)-1);
 }
 
-void ff_mjpeg_encode_picture_trailer(MpegEncContext *s)
+/**
+ * End the current restart interval at the start of macroblock row s->mb_y
+ * and begin the next one.
+ */
+void ff_mjpeg_encode_restart(MpegEncContext *s)
 {
+    int i;
+
     ff_mjpeg_encode_stuffing(&s->pb);
     flush_put_bits(&s->pb);
 
-    assert((s->header_bits&7)==0);
+    escape_FF(s, s->mjpeg_ctx->esc_pos);
+
+    put_marker(&s->pb, RST0 + ((s->mb_y / s->mjpeg_restart_rows - 1) & 7));
+    s->mjpeg_ctx->esc_pos = put_bits_count(&s->pb) >> 3;
 
-    escape_FF(s, s->header_bits>>3);
+    for(i=0; i<3; i++)
+        s->last_dc[i] = 128 << s->intra_dc_precision;
+}
+
+void ff_mjpeg_encode_picture_trailer(MpegEncContext *s)
+{
+    ff_mjpeg_encode_stuffing(&s->pb);
+    flush_put_bits(&s->pb);
+
+    escape_FF(s, s->mjpeg_ctx->esc_pos);
 
     put_marker(&s->pb, EOI);
 }
@@ -445,6 +472,18 @@ void ff_mjpeg_encode_mb(MpegEncContext *s, DCTELEM block[6][64])
     s->i_tex_bits += get_bits_diff(s);
 }
 
+static const AVClass mjpeg_class = {
+    .class_name = "mjpeg",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+    .option     = (const AVOption[]){
+        {"restart_rows", "macroblock rows between restart markers, 0 for none",
+         offsetof(MpegEncContext, mjpeg_restart_rows), FF_OPT_TYPE_INT, {.dbl = 0}, 0, 4096,
+         AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM},
+        {NULL}
+    },
+};
+
 AVCodec ff_mjpeg_encoder = {
     .name           = "mjpeg",
     .type           = AVMEDIA_TYPE_VIDEO,
@@ -455,4 +494,5 @@ AVCodec ff_mjpeg_encoder = {
     .close          = MPV_encode_end,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_YUVJ420P, PIX_FMT_YUVJ422P, PIX_FMT_NONE},
     .long_name= NULL_IF_CONFIG_SMALL("MJPEG (Motion JPEG)"),
+    .priv_class = &mjpeg_class,
 };
@@ -46,6 +46,8 @@ typedef struct MJpegContext {
     uint16_t huff_code_ac_luminance[256];
     uint8_t huff_size_ac_chrominance[256];
     uint16_t huff_code_ac_chrominance[256];
+
+    int esc_pos;    ///< byte position in pb from where 0xFF bytes are not escaped yet
 } MJpegContext;
 
 int  ff_mjpeg_encode_init(MpegEncContext *s);
@@ -53,6 +55,7 @@ void ff_mjpeg_encode_close(MpegEncContext *s);
 void ff_mjpeg_encode_picture_header(MpegEncContext *s);
 void ff_mjpeg_encode_picture_trailer(MpegEncContext *s);
 void ff_mjpeg_encode_stuffing(PutBitContext *pbc);
+void ff_mjpeg_encode_restart(MpegEncContext *s);
 void ff_mjpeg_encode_dc(MpegEncContext *s, int val,
                         uint8_t *huff_size, uint16_t *huff_code);
 void ff_mjpeg_encode_mb(MpegEncContext *s, DCTELEM block[6][64]);
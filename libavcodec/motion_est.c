@@ -305,7 +305,7 @@ int ff_init_me(MpegEncContext *s){
         return -1;
     }
     //special case of snow is needed because snow uses its own iterative ME code
-    if(s->me_method!=ME_ZERO && s->me_method!=ME_EPZS && s->me_method!=ME_X1 && s->avctx->codec_id != CODEC_ID_SNOW){
+    if(s->me_method!=ME_ZERO && s->me_method!=ME_EPZS && s->me_method!=ME_X1 && s->me_method!=ME_HIER && s->avctx->codec_id != CODEC_ID_SNOW){
         av_log(s->avctx, AV_LOG_ERROR, "me_method is only allowed to be set to zero and epzs; for hex,umh,full and others see dia_size\n");
         return -1;
     }
@@ -374,6 +374,47 @@ int ff_init_me(MpegEncContext *s){
     return 0;
 }
 
+/**
+ * Build the half and quarter resolution luma planes of pic used by ME_HIER.
+ * Each level is the 2x2 average of the one above it, padded to whole MBs.
+ * @param src luma plane of the input picture
+ */
+int ff_me_build_pyramid(MpegEncContext *s, Picture *pic, uint8_t *src, int stride)
+{
+    const int w1= s->mb_width *8, h1= s->mb_height*8;
+    const int w2= s->mb_width *4, h2= s->mb_height*4;
+    uint8_t *dst, *top;
+    int x, y;
+
+    if(!pic->hier_pyramid[0]){
+        pic->hier_pyramid[0]= av_malloc(w1*h1 + w2*h2);
+        if(!pic->hier_pyramid[0])
+            return AVERROR(ENOMEM);
+        pic->hier_pyramid[1]= pic->hier_pyramid[0] + w1*h1;
+    }
+
+    dst= pic->hier_pyramid[0];
+    for(y=0; y<h1; y++){
+        const uint8_t *src0= src + FFMIN(2*y  , s->height-1)*stride;
+        const uint8_t *src1= src + FFMIN(2*y+1, s->height-1)*stride;
+        for(x=0; x<w1; x++){
+            const int x0= FFMIN(2*x  , s->width-1);
+            const int x1= FFMIN(2*x+1, s->width-1);
+            dst[x]= (src0[x0] + src0[x1] + src1[x0] + src1[x1] + 2)>>2;
+        }
+        dst+= w1;
+    }
+
+    top= pic->hier_pyramid[0];
+    for(y=0; y<h2; y++){
+        for(x=0; x<w2; x++)
+            dst[x]= (top[2*x] + top[2*x+1] + top[2*x+w1] + top[2*x+w1+1] + 2)>>2;
+        top+= 2*w1;
+        dst+= w2;
+    }
+    return 0;
+}
+
 static inline void no_motion_search(MpegEncContext * s,
                                     int *mx_ptr, int *my_ptr)
 {
@@ -556,6 +597,81 @@ static inline void get_limits(MpegEncContext *s, int x, int y)
         c->ymin = FFMAX(c->ymin,-range);
         c->ymax = FFMIN(c->ymax, range);
     }
+    /* keep the refreshed MBs from referencing the not yet refreshed area */
+    if (x < s->intra_refresh_start*16)
+        c->xmax = FFMIN(c->xmax, s->intra_refresh_start*16 - 16 - x);
+}
+
+#define HIER_RANGE 8 ///< search range on the quarter resolution level
+
+/**
+ * Search the current MB coarse-to-fine on the pyramids of the current and
+ * reference pictures, get_limits() must have been called.
+ * An exhaustive search of the 32x32 area around the MB on the quarter
+ * resolution level is refined on the half resolution level, the resulting
+ * full-pel vector is stored in hier_mv for the EPZS search to check.
+ * @return 1 if hier_mv was set, 0 if a pyramid is missing
+ */
+static int hier_search(MpegEncContext *s, int mb_x, int mb_y, Picture *ref_pic)
+{
+    MotionEstContext * const c= &s->me;
+    const int w1= s->mb_width*8, h1= s->mb_height*8;
+    const int w2= s->mb_width*4, h2= s->mb_height*4;
+    uint8_t *cur, *ref;
+    int x, y, dx, dy, xmin, xmax, ymin, ymax;
+    int bx= 0, by= 0, cx, cy, d, dmin;
+
+    if(!ref_pic->hier_pyramid[0] || !s->current_picture.hier_pyramid[0]
+       || s->mb_width < 2 || s->mb_height < 2)
+        return 0;
+
+    /* quarter resolution, 8x8 block centered on the MB */
+    x= av_clip(mb_x*4 - 2, 0, w2 - 8);
+    y= av_clip(mb_y*4 - 2, 0, h2 - 8);
+    xmin= FFMAX(-HIER_RANGE, FFMAX(-x, -((-c->xmin)>>2)));
+    ymin= FFMAX(-HIER_RANGE, FFMAX(-y, -((-c->ymin)>>2)));
+    xmax= FFMIN( HIER_RANGE, FFMIN(w2 - 8 - x, c->xmax>>2));
+    ymax= FFMIN( HIER_RANGE, FFMIN(h2 - 8 - y, c->ymax>>2));
+    cur= s->current_picture.hier_pyramid[1] + y*w2 + x;
+    ref= ref_pic->hier_pyramid[1] + y*w2 + x;
+
+    dmin= INT_MAX;
+    for(dy=ymin; dy<=ymax; dy++){
+        for(dx=xmin; dx<=xmax; dx++){
+            d= s->dsp.sad[1](NULL, cur, ref + dy*w2 + dx, w2, 8)
+               + 2*(FFABS(dx) + FFABS(dy));
+            COPY3_IF_LT(dmin, d, bx, dx, by, dy)
+        }
+    }
+
+    /* half resolution, the 8x8 block is the MB itself */
+    x= mb_x*8;
+    y= mb_y*8;
+    xmin= FFMAX(-x, -((-c->xmin)>>1));
+    ymin= FFMAX(-y, -((-c->ymin)>>1));
+    xmax= FFMIN(w1 - 8 - x, c->xmax>>1);
+    ymax= FFMIN(h1 - 8 - y, c->ymax>>1);
+    cur= s->current_picture.hier_pyramid[0] + y*w1 + x;
+    ref= ref_pic->hier_pyramid[0] + y*w1 + x;
+
+    cx= 2*bx;
+    cy= 2*by;
+    dmin= INT_MAX;
+    for(dy=cy-1; dy<=cy+1; dy++){
+        for(dx=cx-1; dx<=cx+1; dx++){
+            if(dx<xmin || dx>xmax || dy<ymin || dy>ymax)
+                continue;
+            d= s->dsp.sad[1](NULL, cur, ref + dy*w1 + dx, w1, 8)
+               + 2*(FFABS(dx) + FFABS(dy));
+            COPY3_IF_LT(dmin, d, bx, dx, by, dy)
+        }
+    }
+    if(dmin == INT_MAX)
+        return 0;
+
+    c->hier_mv[0]= 2*bx;
+    c->hier_mv[1]= 2*by;
+    return 1;
 }
 
 static inline void init_mv4_ref(MotionEstContext *c){
@@ -1047,6 +1163,7 @@ void ff_estimate_p_frame_motion(MpegEncContext * s,
         break;
     case ME_X1:
     case ME_EPZS:
+    case ME_HIER:
        {
             const int mot_stride = s->b8_stride;
             const int mot_xy = s->block_index[0];
@@ -1063,6 +1180,7 @@ void ff_estimate_p_frame_motion(MpegEncContext * s,
                 P_TOPRIGHT[1] = s->current_picture.f.motion_val[0][mot_xy - mot_stride + 2][1];
                 if(P_TOP[1]      > (c->ymax<<shift)) P_TOP[1]     = (c->ymax<<shift);
                 if(P_TOPRIGHT[0] < (c->xmin<<shift)) P_TOPRIGHT[0]= (c->xmin<<shift);
+                if(P_TOPRIGHT[0] > (c->xmax<<shift)) P_TOPRIGHT[0]= (c->xmax<<shift);
                 if(P_TOPRIGHT[1] > (c->ymax<<shift)) P_TOPRIGHT[1]= (c->ymax<<shift);
 
                 P_MEDIAN[0]= mid_pred(P_LEFT[0], P_TOP[0], P_TOPRIGHT[0]);
@@ -1081,7 +1199,10 @@ void ff_estimate_p_frame_motion(MpegEncContext * s,
             }
 
         }
+        if(s->me_method == ME_HIER)
+            c->hier_pred= hier_search(s, mb_x, mb_y, &s->last_picture);
         dmin = ff_epzs_motion_search(s, &mx, &my, P, 0, 0, s->p_mv_table, (1<<16)>>shift, 0, 16);
+        c->hier_pred= 0;
 
         break;
     }
@@ -1290,6 +1411,7 @@ static int ff_estimate_motion_b(MpegEncContext * s,
         break;
     case ME_X1:
     case ME_EPZS:
+    case ME_HIER:
        {
             P_LEFT[0]        = mv_table[mot_xy - 1][0];
             P_LEFT[1]        = mv_table[mot_xy - 1][1];
@@ -1319,7 +1441,10 @@ static int ff_estimate_motion_b(MpegEncContext * s,
             mv_scale= ((s->pb_time - s->pp_time)<<16) / (s->pp_time<<shift);
         }
 
+        if(s->me_method == ME_HIER)
+            c->hier_pred= hier_search(s, mb_x, mb_y, ref_index ? &s->next_picture : &s->last_picture);
         dmin = ff_epzs_motion_search(s, &mx, &my, P, 0, ref_index, s->p_mv_table, mv_scale, 0, 16);
+        c->hier_pred= 0;
 
         break;
     }
@@ -936,6 +936,9 @@ static const AVClass class = {
     .option     = (const AVOption[]){
         {TIMECODE_OPT(MpegEncContext,
          AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)},
+        {FF_MPV_LOOKAHEAD_OPT(AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)},
+        {FF_MPV_PREANALYSIS_OPT(AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)},
+        {FF_MPV_RC_STATS_OFFSET_OPT(AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)},
         {NULL}
     },
 };
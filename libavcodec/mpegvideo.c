@@ -342,6 +342,8 @@ static void free_picture(MpegEncContext *s, Picture *pic){
     av_freep(&pic->mb_var);
     av_freep(&pic->mc_mb_var);
     av_freep(&pic->mb_mean);
+    av_freep(&pic->hier_pyramid[0]);
+    pic->hier_pyramid[1] = NULL;
     av_freep(&pic->f.mbskip_table);
     av_freep(&pic->qscale_table_base);
     av_freep(&pic->mb_type_base);
@@ -2279,7 +2281,10 @@ skip_idct:
     }
 }
 
+FF_TIMER_PROBE(mpv_decode_mb_probe, "MPV_decode_mb");
+
 void MPV_decode_mb(MpegEncContext *s, DCTELEM block[12][64]){
+    FF_TIMER_PROBE_START(mpv_decode_mb_probe);
 #if !CONFIG_SMALL
     if(s->out_format == FMT_MPEG1) {
         if(s->avctx->lowres) MPV_decode_mb_internal(s, block, 1, 1);
@@ -2288,6 +2293,7 @@ void MPV_decode_mb(MpegEncContext *s, DCTELEM block[12][64]){
 #endif
     if(s->avctx->lowres) MPV_decode_mb_internal(s, block, 1, 0);
     else                  MPV_decode_mb_internal(s, block, 0, 0);
+    FF_TIMER_PROBE_STOP(mpv_decode_mb_probe);
 }
 
 /**
@@ -34,6 +34,7 @@
 #include "put_bits.h"
 #include "ratecontrol.h"
 #include "parser.h"
+#include "preanalysis.h"
 #include "mpeg12data.h"
 #include "rl.h"
 #include "timecode.h"
@@ -137,6 +138,7 @@ typedef struct Picture{
     uint8_t *mb_mean;           ///< Table for MB luminance
     int32_t *mb_cmp_score;      ///< Table for MB cmp scores, for mb decision FIXME remove
     int b_frame_score;          /* */
+    uint8_t *hier_pyramid[2];   ///< half and quarter resolution luma of the input picture, for ME_HIER
     struct MpegEncContext *owner2; ///< pointer to the MpegEncContext that allocated this picture
 } Picture;
 
@@ -183,6 +185,8 @@ typedef struct MotionEstContext{
     int mc_mb_var_sum_temp;
     int mb_var_sum_temp;
     int scene_change_score;
+    int hier_pred;                     ///< set if hier_mv is to be checked by the EPZS search
+    int hier_mv[2];                    ///< full-pel mv found on the pyramid for the current MB
 /*    cmp, chroma_cmp;*/
     op_pixels_func (*hpel_put)[4];
     op_pixels_func (*hpel_avg)[4];
@@ -332,6 +336,13 @@ typedef struct MpegEncContext {
     unsigned int lambda2;       ///< (lambda*lambda) >> FF_LAMBDA_SHIFT
     int *lambda_table;
     int adaptive_quant;         ///< use adaptive quantization
+    int lookahead;              ///< number of pictures analyzed for macroblock-tree rate control, 0 if disabled
+    int preanalysis;            ///< analyze input pictures when they are loaded, for scene cuts and MB variances
+    int rc_stats_offset;        ///< index of the first picture of this encode in the pass 2 statistics
+    int intra_refresh;          ///< refresh the picture with a column of intra MBs moving across the P-frames instead of with I-frames
+    int intra_refresh_frame;    ///< index of the next P-frame in the refresh cycle
+    int intra_refresh_start;    ///< first intra MB column of the current picture, the MBs left of it are already refreshed
+    int intra_refresh_end;      ///< MB column after the last intra one of the current picture
     int dquant;                 ///< qscale difference to prev qscale
     int closed_gop;             ///< MPEG1/2 GOP is closed
     int pict_type;              ///< AV_PICTURE_TYPE_I, AV_PICTURE_TYPE_P, AV_PICTURE_TYPE_B, ...
@@ -465,6 +476,13 @@ typedef struct MpegEncContext {
     int frame_bits;                ///< bits used for the current frame
     int next_lambda;               ///< next lambda used for retrying to encode a frame
     RateControlContext rc_context; ///< contains stuff only accessed in ratecontrol.c
+    PreAnalysisContext pa;         ///< used if preanalysis is set
+
+    /* b_frame_strategy 2 */
+    AVCodecContext *brd_ctx[FF_MAX_B_FRAMES + 1]; ///< low resolution encoder for each candidate B-frame count, kept across decisions
+    uint8_t *brd_buf[FF_MAX_B_FRAMES + 1];        ///< bitstream buffer for each brd_ctx
+    AVFrame brd_frame[FF_MAX_B_FRAMES + 2];       ///< downscaled pictures, [0] is the reference
+    int brd_frame_number[FF_MAX_B_FRAMES + 2];    ///< display_picture_number of each downscaled input picture, -1 if unset
 
     /* statistics, used for 2-pass encoding */
     int mv_bits;
@@ -587,6 +605,7 @@ typedef struct MpegEncContext {
     struct MJpegContext *mjpeg_ctx;
     int mjpeg_vsample[3];       ///< vertical sampling factors, default = {2, 1, 1}
     int mjpeg_hsample[3];       ///< horizontal sampling factors, default = {2, 1, 1}
+    int mjpeg_restart_rows;     ///< macroblock rows between restart markers, 0 for none
 
     /* MSMPEG4 specific */
     int mv_table_index;
@@ -688,6 +707,23 @@ typedef struct MpegEncContext {
     void (*denoise_dct)(struct MpegEncContext *s, DCTELEM *block);
 } MpegEncContext;
 
+#define MAX_LOOKAHEAD 16
+
+#define FF_MPV_LOOKAHEAD_OPT(flags)                                          \
+    "lookahead", "number of frames analyzed for macroblock-tree rate control", \
+    offsetof(MpegEncContext, lookahead),                                      \
+    FF_OPT_TYPE_INT, {.dbl = 0}, 0, MAX_LOOKAHEAD, flags
+
+#define FF_MPV_PREANALYSIS_OPT(flags)                                        \
+    "preanalysis", "analyze input frames in a single pass for scene cuts (see sc_threshold) and MB variances", \
+    offsetof(MpegEncContext, preanalysis),                                    \
+    FF_OPT_TYPE_INT, {.dbl = 0}, 0, 1, flags
+
+#define FF_MPV_RC_STATS_OFFSET_OPT(flags)                                    \
+    "rc_stats_offset", "index of the first frame in the pass 2 statistics, for encoding a segment of the analyzed file", \
+    offsetof(MpegEncContext, rc_stats_offset),                                \
+    FF_OPT_TYPE_INT, {.dbl = 0}, 0, INT_MAX, flags
+
 #define REBASE_PICTURE(pic, new_ctx, old_ctx) (pic ? \
     (pic >= old_ctx->picture && pic < old_ctx->picture+old_ctx->picture_count ?\
         &new_ctx->picture[pic - old_ctx->picture] : pic - (Picture*)old_ctx + (Picture*)new_ctx)\
@@ -785,6 +821,7 @@ void ff_fix_long_p_mvs(MpegEncContext * s);
 void ff_fix_long_mvs(MpegEncContext * s, uint8_t *field_select_table, int field_select,
                      int16_t (*mv_table)[2], int f_code, int type, int truncate);
 int ff_init_me(MpegEncContext *s);
+int ff_me_build_pyramid(MpegEncContext *s, Picture *pic, uint8_t *src, int stride);
 int ff_pre_estimate_p_frame_motion(MpegEncContext * s, int mb_x, int mb_y);
 int ff_epzs_motion_search(MpegEncContext * s, int *mx_ptr, int *my_ptr,
                              int P[10][2], int src_index, int ref_index, int16_t (*last_mv)[2],
@@ -52,6 +52,7 @@ static int dct_quantize_refine(MpegEncContext *s, DCTELEM *block, int16_t *weigh
 static int sse_mb(MpegEncContext *s);
 static void denoise_dct_c(MpegEncContext *s, DCTELEM *block);
 static int dct_quantize_trellis_c(MpegEncContext *s, DCTELEM *block, int n, int qscale, int *overflow);
+static void free_brd_contexts(MpegEncContext *s);
 
 /* enable all paranoid tests for rounding, overflows, etc... */
 //#define PARANOID
@@ -333,6 +334,17 @@ av_cold int MPV_encode_init(AVCodecContext *avctx)
                         || (s->flags&CODEC_FLAG_QP_RD))
                        && !s->fixed_qscale;
 
+    if(s->lookahead){
+        if(s->fixed_qscale || s->intra_only){
+            av_log(avctx, AV_LOG_WARNING, "lookahead has no effect with a fixed quantizer or intra only encoding\n");
+            s->lookahead= 0;
+        }else if(2*s->max_b_frames + s->lookahead > MAX_PICTURE_COUNT - 8){
+            av_log(avctx, AV_LOG_ERROR, "lookahead %d is too large for %d b frames\n", s->lookahead, s->max_b_frames);
+            return -1;
+        }
+        s->adaptive_quant |= !!s->lookahead;
+    }
+
     s->obmc= !!(s->flags & CODEC_FLAG_OBMC);
     s->loop_filter= !!(s->flags & CODEC_FLAG_LOOP_FILTER);
     s->alternate_scan= !!(s->flags & CODEC_FLAG_ALT_SCAN);
@@ -444,6 +456,29 @@ av_cold int MPV_encode_init(AVCodecContext *avctx)
         return -1;
     }
 
+    s->intra_refresh= !!(s->flags2 & CODEC_FLAG2_INTRA_REFRESH);
+    if(s->intra_refresh){
+        if(s->codec_id != CODEC_ID_MPEG4 && s->codec_id != CODEC_ID_H263 && s->codec_id != CODEC_ID_H263P){
+            av_log(avctx, AV_LOG_ERROR, "intra refresh is only supported for MPEG-4 and H.263\n");
+            return -1;
+        }
+        if(s->max_b_frames){
+            av_log(avctx, AV_LOG_ERROR, "b frames cannot be used with intra refresh\n");
+            return -1;
+        }
+        /* both filter across the refresh column boundary */
+        if(s->flags & (CODEC_FLAG_OBMC | CODEC_FLAG_LOOP_FILTER)){
+            av_log(avctx, AV_LOG_ERROR, "obmc and loop filter cannot be used with intra refresh\n");
+            return -1;
+        }
+        /* the qpel filter reads 3 pixels beyond the block, the MVs cannot be
+         * limited to the refreshed area without excluding the zero vector */
+        if(s->flags & CODEC_FLAG_QPEL){
+            av_log(avctx, AV_LOG_ERROR, "qpel cannot be used with intra refresh\n");
+            return -1;
+        }
+    }
+
     if((s->flags2 & CODEC_FLAG2_INTRA_VLC) && s->codec_id != CODEC_ID_MPEG2VIDEO){
         av_log(avctx, AV_LOG_ERROR, "intra vlc table not supported by codec\n");
         return -1;
@@ -745,6 +780,10 @@ av_cold int MPV_encode_init(AVCodecContext *avctx)
                        s->inter_matrix, s->inter_quant_bias, avctx->qmin, 31, 0);
     }
 
+    if(s->preanalysis &&
+       ff_preanalysis_init(&s->pa, avctx, &s->dsp, s->mb_width, s->mb_height, s->mb_stride) < 0)
+        return -1;
+
     if(ff_rate_control_init(s) < 0)
         return -1;
 
@@ -756,6 +795,8 @@ av_cold int MPV_encode_end(AVCodecContext *avctx)
     MpegEncContext *s = avctx->priv_data;
 
     ff_rate_control_uninit(s);
+    free_brd_contexts(s);
+    ff_preanalysis_end(&s->pa);
 
     MPV_common_end(s);
     if ((CONFIG_MJPEG_ENCODER || CONFIG_LJPEG_ENCODER) && s->out_format == FMT_MJPEG)
@@ -804,7 +845,7 @@ static int load_input_picture(MpegEncContext *s, AVFrame *pic_arg){
     AVFrame *pic=NULL;
     int64_t pts;
     int i;
-    const int encoding_delay= s->max_b_frames;
+    const int encoding_delay= s->max_b_frames + s->lookahead;
     int direct=1;
 
     if(pic_arg){
@@ -899,6 +940,18 @@ static int load_input_picture(MpegEncContext *s, AVFrame *pic_arg){
     }
     copy_picture_attributes(s, pic, pic_arg);
     pic->pts= pts; //we set this here to avoid modifiying pic_arg
+
+    if(s->preanalysis){
+        Picture *p= (Picture*)pic;
+        int offset= direct || s->avctx->rc_buffer_size ? 0 : INPLACE_OFFSET;
+
+        ff_preanalysis_frame(&s->pa, pic->data[0] + offset, s->linesize, p->mb_var, p->mb_mean);
+        p->mb_var_sum= s->pa.mb_var_sum;
+        if(!pic->pict_type && !s->intra_refresh && ff_preanalysis_scene_cut(&s->pa)){
+            av_log(s->avctx, AV_LOG_DEBUG, "scene cut at frame %d\n", pic->display_picture_number);
+            pic->pict_type= AV_PICTURE_TYPE_I;
+        }
+    }
   }
 
     /* shift buffer entries */
@@ -943,113 +996,332 @@ static int skip_check(MpegEncContext *s, Picture *p, Picture *ref){
     return 0;
 }
 
-static int estimate_best_b_count(MpegEncContext *s){
-    AVCodec *codec= avcodec_find_encoder(s->avctx->codec_id);
-    AVCodecContext *c = avcodec_alloc_context3(NULL);
-    AVFrame input[FF_MAX_B_FRAMES+2];
-    const int scale= s->avctx->brd_scale;
-    int i, j, out_size, p_lambda, b_lambda, lambda2;
-    int outbuf_size= s->width * s->height; //FIXME
-    uint8_t *outbuf= av_malloc(outbuf_size);
-    int64_t best_rd= INT64_MAX;
-    int best_b_count= -1;
+typedef struct BCountContext {
+    MpegEncContext *s;
+    AVFrame *input[FF_MAX_B_FRAMES + 2]; ///< downscaled reference followed by the input pictures
+    int nb_input;                        ///< number of input pictures after the reference
+    int p_lambda, b_lambda, lambda2;
+    int64_t rd[FF_MAX_B_FRAMES + 1];     ///< rate-distortion cost of each B-frame count
+} BCountContext;
 
-    assert(scale>=0 && scale <=3);
+static av_cold void free_brd_contexts(MpegEncContext *s)
+{
+    int i;
 
-//    emms_c();
-    p_lambda= s->last_lambda_for[AV_PICTURE_TYPE_P]; //s->next_picture_ptr->quality;
-    b_lambda= s->last_lambda_for[AV_PICTURE_TYPE_B]; //p_lambda *FFABS(s->avctx->b_quant_factor) + s->avctx->b_quant_offset;
-    if(!b_lambda) b_lambda= p_lambda; //FIXME we should do this somewhere else
-    lambda2= (b_lambda*b_lambda + (1<<FF_LAMBDA_SHIFT)/2 ) >> FF_LAMBDA_SHIFT;
-
-    c->width = s->width >> scale;
-    c->height= s->height>> scale;
-    c->flags= CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR | CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
-    c->flags|= s->avctx->flags & CODEC_FLAG_QPEL;
-    c->mb_decision= s->avctx->mb_decision;
-    c->me_cmp= s->avctx->me_cmp;
-    c->mb_cmp= s->avctx->mb_cmp;
-    c->me_sub_cmp= s->avctx->me_sub_cmp;
-    c->pix_fmt = PIX_FMT_YUV420P;
-    c->time_base= s->avctx->time_base;
-    c->max_b_frames= s->max_b_frames;
-
-    if (avcodec_open2(c, codec, NULL) < 0)
-        return -1;
+    for (i = 0; i < FF_ARRAY_ELEMS(s->brd_ctx); i++) {
+        if (s->brd_ctx[i]) {
+            ff_codec_close_nested(s->brd_ctx[i]);
+            av_freep(&s->brd_ctx[i]);
+        }
+        av_freep(&s->brd_buf[i]);
+    }
+    for (i = 0; i < FF_ARRAY_ELEMS(s->brd_frame); i++)
+        av_freep(&s->brd_frame[i].data[0]);
+}
 
-    for(i=0; i<s->max_b_frames+2; i++){
-        int ysize= c->width*c->height;
-        int csize= (c->width/2)*(c->height/2);
-        Picture pre_input, *pre_input_ptr= i ? s->input_picture[i-1] : s->next_picture_ptr;
+/**
+ * Open the low resolution encoders used by b_frame_strategy 2, one per
+ * candidate B-frame count, so that the candidates can be tried in parallel
+ * and the encoders need not be reopened for every decision.
+ */
+static av_cold int init_brd_contexts(MpegEncContext *s)
+{
+    AVCodec *codec = avcodec_find_encoder(s->avctx->codec_id);
+    const int scale = s->avctx->brd_scale;
+    const int width  = s->width  >> scale;
+    const int height = s->height >> scale;
+    const int ysize = width * height;
+    const int csize = (width / 2) * (height / 2);
+    int i;
 
-        avcodec_get_frame_defaults(&input[i]);
-        input[i].data[0]= av_malloc(ysize + 2*csize);
-        input[i].data[1]= input[i].data[0] + ysize;
-        input[i].data[2]= input[i].data[1] + csize;
-        input[i].linesize[0]= c->width;
-        input[i].linesize[1]=
-        input[i].linesize[2]= c->width/2;
+    for (i = 0; i < s->max_b_frames + 1; i++) {
+        AVCodecContext *c = avcodec_alloc_context3(NULL);
+        if (!c)
+            return AVERROR(ENOMEM);
+        s->brd_ctx[i] = c;
+
+        c->width = width;
+        c->height= height;
+        c->flags= CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR | CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
+        c->flags|= s->avctx->flags & CODEC_FLAG_QPEL;
+        c->mb_decision= s->avctx->mb_decision;
+        c->me_cmp= s->avctx->me_cmp;
+        c->mb_cmp= s->avctx->mb_cmp;
+        c->me_sub_cmp= s->avctx->me_sub_cmp;
+        c->pix_fmt = PIX_FMT_YUV420P;
+        c->time_base= s->avctx->time_base;
+        c->max_b_frames= s->max_b_frames;
+
+        if (avcodec_open2(c, codec, NULL) < 0)
+            return -1;
 
-        if(pre_input_ptr && (!i || s->input_picture[i-1])) {
-            pre_input= *pre_input_ptr;
+        s->brd_buf[i] = av_malloc(s->width * s->height); //FIXME
+        if (!s->brd_buf[i])
+            return AVERROR(ENOMEM);
+    }
 
-            if (pre_input.f.type != FF_BUFFER_TYPE_SHARED && i) {
-                pre_input.f.data[0] += INPLACE_OFFSET;
-                pre_input.f.data[1] += INPLACE_OFFSET;
-                pre_input.f.data[2] += INPLACE_OFFSET;
-            }
+    for (i = 0; i < s->max_b_frames + 2; i++) {
+        AVFrame *f = &s->brd_frame[i];
+
+        avcodec_get_frame_defaults(f);
+        f->data[0] = av_mallocz(ysize + 2 * csize);
+        if (!f->data[0])
+            return AVERROR(ENOMEM);
+        f->data[1] = f->data[0] + ysize;
+        f->data[2] = f->data[1] + csize;
+        f->linesize[0] = width;
+        f->linesize[1] =
+        f->linesize[2] = width / 2;
+        s->brd_frame_number[i] = -1;
+    }
 
-            s->dsp.shrink[scale](input[i].data[0], input[i].linesize[0], pre_input.f.data[0], pre_input.f.linesize[0], c->width,      c->height);
-            s->dsp.shrink[scale](input[i].data[1], input[i].linesize[1], pre_input.f.data[1], pre_input.f.linesize[1], c->width >> 1, c->height >> 1);
-            s->dsp.shrink[scale](input[i].data[2], input[i].linesize[2], pre_input.f.data[2], pre_input.f.linesize[2], c->width >> 1, c->height >> 1);
-        }
+    return 0;
+}
+
+static void shrink_picture(MpegEncContext *s, AVFrame *dst, const AVFrame *src, int offset)
+{
+    const int scale = s->avctx->brd_scale;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        s->dsp.shrink[scale](dst->data[i], dst->linesize[i],
+                             src->data[i] + offset, src->linesize[i],
+                             (s->width >> scale) >> !!i, (s->height >> scale) >> !!i);
+}
+
+/**
+ * Encode the downscaled pictures with a B-frame run length of jobnr and
+ * store the rate-distortion cost in rd[jobnr].
+ */
+static int estimate_b_count_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    BCountContext *bc = arg;
+    MpegEncContext *s = bc->s;
+    AVCodecContext *c = s->brd_ctx[jobnr];
+    uint8_t *outbuf = s->brd_buf[jobnr];
+    int outbuf_size = s->width * s->height;
+    AVFrame input[FF_MAX_B_FRAMES + 2];
+    int64_t rd = 0;
+    int i, out_size;
+
+    for (i = 0; i < bc->nb_input + 1; i++)
+        input[i] = *bc->input[i];
+
+    c->error[0]= c->error[1]= c->error[2]= 0;
+
+    input[0].pict_type= AV_PICTURE_TYPE_I;
+    input[0].quality= 1 * FF_QP2LAMBDA;
+    out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[0]);
+//    rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
+
+    for (i = 0; i < bc->nb_input; i++) {
+        int is_p= i % (jobnr+1) == jobnr || i == bc->nb_input - 1;
+
+        input[i+1].pict_type= is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
+        input[i+1].quality= is_p ? bc->p_lambda : bc->b_lambda;
+        out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[i+1]);
+        rd += (out_size * bc->lambda2) >> (FF_LAMBDA_SHIFT - 3);
     }
 
-    for(j=0; j<s->max_b_frames+1; j++){
-        int64_t rd=0;
+    /* get the delayed frames */
+    while(out_size){
+        out_size = avcodec_encode_video(c, outbuf, outbuf_size, NULL);
+        rd += (out_size * bc->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
 
-        if(!s->input_picture[j])
-            break;
+    rd += c->error[0] + c->error[1] + c->error[2];
 
-        c->error[0]= c->error[1]= c->error[2]= 0;
+    bc->rd[jobnr] = rd;
+    return 0;
+}
 
-        input[0].pict_type= AV_PICTURE_TYPE_I;
-        input[0].quality= 1 * FF_QP2LAMBDA;
-        out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[0]);
-//        rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
+static int estimate_best_b_count(MpegEncContext *s){
+    BCountContext bc = { s };
+    int used[FF_MAX_B_FRAMES + 2] = { 0 };
+    int i, j, ret;
+    int64_t best_rd= INT64_MAX;
+    int best_b_count= -1;
 
-        for(i=0; i<s->max_b_frames+1; i++){
-            int is_p= i % (j+1) == j || i==s->max_b_frames;
+    assert(s->avctx->brd_scale>=0 && s->avctx->brd_scale <=3);
 
-            input[i+1].pict_type= is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
-            input[i+1].quality= is_p ? p_lambda : b_lambda;
-            out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[i+1]);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
+    if (!s->brd_ctx[0] && (ret = init_brd_contexts(s)) < 0) {
+        free_brd_contexts(s);
+        return ret;
+    }
 
-        /* get the delayed frames */
-        while(out_size){
-            out_size = avcodec_encode_video(c, outbuf, outbuf_size, NULL);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
+//    emms_c();
+    bc.p_lambda= s->last_lambda_for[AV_PICTURE_TYPE_P]; //s->next_picture_ptr->quality;
+    bc.b_lambda= s->last_lambda_for[AV_PICTURE_TYPE_B]; //p_lambda *FFABS(s->avctx->b_quant_factor) + s->avctx->b_quant_offset;
+    if(!bc.b_lambda) bc.b_lambda= bc.p_lambda; //FIXME we should do this somewhere else
+    bc.lambda2= (bc.b_lambda*bc.b_lambda + (1<<FF_LAMBDA_SHIFT)/2 ) >> FF_LAMBDA_SHIFT;
+
+    /* The reference is the reconstructed previous non-B picture, the input
+     * pictures are downscaled once and reused by the following decisions. */
+    bc.input[0] = &s->brd_frame[0];
+    if (s->next_picture_ptr)
+        shrink_picture(s, bc.input[0], &s->next_picture_ptr->f, 0);
+
+    for (i = 0; i < s->max_b_frames + 1 && s->input_picture[i]; i++) {
+        bc.input[i + 1] = NULL;
+        for (j = 1; j < s->max_b_frames + 2; j++) {
+            if (s->brd_frame_number[j] == s->input_picture[i]->f.display_picture_number) {
+                bc.input[i + 1] = &s->brd_frame[j];
+                used[j] = 1;
+                break;
+            }
         }
+    }
+    bc.nb_input = i;
+
+    for (i = 0; i < bc.nb_input; i++) {
+        Picture *pic = s->input_picture[i];
 
-        rd += c->error[0] + c->error[1] + c->error[2];
+        if (bc.input[i + 1])
+            continue;
+        for (j = 1; used[j]; j++);
+        used[j] = 1;
 
-        if(rd < best_rd){
-            best_rd= rd;
+        shrink_picture(s, &s->brd_frame[j], &pic->f,
+                       pic->f.type != FF_BUFFER_TYPE_SHARED ? INPLACE_OFFSET : 0);
+        s->brd_frame_number[j] = pic->f.display_picture_number;
+        bc.input[i + 1] = &s->brd_frame[j];
+    }
+    emms_c();
+
+    s->avctx->execute2(s->avctx, estimate_b_count_thread, &bc, NULL, bc.nb_input);
+
+    for (j = 0; j < bc.nb_input; j++) {
+        if(bc.rd[j] < best_rd){
+            best_rd= bc.rd[j];
             best_b_count= j;
         }
     }
 
-    av_freep(&outbuf);
-    avcodec_close(c);
-    av_freep(&c);
+    return best_b_count;
+}
 
-    for(i=0; i<s->max_b_frames+2; i++){
-        av_freep(&input[i].data[0]);
+/**
+ * Find the intra cost of each MB of an input picture and, if ref is set,
+ * the cost and motion vector of each MB predicted from ref, using the
+ * motion estimation pre-pass on the source pictures.
+ * Only whole MBs are analyzed.
+ */
+static void lookahead_analyze(MpegEncContext *s, RateControlLookahead *la, Picture *pic, Picture *ref)
+{
+    const int mb_width = s->width  >> 4;
+    const int mb_height= s->height >> 4;
+    const int shift= 1 + s->quarter_sample;
+    const int stride= s->linesize;
+    uint8_t *src= pic->f.data[0] + (pic->f.type != FF_BUFFER_TYPE_SHARED ? INPLACE_OFFSET : 0);
+    int mb_x, mb_y, i;
+
+    la->picture_number= pic->f.display_picture_number;
+    la->has_inter= 0;
+
+    /* one per pixel is added to every cost so that flat MBs have no zero cost */
+    for(mb_y=0; mb_y<mb_height; mb_y++){
+        for(mb_x=0; mb_x<mb_width; mb_x++){
+            uint8_t *p= src + 16*mb_x + 16*mb_y*stride;
+            int mean= (s->dsp.pix_sum(p, stride) + 128)>>8;
+
+            la->intra_cost[mb_x + mb_y*s->mb_stride]= get_sae(p, mean, stride) + 256;
+        }
     }
 
-    return best_b_count;
+    if(ref && ff_init_me(s) >= 0){
+        uint8_t *new_data[4], *last_data[4];
+        int16_t (*p_mv_table)[2]= s->p_mv_table;
+        const int unrestricted_mv= s->unrestricted_mv;
+        const int s_mb_width = s->mb_width;
+        const int s_mb_height= s->mb_height;
+        uint8_t *ref_src;
+
+        memcpy(new_data,  s->new_picture.f.data,  sizeof(new_data));
+        memcpy(last_data, s->last_picture.f.data, sizeof(last_data));
+        for(i=0; i<3; i++){
+            s->new_picture.f.data[i] = pic->f.data[i] + (pic->f.type != FF_BUFFER_TYPE_SHARED ? INPLACE_OFFSET : 0);
+            s->last_picture.f.data[i]= ref->f.data[i] + (ref->f.type != FF_BUFFER_TYPE_SHARED ? INPLACE_OFFSET : 0);
+        }
+        ref_src= s->last_picture.f.data[0];
+
+        /* the source pictures have no edges, keep the vectors inside the whole MBs */
+        s->p_mv_table= la->mv;
+        s->unrestricted_mv= 0;
+        s->mb_width = mb_width;
+        s->mb_height= mb_height;
+
+        s->me.pre_pass=1;
+        s->me.dia_size= s->avctx->pre_dia_size;
+        s->first_slice_line=1;
+        for(mb_y=mb_height-1; mb_y >= 0; mb_y--) {
+            for(mb_x=mb_width-1; mb_x >= 0; mb_x--) {
+                const int mb_xy= mb_x + mb_y*s->mb_stride;
+                int mx, my;
+
+                ff_pre_estimate_p_frame_motion(s, mb_x, mb_y);
+                mx= la->mv[mb_xy][0] >> shift;
+                my= la->mv[mb_xy][1] >> shift;
+                la->inter_cost[mb_xy]= 256 +
+                    s->dsp.sad[0](NULL, src + 16*mb_x + 16*mb_y*stride,
+                                  ref_src + 16*mb_x + mx + (16*mb_y + my)*stride, stride, 16);
+            }
+            s->first_slice_line=0;
+        }
+        s->me.pre_pass=0;
+
+        s->mb_width = s_mb_width;
+        s->mb_height= s_mb_height;
+        s->unrestricted_mv= unrestricted_mv;
+        s->p_mv_table= p_mv_table;
+        memcpy(s->new_picture.f.data,  new_data,  sizeof(new_data));
+        memcpy(s->last_picture.f.data, last_data, sizeof(last_data));
+        la->has_inter= 1;
+    }
+}
+
+/**
+ * Set up the macroblock-tree qscales of the reference picture
+ * input_picture[index] from the pictures following it.
+ */
+static void lookahead_mbtree(MpegEncContext *s, int index)
+{
+    RateControlContext *rcc= &s->rc_context;
+    RateControlLookahead *la[MAX_LOOKAHEAD + 1];
+    int end= index + s->lookahead + 1;
+    int i, n;
+
+    /* the pictures of the next GOP do not reference this one */
+    if(s->input_picture[index]->f.pict_type == AV_PICTURE_TYPE_I)
+        end= FFMIN(end, index + s->gop_size);
+    else
+        end= FFMIN(end, s->gop_size - s->picture_in_gop_number);
+
+    for(n=0; index + n < end && s->input_picture[index + n] && s->input_picture[index + n]->f.data[0]; n++){
+        Picture *pic= s->input_picture[index + n];
+        Picture *ref= n ? s->input_picture[index + n - 1] : NULL;
+        RateControlLookahead *oldest= NULL;
+
+        if(n && pic->f.pict_type == AV_PICTURE_TYPE_I)
+            break;
+
+        la[n]= NULL;
+        for(i=0; i<rcc->nb_lookahead; i++){
+            RateControlLookahead *cur= &rcc->lookahead[i];
+            if(cur->picture_number == pic->f.display_picture_number)
+                la[n]= cur;
+            if(!oldest || cur->picture_number < oldest->picture_number)
+                oldest= cur;
+        }
+        if(!la[n] || (ref && !la[n]->has_inter)){
+            if(!la[n])
+                la[n]= oldest;
+            lookahead_analyze(s, la[n], pic, ref);
+        }
+    }
+    emms_c();
+
+    if(n)
+        ff_rate_control_mbtree(s, la, n);
 }
 
 static int select_input_picture(MpegEncContext *s){
@@ -1065,6 +1337,8 @@ static int select_input_picture(MpegEncContext *s){
             s->reordered_input_picture[0]= s->input_picture[0];
             s->reordered_input_picture[0]->f.pict_type = AV_PICTURE_TYPE_I;
             s->reordered_input_picture[0]->f.coded_picture_number = s->coded_picture_number++;
+            if(s->lookahead)
+                lookahead_mbtree(s, 0);
         }else{
             int b_frames;
 
@@ -1130,6 +1404,8 @@ static int select_input_picture(MpegEncContext *s){
                 }
             }else if(s->avctx->b_frame_strategy==2){
                 b_frames= estimate_best_b_count(s);
+                if(b_frames < 0)
+                    b_frames= 0;
             }else{
                 av_log(s->avctx, AV_LOG_ERROR, "illegal b frame strategy\n");
                 b_frames=0;
@@ -1149,7 +1425,7 @@ static int select_input_picture(MpegEncContext *s){
                 av_log(s->avctx, AV_LOG_ERROR, "warning, too many b frames in a row\n");
             }
 
-            if(s->picture_in_gop_number + b_frames >= s->gop_size){
+            if(s->picture_in_gop_number + b_frames >= s->gop_size && !s->intra_refresh){
               if((s->flags2 & CODEC_FLAG2_STRICT_GOP) && s->gop_size > s->picture_in_gop_number){
                     b_frames= s->gop_size - s->picture_in_gop_number - 1;
               }else{
@@ -1173,6 +1449,8 @@ static int select_input_picture(MpegEncContext *s){
                 s->reordered_input_picture[i + 1]->f.pict_type = AV_PICTURE_TYPE_B;
                 s->reordered_input_picture[i + 1]->f.coded_picture_number = s->coded_picture_number++;
             }
+            if(s->lookahead)
+                lookahead_mbtree(s, b_frames);
         }
     }
 no_output_pic:
@@ -1229,6 +1507,7 @@ int MPV_encode_picture(AVCodecContext *avctx,
     MpegEncContext *s = avctx->priv_data;
     AVFrame *pic_arg = data;
     int i, stuffing_count, context_count = avctx->thread_count;
+    uint8_t *sent_end;
 
     for(i=0; i<context_count; i++){
         int start_y= s->thread_context[i]->start_mb_y;
@@ -1255,9 +1534,12 @@ int MPV_encode_picture(AVCodecContext *avctx,
 //emms_c();
 //printf("qs:%f %f %d\n", s->new_picture.quality, s->current_picture.quality, s->qscale);
         MPV_frame_start(s, avctx);
+        /* the rtp_callback is called before MPV_frame_end() */
+        avctx->coded_frame= (AVFrame*)s->current_picture_ptr;
 vbv_retry:
         if (encode_picture(s, s->picture_number) < 0)
             return -1;
+        sent_end= put_bits_ptr(&s->pb);
 
         avctx->header_bits = s->header_bits;
         avctx->mv_bits     = s->mv_bits;
@@ -1277,7 +1559,8 @@ vbv_retry:
             RateControlContext *rcc= &s->rc_context;
             int max_size= rcc->buffer_index * avctx->rc_max_available_vbv_use;
 
-            if(put_bits_count(&s->pb) > max_size && s->lambda < s->avctx->lmax){
+            /* the slices cannot be reencoded once they were passed to the rtp_callback */
+            if(put_bits_count(&s->pb) > max_size && s->lambda < s->avctx->lmax && !avctx->rtp_callback){
                 s->next_lambda= FFMAX(s->lambda+1, s->lambda*(s->qscale+1) / s->qscale);
                 if(s->adaptive_quant){
                     int i;
@@ -1346,8 +1629,13 @@ vbv_retry:
             s->frame_bits  = put_bits_count(&s->pb);
         }
 
-        /* update mpeg1/2 vbv_delay for CBR */
-        if(s->avctx->rc_max_rate && s->avctx->rc_min_rate == s->avctx->rc_max_rate && s->out_format == FMT_MPEG1
+        /* send the stuffing and trailers written after the last slice */
+        if(avctx->rtp_callback && put_bits_ptr(&s->pb) > sent_end)
+            avctx->rtp_callback(avctx, sent_end, put_bits_ptr(&s->pb) - sent_end, 0);
+
+        /* update mpeg1/2 vbv_delay for CBR, not possible if the picture
+         * header was already passed to the rtp_callback */
+        if(s->avctx->rc_max_rate && s->avctx->rc_min_rate == s->avctx->rc_max_rate && s->out_format == FMT_MPEG1 && !avctx->rtp_callback
            && 90000LL * (avctx->rc_buffer_size-1) <= s->avctx->rc_max_rate*0xFFFFLL){
             int vbv_delay, min_delay;
             double inbits = s->avctx->rc_max_rate*av_q2d(s->avctx->time_base);
@@ -2132,6 +2420,11 @@ static int encode_thread(AVCodecContext *c, void *arg){
                 mb_type= s->mb_type[xy];
             }
 
+            if (CONFIG_MJPEG_ENCODER && s->codec_id == CODEC_ID_MJPEG &&
+                s->mjpeg_restart_rows && mb_x == 0 && mb_y > 0 &&
+                mb_y % s->mjpeg_restart_rows == 0)
+                ff_mjpeg_encode_restart(s);
+
             /* write gob / video packet header  */
             if(s->rtp_mode){
                 int current_packet_size, is_gob_start;
@@ -2177,7 +2470,7 @@ static int encode_thread(AVCodecContext *c, void *arg){
                         }
                     }
 
-                    if (s->avctx->rtp_callback){
+                    if (s->avctx->rtp_callback && !s->start_mb_y){
                         int number_mb = (mb_y - s->resync_mb_y)*s->mb_width + mb_x - s->resync_mb_x;
                         s->avctx->rtp_callback(s->avctx, s->ptr_lastgob, current_packet_size, number_mb);
                     }
@@ -2652,8 +2945,9 @@ static int encode_thread(AVCodecContext *c, void *arg){
 
     write_slice_end(s);
 
-    /* Send the last GOB if RTP */
-    if (s->avctx->rtp_callback) {
+    /* Send the last GOB if RTP, the other threads are sent by
+     * encode_picture() once their bitstreams are merged in order */
+    if (s->avctx->rtp_callback && !s->start_mb_y) {
         int number_mb = (mb_y - s->resync_mb_y)*s->mb_width - s->resync_mb_x;
         pdif = put_bits_ptr(&s->pb) - s->ptr_lastgob;
         /* Call the RTP callback to send the last GOB */
@@ -2755,6 +3049,30 @@ static void set_frame_distances(MpegEncContext * s){
     }
 }
 
+/**
+ * Select the column of MBs which is coded intra in the current picture.
+ * The column sweeps the picture from left to right in gop_size P-frames,
+ * the motion vectors of the MBs left of it are limited to the area which
+ * is already refreshed in the reference picture by get_limits().
+ * The columns refreshed before a decoder joins the stream are not clean
+ * for it, so it only has a clean picture after the first complete cycle
+ * following the join point, up to 2 * gop_size - 1 pictures later.
+ */
+static void update_intra_refresh(MpegEncContext *s)
+{
+    if(s->pict_type == AV_PICTURE_TYPE_I){
+        s->intra_refresh_frame= 0;
+        s->intra_refresh_start=
+        s->intra_refresh_end  = 0;
+    }else{
+        int i= s->intra_refresh_frame;
+
+        s->intra_refresh_start= i      * s->mb_width / s->gop_size;
+        s->intra_refresh_end  = (i + 1) * s->mb_width / s->gop_size;
+        s->intra_refresh_frame= (i + 1) % s->gop_size;
+    }
+}
+
 static int encode_picture(MpegEncContext *s, int picture_number)
 {
     int i;
@@ -2798,6 +3116,17 @@ static int encode_picture(MpegEncContext *s, int picture_number)
         update_qscale(s);
     }
 
+    if(s->me_method == ME_HIER){
+        /* built for I-frames too, as they are referenced by the next P-frame */
+        if(ff_me_build_pyramid(s, s->current_picture_ptr, s->new_picture.f.data[0], s->new_picture.f.linesize[0]) < 0)
+            return -1;
+        memcpy(s->current_picture.hier_pyramid, s->current_picture_ptr->hier_pyramid,
+               sizeof(s->current_picture.hier_pyramid));
+    }
+
+    if(s->intra_refresh)
+        update_intra_refresh(s);
+
     s->mb_intra=0; //for the rate distortion & bit compare functions
     for(i=1; i<context_count; i++){
         ff_update_duplicate_context(s->thread_context[i], s);
@@ -2824,7 +3153,15 @@ static int encode_picture(MpegEncContext *s, int picture_number)
 
         if(!s->fixed_qscale){
             /* finding spatial complexity for I-frame rate control */
-            s->avctx->execute(s->avctx, mb_var_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+            if(s->preanalysis){
+                /* already done by ff_preanalysis_frame() when the picture was loaded */
+                if(s->current_picture.mb_var != s->new_picture.mb_var){
+                    memcpy(s->current_picture.mb_var , s->new_picture.mb_var , s->mb_stride*s->mb_height*sizeof(uint16_t));
+                    memcpy(s->current_picture.mb_mean, s->new_picture.mb_mean, s->mb_stride*s->mb_height*sizeof(uint8_t));
+                }
+                s->me.mb_var_sum_temp= s->new_picture.mb_var_sum;
+            }else
+                s->avctx->execute(s->avctx, mb_var_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
         }
     }
     for(i=1; i<context_count; i++){
@@ -2834,7 +3171,13 @@ static int encode_picture(MpegEncContext *s, int picture_number)
     s->current_picture.   mb_var_sum= s->current_picture_ptr->   mb_var_sum= s->me.   mb_var_sum_temp;
     emms_c();
 
-    if(s->me.scene_change_score > s->avctx->scenechange_threshold && s->pict_type == AV_PICTURE_TYPE_P){
+    for(i=s->intra_refresh_start; i<s->intra_refresh_end; i++){
+        int mb_y;
+        for(mb_y=0; mb_y<s->mb_height; mb_y++)
+            s->mb_type[mb_y*s->mb_stride + i]= CANDIDATE_MB_TYPE_INTRA;
+    }
+
+    if(s->me.scene_change_score > s->avctx->scenechange_threshold && s->pict_type == AV_PICTURE_TYPE_P && !s->intra_refresh){
         s->pict_type= AV_PICTURE_TYPE_I;
         for(i=0; i<s->mb_stride*s->mb_height; i++)
             s->mb_type[i]= CANDIDATE_MB_TYPE_INTRA;
@@ -2968,7 +3311,13 @@ static int encode_picture(MpegEncContext *s, int picture_number)
     }
     s->avctx->execute(s->avctx, encode_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
     for(i=1; i<context_count; i++){
-        merge_context_after_encode(s, s->thread_context[i]);
+        MpegEncContext *t= s->thread_context[i];
+        uint8_t *start= put_bits_ptr(&s->pb);
+
+        merge_context_after_encode(s, t);
+        if(s->avctx->rtp_callback)
+            s->avctx->rtp_callback(s->avctx, start, put_bits_ptr(&s->pb) - start,
+                                   (t->end_mb_y - t->start_mb_y)*s->mb_width);
     }
     emms_c();
     return 0;
@@ -26,6 +26,7 @@
 #include <zlib.h>
 
 #include "avcodec.h"
+#include "pngdsp.h"
 
 #define PNG_COLOR_MASK_PALETTE    1
 #define PNG_COLOR_MASK_COLOR      2
@@ -70,14 +71,15 @@ int ff_png_get_nb_channels(int color_type);
 /* compute the row size of an interleaved pass */
 int ff_png_pass_row_size(int pass, int bits_per_pixel, int width);
 
-void ff_add_png_paeth_prediction(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp);
-
 typedef struct PNGDecContext {
+    PNGDSPContext dsp;
+
     const uint8_t *bytestream;
     const uint8_t *bytestream_start;
     const uint8_t *bytestream_end;
     AVFrame picture1, picture2;
     AVFrame *current_picture, *last_picture;
+    AVFrame prev_picture; ///< picture of the previous frame thread, P-frames are added to it
 
     int state;
     int width, height;
@@ -102,11 +104,6 @@ typedef struct PNGDecContext {
     int pass_row_size; /* decompress row size of the current pass */
     int y;
     z_stream zstream;
-
-    void (*add_bytes_l2)(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w);
-    void (*add_paeth_prediction)(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp);
 } PNGDecContext;
 
-void ff_png_init_mmx(PNGDecContext *s);
-
 #endif /* AVCODEC_PNG_H */
@@ -25,6 +25,7 @@
 #include "avcodec.h"
 #include "bytestream.h"
 #include "png.h"
+#include "thread.h"
 
 /* TODO:
  * - add 2, 4 and 16 bit depth support
@@ -100,49 +101,6 @@ static void png_put_interlaced_row(uint8_t *dst, int width,
     }
 }
 
-// 0x7f7f7f7f or 0x7f7f7f7f7f7f7f7f or whatever, depending on the cpu's native arithmetic size
-#define pb_7f (~0UL/255 * 0x7f)
-#define pb_80 (~0UL/255 * 0x80)
-
-static void add_bytes_l2_c(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w)
-{
-    long i;
-    for(i=0; i<=w-sizeof(long); i+=sizeof(long)){
-        long a = *(long*)(src1+i);
-        long b = *(long*)(src2+i);
-        *(long*)(dst+i) = ((a&pb_7f) + (b&pb_7f)) ^ ((a^b)&pb_80);
-    }
-    for(; i<w; i++)
-        dst[i] = src1[i]+src2[i];
-}
-
-static void add_paeth_prediction_c(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp)
-{
-    int i;
-    for(i = 0; i < w; i++) {
-        int a, b, c, p, pa, pb, pc;
-
-        a = dst[i - bpp];
-        b = top[i];
-        c = top[i - bpp];
-
-        p = b - c;
-        pc = a - c;
-
-        pa = abs(p);
-        pb = abs(pc);
-        pc = abs(p + pc);
-
-        if (pa <= pb && pa <= pc)
-            p = a;
-        else if (pb <= pc)
-            p = b;
-        else
-            p = c;
-        dst[i] = p + src[i];
-    }
-}
-
 #define UNROLL1(bpp, op) {\
                  r = dst[0];\
     if(bpp >= 2) g = dst[1];\
@@ -199,7 +157,7 @@ static void png_filter_row(PNGDecContext *s, uint8_t *dst, int filter_type,
         }
         break;
     case PNG_FILTER_VALUE_UP:
-        s->add_bytes_l2(dst, src, last, size);
+        s->dsp.add_bytes_l2(dst, src, last, size);
         break;
     case PNG_FILTER_VALUE_AVG:
         for(i = 0; i < bpp; i++) {
@@ -217,10 +175,10 @@ static void png_filter_row(PNGDecContext *s, uint8_t *dst, int filter_type,
         if(bpp > 1 && size > 4) {
             // would write off the end of the array if we let it process the last pixel with bpp=3
             int w = bpp==4 ? size : size-3;
-            s->add_paeth_prediction(dst+i, src+i, last+i, w-i, bpp);
+            s->dsp.add_paeth_prediction(dst+i, src+i, last+i, w-i, bpp);
             i = w;
         }
-        add_paeth_prediction_c(dst+i, src+i, last+i, size-i, bpp);
+        ff_add_png_paeth_prediction(dst+i, src+i, last+i, size-i, bpp);
         break;
     }
 }
@@ -376,7 +334,7 @@ static int decode_frame(AVCodecContext *avctx,
     int buf_size = avpkt->size;
     PNGDecContext * const s = avctx->priv_data;
     AVFrame *picture = data;
-    AVFrame *p;
+    AVFrame *p, *last;
     uint8_t *crow_buf_base = NULL;
     uint32_t tag, length;
     int ret;
@@ -477,10 +435,10 @@ static int decode_frame(AVCodecContext *avctx,
                     goto fail;
                 }
                 if(p->data[0])
-                    avctx->release_buffer(avctx, p);
+                    ff_thread_release_buffer(avctx, p);
 
                 p->reference= 0;
-                if(avctx->get_buffer(avctx, p) < 0){
+                if(ff_thread_get_buffer(avctx, p) < 0){
                     av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
                     goto fail;
                 }
@@ -524,6 +482,8 @@ static int decode_frame(AVCodecContext *avctx,
                 s->crow_buf = crow_buf_base + 15;
                 s->zstream.avail_out = s->crow_size;
                 s->zstream.next_out = s->crow_buf;
+
+                ff_thread_finish_setup(avctx);
             }
             s->state |= PNG_IDAT;
             if (png_decode_idat(s, length) < 0)
@@ -581,11 +541,14 @@ static int decode_frame(AVCodecContext *avctx,
     }
  exit_loop:
      /* handle p-frames only if a predecessor frame is available */
-     if(s->last_picture->data[0] != NULL) {
+     last = avctx->active_thread_type & FF_THREAD_FRAME ? &s->prev_picture : s->last_picture;
+     if(last->data[0] != NULL) {
          if(!(avpkt->flags & AV_PKT_FLAG_KEY)) {
             int i, j;
             uint8_t *pd = s->current_picture->data[0];
-            uint8_t *pd_last = s->last_picture->data[0];
+            uint8_t *pd_last = last->data[0];
+
+            ff_thread_await_progress(last, INT_MAX, 0);
 
             for(j=0; j < s->height; j++) {
                 for(i=0; i < s->width * s->bpp; i++) {
@@ -602,6 +565,8 @@ static int decode_frame(AVCodecContext *avctx,
 
     ret = s->bytestream - s->bytestream_start;
  the_end:
+    if (p->data[0])
+        ff_thread_report_progress(p, INT_MAX, 0);
     inflateEnd(&s->zstream);
     av_free(crow_buf_base);
     s->crow_buf = NULL;
@@ -622,14 +587,33 @@ static av_cold int png_dec_init(AVCodecContext *avctx)
     avcodec_get_frame_defaults(&s->picture1);
     avcodec_get_frame_defaults(&s->picture2);
 
-#if HAVE_MMX
-    ff_png_init_mmx(s);
-#endif
+    ff_pngdsp_init(&s->dsp);
+
+    return 0;
+}
+
+static av_cold int png_dec_init_thread_copy(AVCodecContext *avctx)
+{
+    PNGDecContext *s = avctx->priv_data;
+
+    s->current_picture = &s->picture1;
+    s->last_picture = &s->picture2;
+
+    return 0;
+}
+
+static int png_dec_update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    PNGDecContext *s = dst->priv_data;
+    const PNGDecContext *s1 = src->priv_data;
+
+    if (dst == src)
+        return 0;
 
-    if (!s->add_paeth_prediction)
-        s->add_paeth_prediction = add_paeth_prediction_c;
-    if (!s->add_bytes_l2)
-        s->add_bytes_l2 = add_bytes_l2_c;
+    /* the picture stays allocated until that thread has decoded two more
+       frames, which cannot happen before this thread is done with it */
+    s->prev_picture = *s1->current_picture;
+    memcpy(s->palette, s1->palette, sizeof(s->palette));
 
     return 0;
 }
@@ -639,9 +623,9 @@ static av_cold int png_dec_end(AVCodecContext *avctx)
     PNGDecContext *s = avctx->priv_data;
 
     if (s->picture1.data[0])
-        avctx->release_buffer(avctx, &s->picture1);
+        ff_thread_release_buffer(avctx, &s->picture1);
     if (s->picture2.data[0])
-        avctx->release_buffer(avctx, &s->picture2);
+        ff_thread_release_buffer(avctx, &s->picture2);
 
     return 0;
 }
@@ -654,6 +638,8 @@ AVCodec ff_png_decoder = {
     .init           = png_dec_init,
     .close          = png_dec_end,
     .decode         = decode_frame,
-    .capabilities   = CODEC_CAP_DR1 /*| CODEC_CAP_DRAW_HORIZ_BAND*/,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS /*| CODEC_CAP_DRAW_HORIZ_BAND*/,
     .long_name = NULL_IF_CONFIG_SMALL("PNG image"),
+    .init_thread_copy = ONLY_IF_THREADS_ENABLED(png_dec_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(png_dec_update_thread_context),
 };
@@ -0,0 +1,102 @@
+/*
+ * PNG image format DSP functions
+ * Copyright (c) 2003 Fabrice Bellard
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include "libavutil/common.h"
+#include "pngdsp.h"
+
+// 0x7f7f7f7f or 0x7f7f7f7f7f7f7f7f or whatever, depending on the cpu's native arithmetic size
+#define pb_7f (~0UL/255 * 0x7f)
+#define pb_80 (~0UL/255 * 0x80)
+
+static void add_bytes_l2_c(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w)
+{
+    long i;
+    for(i=0; i<=w-sizeof(long); i+=sizeof(long)){
+        long a = *(long*)(src1+i);
+        long b = *(long*)(src2+i);
+        *(long*)(dst+i) = ((a&pb_7f) + (b&pb_7f)) ^ ((a^b)&pb_80);
+    }
+    for(; i<w; i++)
+        dst[i] = src1[i]+src2[i];
+}
+
+static av_always_inline int paeth_predictor(int a, int b, int c)
+{
+    int p, pa, pb, pc;
+
+    p = b - c;
+    pc = a - c;
+
+    pa = abs(p);
+    pb = abs(pc);
+    pc = abs(p + pc);
+
+    if (pa <= pb && pa <= pc)
+        return a;
+    else if (pb <= pc)
+        return b;
+    else
+        return c;
+}
+
+void ff_add_png_paeth_prediction(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp)
+{
+    int i;
+    for(i = 0; i < w; i++)
+        dst[i] = paeth_predictor(dst[i - bpp], top[i], top[i - bpp]) + src[i];
+}
+
+static void sub_avg_prediction_c(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *top, int w, int bpp)
+{
+    int i;
+    for(i = 0; i < w; i++)
+        dst[i] = src[i] - ((src[i - bpp] + top[i]) >> 1);
+}
+
+void ff_sub_png_paeth_prediction(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *top, int w, int bpp)
+{
+    int i;
+    for(i = 0; i < w; i++)
+        dst[i] = src[i] - paeth_predictor(src[i - bpp], top[i], top[i - bpp]);
+}
+
+static int filter_cost_c(const uint8_t *buf, int w)
+{
+    int i, cost = 0;
+    for(i = 0; i < w; i++)
+        cost += abs((int8_t)buf[i]);
+    return cost;
+}
+
+av_cold void ff_pngdsp_init(PNGDSPContext *c)
+{
+    c->add_bytes_l2         = add_bytes_l2_c;
+    c->add_paeth_prediction = ff_add_png_paeth_prediction;
+    c->sub_avg_prediction   = sub_avg_prediction_c;
+    c->sub_paeth_prediction = ff_sub_png_paeth_prediction;
+    c->filter_cost          = filter_cost_c;
+
+    if (HAVE_MMX)
+        ff_pngdsp_init_x86(c);
+}
@@ -0,0 +1,68 @@
+/*
+ * PNG image format DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_PNGDSP_H
+#define AVCODEC_PNGDSP_H
+
+#include <stdint.h>
+
+typedef struct PNGDSPContext {
+    /* decoder */
+    void (*add_bytes_l2)(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w);
+
+    /**
+     * Undo the Paeth filter of a row. The predictors are read from dst,
+     * so the first bpp bytes before dst must hold the reconstructed pixel.
+     * @param bpp  bytes per pixel; the row end may be overread by up to
+     *             3 bytes if bpp is 3
+     */
+    void (*add_paeth_prediction)(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp);
+
+    /* encoder */
+    /**
+     * Apply the average filter to a row:
+     * dst[i] = src[i] - ((src[i - bpp] + top[i]) >> 1)
+     * The first bpp bytes before src and top must be valid.
+     */
+    void (*sub_avg_prediction)(uint8_t *dst, const uint8_t *src,
+                               const uint8_t *top, int w, int bpp);
+
+    /**
+     * Apply the Paeth filter to a row.
+     * The first bpp bytes before src and top must be valid.
+     */
+    void (*sub_paeth_prediction)(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *top, int w, int bpp);
+
+    /**
+     * Sum of the absolute values of a row of filtered bytes read as int8_t,
+     * the cost used to pick the filter of a row.
+     */
+    int (*filter_cost)(const uint8_t *buf, int w);
+} PNGDSPContext;
+
+void ff_add_png_paeth_prediction(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp);
+void ff_sub_png_paeth_prediction(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *top, int w, int bpp);
+
+void ff_pngdsp_init(PNGDSPContext *c);
+void ff_pngdsp_init_x86(PNGDSPContext *c);
+
+#endif /* AVCODEC_PNGDSP_H */
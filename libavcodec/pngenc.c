@@ -33,8 +33,17 @@
 
 #define IOBUF_SIZE 4096
 
+typedef struct PNGEncBand {
+    int y_start, y_end;                 ///< rows of the band
+    uint8_t *buf;                       ///< compressed rows, with room for the zlib header and trailer
+    int size;                           ///< size of the compressed rows
+    uLong adler;                        ///< Adler-32 of the filtered rows
+    int ret;
+} PNGEncBand;
+
 typedef struct PNGEncContext {
     DSPContext dsp;
+    PNGDSPContext pngdsp;
 
     uint8_t *bytestream;
     uint8_t *bytestream_start;
@@ -45,6 +54,15 @@ typedef struct PNGEncContext {
 
     z_stream zstream;
     uint8_t buf[IOBUF_SIZE];
+
+    /* bands of rows filtered and compressed in parallel */
+    int color_type;
+    int row_size;
+    int bits_per_pixel;
+    int compression_level;
+    uint8_t *filtered_buf;              ///< filter type and filtered bytes of all rows
+    PNGEncBand *bands;
+    int nb_bands;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -85,34 +103,7 @@ static void png_get_interlaced_row(uint8_t *dst, int row_size,
     }
 }
 
-static void sub_png_paeth_prediction(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp)
-{
-    int i;
-    for(i = 0; i < w; i++) {
-        int a, b, c, p, pa, pb, pc;
-
-        a = src[i - bpp];
-        b = top[i];
-        c = top[i - bpp];
-
-        p = b - c;
-        pc = a - c;
-
-        pa = abs(p);
-        pb = abs(pc);
-        pc = abs(p + pc);
-
-        if (pa <= pb && pa <= pc)
-            p = a;
-        else if (pb <= pc)
-            p = b;
-        else
-            p = c;
-        dst[i] = src[i] - p;
-    }
-}
-
-static void png_filter_row(DSPContext *dsp, uint8_t *dst, int filter_type,
+static void png_filter_row(PNGEncContext *s, uint8_t *dst, int filter_type,
                            uint8_t *src, uint8_t *top, int size, int bpp)
 {
     int i;
@@ -122,22 +113,21 @@ static void png_filter_row(DSPContext *dsp, uint8_t *dst, int filter_type,
         memcpy(dst, src, size);
         break;
     case PNG_FILTER_VALUE_SUB:
-        dsp->diff_bytes(dst, src, src-bpp, size);
+        s->dsp.diff_bytes(dst, src, src-bpp, size);
         memcpy(dst, src, bpp);
         break;
     case PNG_FILTER_VALUE_UP:
-        dsp->diff_bytes(dst, src, top, size);
+        s->dsp.diff_bytes(dst, src, top, size);
         break;
     case PNG_FILTER_VALUE_AVG:
         for(i = 0; i < bpp; i++)
             dst[i] = src[i] - (top[i] >> 1);
-        for(; i < size; i++)
-            dst[i] = src[i] - ((src[i-bpp] + top[i]) >> 1);
+        s->pngdsp.sub_avg_prediction(dst+i, src+i, top+i, size-i, bpp);
         break;
     case PNG_FILTER_VALUE_PAETH:
         for(i = 0; i < bpp; i++)
             dst[i] = src[i] - top[i];
-        sub_png_paeth_prediction(dst+i, src+i, top+i, size-i, bpp);
+        s->pngdsp.sub_paeth_prediction(dst+i, src+i, top+i, size-i, bpp);
         break;
     }
 }
@@ -150,15 +140,12 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
     if(!top && pred)
         pred = PNG_FILTER_VALUE_SUB;
     if(pred == PNG_FILTER_VALUE_MIXED) {
-        int i;
         int cost, bcost = INT_MAX;
         uint8_t *buf1 = dst, *buf2 = dst + size + 16;
         for(pred=0; pred<5; pred++) {
-            png_filter_row(&s->dsp, buf1+1, pred, src, top, size, bpp);
+            png_filter_row(s, buf1+1, pred, src, top, size, bpp);
             buf1[0] = pred;
-            cost = 0;
-            for(i=0; i<=size; i++)
-                cost += abs((int8_t)buf1[i]);
+            cost = s->pngdsp.filter_cost(buf1, size + 1);
             if(cost < bcost) {
                 bcost = cost;
                 FFSWAP(uint8_t*, buf1, buf2);
@@ -166,7 +153,7 @@ static uint8_t *png_choose_filter(PNGEncContext *s, uint8_t *dst,
         }
         return buf2;
     } else {
-        png_filter_row(&s->dsp, dst+1, pred, src, top, size, bpp);
+        png_filter_row(s, dst+1, pred, src, top, size, bpp);
         dst[0] = pred;
         return dst;
     }
@@ -229,11 +216,186 @@ static int png_write_row(PNGEncContext *s, const uint8_t *data, int size)
     return 0;
 }
 
+static int filter_band_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncBand *band = &s->bands[jobnr];
+    const AVFrame *p = &s->picture;
+    int y, row_size = s->row_size, bpp = s->bits_per_pixel >> 3;
+    uint8_t *ptr, *top, *crow;
+    uint8_t *crow_base, *crow_buf;
+    uint8_t *rgba_buf = NULL, *top_buf = NULL;
+
+    crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    if (!crow_base)
+        goto fail;
+    crow_buf = crow_base + 15;
+    if (s->color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+        rgba_buf = av_malloc(row_size + 1);
+        top_buf  = av_malloc(row_size + 1);
+        if (!rgba_buf || !top_buf)
+            goto fail;
+    }
+
+    /* the row above the band is the reference of its first row */
+    top = NULL;
+    if (band->y_start > 0) {
+        top = p->data[0] + (band->y_start - 1) * p->linesize[0];
+        if (s->color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+            convert_from_rgb32(rgba_buf, top, avctx->width);
+            top = rgba_buf;
+        }
+    }
+    for (y = band->y_start; y < band->y_end; y++) {
+        ptr = p->data[0] + y * p->linesize[0];
+        if (s->color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+            FFSWAP(uint8_t*, rgba_buf, top_buf);
+            convert_from_rgb32(rgba_buf, ptr, avctx->width);
+            ptr = rgba_buf;
+        }
+        crow = png_choose_filter(s, crow_buf, ptr, top, row_size, bpp);
+        memcpy(s->filtered_buf + y * (row_size + 1), crow, row_size + 1);
+        top = ptr;
+    }
+    band->ret = 0;
+    goto end;
+fail:
+    band->ret = AVERROR(ENOMEM);
+end:
+    av_free(crow_base);
+    av_free(rgba_buf);
+    av_free(top_buf);
+    return 0;
+}
+
+/**
+ * Compress the filtered rows of a band as raw deflate data.
+ * Bands other than the last are terminated by a sync flush, so that they end
+ * on a byte boundary and can be concatenated into a single stream. The last
+ * 32 kB of the previous band are used as preset dictionary, as the window of
+ * a single stream would have held them.
+ */
+static int deflate_band_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncBand *band = &s->bands[jobnr];
+    int stride = s->row_size + 1;
+    uint8_t *data = s->filtered_buf + band->y_start * stride;
+    int size = (band->y_end - band->y_start) * stride;
+    int last = jobnr == s->nb_bands - 1;
+    z_stream zstream;
+    int ret, buf_size;
+
+    band->ret = -1;
+
+    zstream.zalloc = ff_png_zalloc;
+    zstream.zfree  = ff_png_zfree;
+    zstream.opaque = NULL;
+    if (deflateInit2(&zstream, s->compression_level,
+                     Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    if (jobnr) {
+        int dict_size = FFMIN(band->y_start * stride, 32768);
+        if (deflateSetDictionary(&zstream, data - dict_size, dict_size) != Z_OK)
+            goto end;
+    }
+
+    /* the sync flush marker takes 5 bytes, 2 for the zlib header and
+     * 4 for the Adler-32 trailer are reserved as well */
+    buf_size = deflateBound(&zstream, size) + 16;
+    band->buf = av_malloc(buf_size + 6);
+    if (!band->buf)
+        goto end;
+    zstream.next_in   = data;
+    zstream.avail_in  = size;
+    zstream.next_out  = band->buf + 2;
+    zstream.avail_out = buf_size;
+    ret = deflate(&zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (last ? ret != Z_STREAM_END : ret != Z_OK || !zstream.avail_out)
+        goto end;
+    band->size  = buf_size - zstream.avail_out;
+    band->adler = adler32(adler32(0, Z_NULL, 0), data, size);
+    band->ret   = 0;
+end:
+    deflateEnd(&zstream);
+    return 0;
+}
+
+/**
+ * Filter and compress the rows of a non-interlaced image in bands, one per
+ * thread, and write them as a single zlib stream split in one IDAT chunk per
+ * band.
+ */
+static int encode_rows_parallel(AVCodecContext *avctx)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int i, ret = -1, level_flags;
+    unsigned int header;
+    uLong adler;
+
+    s->nb_bands = FFMIN(avctx->thread_count, avctx->height);
+    s->bands = av_mallocz(s->nb_bands * sizeof(*s->bands));
+    s->filtered_buf = av_malloc(avctx->height * (s->row_size + 1));
+    if (!s->bands || !s->filtered_buf)
+        goto end;
+    for (i = 0; i < s->nb_bands; i++) {
+        s->bands[i].y_start = avctx->height *  i      / s->nb_bands;
+        s->bands[i].y_end   = avctx->height * (i + 1) / s->nb_bands;
+    }
+
+    avctx->execute2(avctx, filter_band_thread, NULL, NULL, s->nb_bands);
+    for (i = 0; i < s->nb_bands; i++)
+        if (s->bands[i].ret < 0)
+            goto end;
+    avctx->execute2(avctx, deflate_band_thread, NULL, NULL, s->nb_bands);
+    for (i = 0; i < s->nb_bands; i++)
+        if (s->bands[i].ret < 0)
+            goto end;
+
+    /* zlib header, with the compression level hint deflate() would write */
+    if (s->compression_level == Z_DEFAULT_COMPRESSION || s->compression_level == 6)
+        level_flags = 2;
+    else if (s->compression_level < 2)
+        level_flags = 0;
+    else if (s->compression_level < 6)
+        level_flags = 1;
+    else
+        level_flags = 3;
+    header  = (Z_DEFLATED + ((15 - 8) << 4)) << 8 | level_flags << 6;
+    header += 31 - header % 31;
+    AV_WB16(s->bands[0].buf, header);
+
+    adler = s->bands[0].adler;
+    for (i = 1; i < s->nb_bands; i++)
+        adler = adler32_combine(adler, s->bands[i].adler,
+                                (s->bands[i].y_end - s->bands[i].y_start) * (s->row_size + 1));
+    AV_WB32(s->bands[s->nb_bands - 1].buf + 2 + s->bands[s->nb_bands - 1].size, adler);
+    s->bands[s->nb_bands - 1].size += 4;
+
+    for (i = 0; i < s->nb_bands; i++) {
+        PNGEncBand *band = &s->bands[i];
+        uint8_t *start = i ? band->buf + 2 : band->buf;
+        int size = i ? band->size : band->size + 2;
+        if (s->bytestream_end - s->bytestream < size + 12 + 12) {
+            av_log(avctx, AV_LOG_ERROR, "output buffer too small\n");
+            goto end;
+        }
+        png_write_chunk(&s->bytestream, MKTAG('I', 'D', 'A', 'T'), start, size);
+    }
+    ret = 0;
+end:
+    for (i = 0; s->bands && i < s->nb_bands; i++)
+        av_free(s->bands[i].buf);
+    av_freep(&s->bands);
+    av_freep(&s->filtered_buf);
+    return ret;
+}
+
 static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size, void *data){
     PNGEncContext *s = avctx->priv_data;
     AVFrame *pict = data;
     AVFrame * const p= &s->picture;
-    int bit_depth, color_type, y, len, row_size, ret, is_progressive;
+    int bit_depth, color_type, y, len, row_size, ret, is_progressive, parallel;
     int bits_per_pixel, pass_row_size;
     int compression_level;
     uint8_t *ptr, *top;
@@ -251,6 +413,7 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
     s->bytestream_end= buf+buf_size;
 
     is_progressive = !!(avctx->flags & CODEC_FLAG_INTERLACED_DCT);
+    parallel = avctx->active_thread_type & FF_THREAD_SLICE && !is_progressive;
     switch(avctx->pix_fmt) {
     case PIX_FMT_RGB32:
         bit_depth = 8;
@@ -284,6 +447,10 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT ?
                             Z_DEFAULT_COMPRESSION :
                             av_clip(avctx->compression_level, 0, 9);
+    s->color_type        = color_type;
+    s->row_size          = row_size;
+    s->bits_per_pixel    = bits_per_pixel;
+    s->compression_level = compression_level;
     ret = deflateInit2(&s->zstream, compression_level,
                        Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY);
     if (ret != Z_OK)
@@ -377,6 +544,9 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
                 }
             }
         }
+    } else if (parallel) {
+        if (encode_rows_parallel(avctx) < 0)
+            goto fail;
     } else {
         top = NULL;
         for(y = 0; y < avctx->height; y++) {
@@ -391,8 +561,8 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
             top = ptr;
         }
     }
-    /* compress last bytes */
-    for(;;) {
+    /* compress last bytes, the parallel path already wrote the whole stream */
+    while (!parallel) {
         ret = deflate(&s->zstream, Z_FINISH);
         if (ret == Z_OK || ret == Z_STREAM_END) {
             len = IOBUF_SIZE - s->zstream.avail_out;
@@ -428,6 +598,7 @@ static av_cold int png_enc_init(AVCodecContext *avctx){
     avcodec_get_frame_defaults(&s->picture);
     avctx->coded_frame= &s->picture;
     dsputil_init(&s->dsp, avctx);
+    ff_pngdsp_init(&s->pngdsp);
 
     s->filter_type = av_clip(avctx->prediction_method, PNG_FILTER_VALUE_NONE, PNG_FILTER_VALUE_MIXED);
     if(avctx->pix_fmt == PIX_FMT_MONOBLACK)
@@ -443,6 +614,7 @@ AVCodec ff_png_encoder = {
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
     .encode         = encode_frame,
+    .capabilities   = CODEC_CAP_SLICE_THREADS,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_RGB24, PIX_FMT_RGB32, PIX_FMT_PAL8, PIX_FMT_GRAY8, PIX_FMT_MONOBLACK, PIX_FMT_NONE},
     .long_name= NULL_IF_CONFIG_SMALL("PNG image"),
 };
@@ -0,0 +1,134 @@
+/*
+ * Frame pre-analysis for encoders
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Frame pre-analysis for encoders.
+ */
+
+#include "libavutil/common.h"
+#include "preanalysis.h"
+
+/* a frame starts a new scene if both its brightness distribution and its
+ * content changed, the histogram alone does not see cuts between similar
+ * looking shots and the SAD alone triggers on fast motion;
+ * these are the thresholds for the default scenechange_threshold of 0 */
+#define SCENE_CUT_HIST_DELTA  32
+#define SCENE_CUT_SAD        (16 * 16)
+
+/**
+ * Scale a default threshold by 100 + scenechange_threshold percent, so that
+ * positive values detect fewer cuts, negative ones more, and 1000000000,
+ * the value which disables the scene change detection of the encoders,
+ * disables it here as well.
+ */
+static int scale_threshold(int threshold, int scenechange_threshold)
+{
+    int64_t scale = FFMAX(100 + (int64_t)scenechange_threshold, 0);
+
+    return FFMIN(threshold * scale / 100, INT_MAX);
+}
+
+av_cold int ff_preanalysis_init(PreAnalysisContext *pa, AVCodecContext *avctx, DSPContext *dsp,
+                                int mb_width, int mb_height, int mb_stride)
+{
+    const int size = mb_width * 8 * mb_height * 8;
+
+    memset(pa, 0, sizeof(*pa));
+    pa->avctx         = avctx;
+    pa->dsp           = dsp;
+    pa->mb_width      = mb_width;
+    pa->mb_height     = mb_height;
+    pa->mb_stride     = mb_stride;
+    pa->lowres_stride = mb_width * 8;
+    pa->hist_threshold = scale_threshold(SCENE_CUT_HIST_DELTA, avctx->scenechange_threshold);
+    pa->sad_threshold  = scale_threshold(SCENE_CUT_SAD,        avctx->scenechange_threshold);
+
+    pa->lowres[0] = av_malloc(2 * size);
+    if (!pa->lowres[0])
+        return AVERROR(ENOMEM);
+    pa->lowres[1] = pa->lowres[0] + size;
+    return 0;
+}
+
+void ff_preanalysis_frame(PreAnalysisContext *pa, uint8_t *src, int stride,
+                          uint16_t *mb_var, uint8_t *mb_mean)
+{
+    DSPContext *dsp   = pa->dsp;
+    const int lstride = pa->lowres_stride;
+    uint8_t *cur, *prev;
+    int *hist;
+    int mb_x, mb_y, i, sad = 0, delta = 0;
+
+    FFSWAP(uint8_t*, pa->lowres[0], pa->lowres[1]);
+    cur  = pa->lowres[0];
+    prev = pa->lowres[1];
+    memcpy(pa->hist[1], pa->hist[0], sizeof(pa->hist[0]));
+    hist = pa->hist[0];
+    memset(hist, 0, sizeof(pa->hist[0]));
+
+    dsp->shrink[1](cur, lstride, src, stride, lstride, pa->mb_height * 8);
+
+    pa->mb_var_sum = 0;
+    for (mb_y = 0; mb_y < pa->mb_height; mb_y++) {
+        for (mb_x = 0; mb_x < pa->mb_width; mb_x++) {
+            /* same as mb_var_thread() in mpegvideo_enc.c */
+            uint8_t *pix = src + mb_y * 16 * stride + mb_x * 16;
+            int sum      = dsp->pix_sum(pix, stride);
+            int varc     = (dsp->pix_norm1(pix, stride) - (((unsigned)(sum * sum)) >> 8) + 500 + 128) >> 8;
+
+            if (mb_var)
+                mb_var [mb_y * pa->mb_stride + mb_x] = varc;
+            if (mb_mean)
+                mb_mean[mb_y * pa->mb_stride + mb_x] = (sum + 128) >> 8;
+            pa->mb_var_sum += varc;
+
+            if (pa->frame_count) {
+                const int offset = mb_y * 8 * lstride + mb_x * 8;
+                sad += dsp->sad[1](NULL, cur + offset, prev + offset, lstride, 8);
+            }
+        }
+    }
+    emms_c();
+
+    for (i = 0; i < lstride * pa->mb_height * 8; i++)
+        hist[cur[i] >> 2]++;
+
+    if (pa->frame_count) {
+        for (i = 0; i < PREANALYSIS_HIST_BINS; i++)
+            delta += FFABS(hist[i] - pa->hist[1][i]);
+        pa->sad        = sad / (pa->mb_width * pa->mb_height * 4);
+        pa->hist_delta = (int64_t)delta * 128 / (lstride * pa->mb_height * 8);
+    }
+    pa->frame_count++;
+}
+
+int ff_preanalysis_scene_cut(PreAnalysisContext *pa)
+{
+    return pa->frame_count > 1                 &&
+           pa->hist_delta > pa->hist_threshold &&
+           pa->sad        > pa->sad_threshold;
+}
+
+av_cold void ff_preanalysis_end(PreAnalysisContext *pa)
+{
+    av_freep(&pa->lowres[0]);
+    pa->lowres[1] = NULL;
+}
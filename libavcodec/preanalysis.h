@@ -0,0 +1,74 @@
+/*
+ * Frame pre-analysis for encoders
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_PREANALYSIS_H
+#define AVCODEC_PREANALYSIS_H
+
+#include <stdint.h>
+#include "avcodec.h"
+#include "dsputil.h"
+
+#define PREANALYSIS_HIST_BINS 64
+
+/**
+ * Single pass over the luma plane of each input frame which gathers the
+ * statistics several encoder stages need: the per-MB variance and mean
+ * used by rate control and adaptive quantization, and the half resolution
+ * SAD and histogram difference to the previous frame used for scene cut
+ * detection.
+ */
+typedef struct PreAnalysisContext {
+    AVCodecContext *avctx;
+    DSPContext *dsp;
+    int mb_width, mb_height, mb_stride;
+    int lowres_stride;              ///< mb_width * 8
+    uint8_t *lowres[2];             ///< half resolution luma of the current and previous frame
+    int hist[2][PREANALYSIS_HIST_BINS];
+    int frame_count;                ///< number of frames analyzed so far
+    int hist_threshold;             ///< hist_delta above which a frame may start a new scene
+    int sad_threshold;              ///< sad above which a frame may start a new scene
+
+    /* results for the last analyzed frame */
+    int mb_var_sum;                 ///< sum of the MB variances
+    int sad;                        ///< mean absolute difference to the previous frame, in 1/16 per pixel
+    int hist_delta;                 ///< histogram difference to the previous frame, 0 (same) to 256 (disjoint)
+} PreAnalysisContext;
+
+int ff_preanalysis_init(PreAnalysisContext *pa, AVCodecContext *avctx, DSPContext *dsp,
+                        int mb_width, int mb_height, int mb_stride);
+
+/**
+ * Analyze the next frame.
+ * @param src     luma plane, mb_width*16 x mb_height*16 pixels must be readable
+ * @param mb_var  if not NULL, filled with the variance of each MB, in the
+ *                units of Picture.mb_var
+ * @param mb_mean if not NULL, filled with the mean of each MB
+ */
+void ff_preanalysis_frame(PreAnalysisContext *pa, uint8_t *src, int stride,
+                          uint16_t *mb_var, uint8_t *mb_mean);
+
+/**
+ * @return 1 if the last analyzed frame starts a new scene, 0 otherwise
+ */
+int ff_preanalysis_scene_cut(PreAnalysisContext *pa);
+
+void ff_preanalysis_end(PreAnalysisContext *pa);
+
+#endif /* AVCODEC_PREANALYSIS_H */
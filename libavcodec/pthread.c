@@ -39,6 +39,8 @@ typedef int (action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr
 
 typedef struct ThreadContext {
     pthread_t *workers;
+    AVCodecContext *avctx;          ///< Context the current jobs are executed for.
+    int thread_count;
     action_func *func;
     action_func2 *func2;
     void *args;
@@ -52,6 +54,8 @@ typedef struct ThreadContext {
     pthread_mutex_t current_job_lock;
     int current_job;
     int done;
+
+    pthread_mutex_t execute_lock;   ///< Held by the frame thread using the workers with hybrid threading.
 } ThreadContext;
 
 /// Max number of frame buffers that can be allocated when using frame threads.
@@ -124,14 +128,18 @@ typedef struct FrameThreadContext {
                                     */
 
     int die;                       ///< Set when threads should exit.
+
+    ThreadContext *slice_threads;  /**<
+                                    * Slice threads shared by all frame threads,
+                                    * if both frame and slice threading are active.
+                                    */
 } FrameThreadContext;
 
 static void* attribute_align_arg worker(void *v)
 {
-    AVCodecContext *avctx = v;
-    ThreadContext *c = avctx->thread_opaque;
+    ThreadContext *c = v;
     int our_job = c->job_count;
-    int thread_count = avctx->thread_count;
+    int thread_count = c->thread_count;
     int self_id;
 
     pthread_mutex_lock(&c->current_job_lock);
@@ -151,8 +159,8 @@ static void* attribute_align_arg worker(void *v)
         }
         pthread_mutex_unlock(&c->current_job_lock);
 
-        c->rets[our_job%c->rets_count] = c->func ? c->func(avctx, (char*)c->args + our_job*c->job_size):
-                                                   c->func2(avctx, c->args, our_job, self_id);
+        c->rets[our_job%c->rets_count] = c->func ? c->func(c->avctx, (char*)c->args + our_job*c->job_size):
+                                                   c->func2(c->avctx, c->args, our_job, self_id);
 
         pthread_mutex_lock(&c->current_job_lock);
         our_job = c->current_job++;
@@ -165,9 +173,8 @@ static av_always_inline void avcodec_thread_park_workers(ThreadContext *c, int t
     pthread_mutex_unlock(&c->current_job_lock);
 }
 
-static void thread_free(AVCodecContext *avctx)
+static void thread_pool_free(ThreadContext *c)
 {
-    ThreadContext *c = avctx->thread_opaque;
     int i;
 
     pthread_mutex_lock(&c->current_job_lock);
@@ -175,34 +182,56 @@ static void thread_free(AVCodecContext *avctx)
     pthread_cond_broadcast(&c->current_job_cond);
     pthread_mutex_unlock(&c->current_job_lock);
 
-    for (i=0; i<avctx->thread_count; i++)
+    for (i=0; i<c->thread_count; i++)
          pthread_join(c->workers[i], NULL);
 
     pthread_mutex_destroy(&c->current_job_lock);
+    pthread_mutex_destroy(&c->execute_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
     av_free(c->workers);
-    av_freep(&avctx->thread_opaque);
+    av_free(c);
 }
 
-static int avcodec_thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+static void thread_free(AVCodecContext *avctx)
 {
-    ThreadContext *c= avctx->thread_opaque;
+    if (!avctx->thread_opaque)
+        return;
+    thread_pool_free(avctx->thread_opaque);
+    avctx->thread_opaque = NULL;
+}
+
+static int thread_execute(AVCodecContext *avctx, action_func *func, action_func2 *func2,
+                          void *arg, int *ret, int job_count, int job_size)
+{
+    ThreadContext *c = avctx->thread_opaque;
     int dummy_ret;
 
     if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
-        return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
+        goto execute_serial;
 
     if (job_count <= 0)
         return 0;
 
+    if (avctx->active_thread_type&FF_THREAD_FRAME) {
+        PerThreadContext *p = avctx->thread_opaque;
+        c = p->parent->slice_threads;
+
+        /* Do not wait for another frame thread to finish its slices, it may
+         * be waiting for progress on the frame this thread is decoding. */
+        if (pthread_mutex_trylock(&c->execute_lock))
+            goto execute_serial;
+    }
+
     pthread_mutex_lock(&c->current_job_lock);
 
-    c->current_job = avctx->thread_count;
+    c->avctx = avctx;
+    c->current_job = c->thread_count;
     c->job_count = job_count;
     c->job_size = job_size;
     c->args = arg;
     c->func = func;
+    c->func2 = func2;
     if (ret) {
         c->rets = ret;
         c->rets_count = job_count;
@@ -212,38 +241,46 @@ static int avcodec_thread_execute(AVCodecContext *avctx, action_func* func, void
     }
     pthread_cond_broadcast(&c->current_job_cond);
 
-    avcodec_thread_park_workers(c, avctx->thread_count);
+    avcodec_thread_park_workers(c, c->thread_count);
+
+    if (avctx->active_thread_type&FF_THREAD_FRAME)
+        pthread_mutex_unlock(&c->execute_lock);
 
     return 0;
+
+execute_serial:
+    if (func)
+        return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
+    return avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+}
+
+static int avcodec_thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+{
+    return thread_execute(avctx, func, NULL, arg, ret, job_count, job_size);
 }
 
 static int avcodec_thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    ThreadContext *c= avctx->thread_opaque;
-    c->func2 = func2;
-    return avcodec_thread_execute(avctx, NULL, arg, ret, job_count, 0);
+    return thread_execute(avctx, NULL, func2, arg, ret, job_count, 0);
 }
 
-static int thread_init(AVCodecContext *avctx)
+static ThreadContext *thread_pool_alloc(AVCodecContext *avctx, int thread_count)
 {
     int i;
     ThreadContext *c;
-    int thread_count = avctx->thread_count;
-
-    if (thread_count <= 1)
-        return 0;
 
     c = av_mallocz(sizeof(ThreadContext));
     if (!c)
-        return -1;
+        return NULL;
 
     c->workers = av_mallocz(sizeof(pthread_t)*thread_count);
     if (!c->workers) {
         av_free(c);
-        return -1;
+        return NULL;
     }
 
-    avctx->thread_opaque = c;
+    c->avctx = avctx;
+    c->thread_count = thread_count;
     c->current_job = 0;
     c->job_count = 0;
     c->job_size = 0;
@@ -251,18 +288,263 @@ static int thread_init(AVCodecContext *avctx)
     pthread_cond_init(&c->current_job_cond, NULL);
     pthread_cond_init(&c->last_job_cond, NULL);
     pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_init(&c->execute_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
     for (i=0; i<thread_count; i++) {
-        if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
-           avctx->thread_count = i;
+        if(pthread_create(&c->workers[i], NULL, worker, c)) {
+           c->thread_count = i;
            pthread_mutex_unlock(&c->current_job_lock);
-           ff_thread_free(avctx);
-           return -1;
+           thread_pool_free(c);
+           return NULL;
         }
     }
 
     avcodec_thread_park_workers(c, thread_count);
 
+    return c;
+}
+
+/**
+ * One execute() or execute2() call submitted to the shared thread pool.
+ * It lives on the stack of the calling thread.
+ */
+typedef struct PoolGroup {
+    AVCodecContext *avctx;
+    action_func *func;
+    action_func2 *func2;
+    void *args;
+    int *rets;
+    int rets_count;
+    int job_count;
+    int job_size;
+
+    int next_job;                   ///< Next job to be claimed.
+    int jobs_done;
+    int max_active;                 ///< Maximum number of jobs running at once.
+    unsigned int active;            ///< Bit mask of the thread numbers in use.
+
+    pthread_cond_t cond;            ///< Signaled when a job of this group finishes.
+    struct PoolGroup *next;         ///< Next group with jobs left to claim.
+} PoolGroup;
+
+#define POOL_MAX_ACTIVE 32
+
+/**
+ * Process-wide thread pool, see avcodec_thread_pool_init().
+ * All fields are protected by lock.
+ */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;       ///< Signaled when a group is added.
+    pthread_t *workers;
+    int nb_workers;
+    int die;
+    PoolGroup *first, *last;        ///< Groups with jobs left to claim, served round-robin.
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static int pool_can_claim(PoolGroup *g)
+{
+    return g->next_job < g->job_count && av_popcount(g->active) < g->max_active;
+}
+
+/**
+ * Claim the next job of g and pick a thread number for it. Moves g to the
+ * end of the queue, so that the next claim serves another context, or
+ * removes it if this was its last job.
+ * Must be called with pool.lock held.
+ */
+static int pool_claim(PoolGroup *g, int *threadnr)
+{
+    PoolGroup **pg, *prev = NULL;
+    int jobnr = g->next_job++;
+
+    *threadnr = av_log2(~g->active & (g->active + 1));
+    g->active |= 1U << *threadnr;
+
+    for (pg = &pool.first; *pg != g; pg = &(*pg)->next)
+        prev = *pg;
+    *pg = g->next;
+    if (pool.last == g)
+        pool.last = prev;
+    g->next = NULL;
+
+    if (g->next_job < g->job_count) {
+        if (pool.last)
+            pool.last->next = g;
+        else
+            pool.first = g;
+        pool.last = g;
+    }
+    return jobnr;
+}
+
+/**
+ * Run job jobnr of g with pool.lock released.
+ */
+static void pool_run_job(PoolGroup *g, int jobnr, int threadnr)
+{
+    int ret;
+
+    pthread_mutex_unlock(&pool.lock);
+    ret = g->func ? g->func(g->avctx, (char*)g->args + jobnr*g->job_size) :
+                    g->func2(g->avctx, g->args, jobnr, threadnr);
+    pthread_mutex_lock(&pool.lock);
+
+    g->rets[jobnr % g->rets_count] = ret;
+    g->active &= ~(1U << threadnr);
+    g->jobs_done++;
+    pthread_cond_signal(&g->cond);
+}
+
+static void* attribute_align_arg pool_worker(void *arg)
+{
+    pthread_mutex_lock(&pool.lock);
+    while (!pool.die) {
+        PoolGroup *g;
+
+        for (g = pool.first; g && !pool_can_claim(g); g = g->next);
+        if (g) {
+            int threadnr, jobnr = pool_claim(g, &threadnr);
+            pool_run_job(g, jobnr, threadnr);
+        } else
+            pthread_cond_wait(&pool.work_cond, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static int pool_execute_internal(AVCodecContext *avctx, action_func *func, action_func2 *func2,
+                                 void *arg, int *ret, int job_count, int job_size)
+{
+    PoolGroup g = { 0 };
+    int dummy_ret;
+
+    if (job_count <= 0)
+        return 0;
+
+    g.avctx      = avctx;
+    g.func       = func;
+    g.func2      = func2;
+    g.args       = arg;
+    g.rets       = ret ? ret : &dummy_ret;
+    g.rets_count = ret ? job_count : 1;
+    g.job_count  = job_count;
+    g.job_size   = job_size;
+    g.max_active = av_clip(avctx->thread_count, 1, POOL_MAX_ACTIVE);
+    pthread_cond_init(&g.cond, NULL);
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.last)
+        pool.last->next = &g;
+    else
+        pool.first = &g;
+    pool.last = &g;
+    pthread_cond_broadcast(&pool.work_cond);
+
+    /* Help with the own jobs rather than only waiting, this guarantees
+     * progress even when all pool threads are busy with other contexts. */
+    while (g.jobs_done < g.job_count) {
+        if (pool_can_claim(&g)) {
+            int threadnr, jobnr = pool_claim(&g, &threadnr);
+            pool_run_job(&g, jobnr, threadnr);
+        } else
+            pthread_cond_wait(&g.cond, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_cond_destroy(&g.cond);
+    return 0;
+}
+
+static int pool_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+{
+    return pool_execute_internal(avctx, func, NULL, arg, ret, job_count, job_size);
+}
+
+static int pool_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
+{
+    return pool_execute_internal(avctx, NULL, func2, arg, ret, job_count, 0);
+}
+
+int avcodec_thread_pool_init(int thread_count)
+{
+    int i;
+
+    if (thread_count <= 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.nb_workers) {
+        pthread_mutex_unlock(&pool.lock);
+        return AVERROR(EEXIST);
+    }
+    pool.workers = av_mallocz(sizeof(*pool.workers) * thread_count);
+    if (!pool.workers) {
+        pthread_mutex_unlock(&pool.lock);
+        return AVERROR(ENOMEM);
+    }
+    pool.die = 0;
+    for (i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool.workers[i], NULL, pool_worker, NULL))
+            break;
+        pool.nb_workers++;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (!pool.nb_workers) {
+        av_freep(&pool.workers);
+        return AVERROR(EAGAIN);
+    }
+    return 0;
+}
+
+void avcodec_thread_pool_uninit(void)
+{
+    int i;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.die = 1;
+    pthread_cond_broadcast(&pool.work_cond);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (i = 0; i < pool.nb_workers; i++)
+        pthread_join(pool.workers[i], NULL);
+
+    pthread_mutex_lock(&pool.lock);
+    av_freep(&pool.workers);
+    pool.nb_workers = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static int pool_active(void)
+{
+    int active;
+
+    pthread_mutex_lock(&pool.lock);
+    active = pool.nb_workers > 0;
+    pthread_mutex_unlock(&pool.lock);
+    return active;
+}
+
+static int thread_init(AVCodecContext *avctx)
+{
+    ThreadContext *c;
+    int thread_count = avctx->thread_count;
+
+    if (thread_count <= 1)
+        return 0;
+
+    if (pool_active()) {
+        avctx->execute  = pool_execute;
+        avctx->execute2 = pool_execute2;
+        return 0;
+    }
+
+    c = thread_pool_alloc(avctx, thread_count);
+    if (!c)
+        return -1;
+
+    avctx->thread_opaque = c;
     avctx->execute = avcodec_thread_execute;
     avctx->execute2 = avcodec_thread_execute2;
     return 0;
@@ -594,6 +876,52 @@ void ff_thread_await_progress(AVFrame *f, int n, int field)
     pthread_mutex_unlock(&p->progress_mutex);
 }
 
+struct ThreadProgress {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int value;
+};
+
+ThreadProgress *ff_thread_progress_alloc(void)
+{
+    ThreadProgress *p = av_mallocz(sizeof(*p));
+
+    if (!p)
+        return NULL;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    return p;
+}
+
+void ff_thread_progress_free(ThreadProgress **p)
+{
+    if (!*p)
+        return;
+    pthread_mutex_destroy(&(*p)->mutex);
+    pthread_cond_destroy(&(*p)->cond);
+    av_freep(p);
+}
+
+void ff_thread_progress_set(ThreadProgress *p, int n)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->value = n;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+int ff_thread_progress_wait(ThreadProgress *p, int n)
+{
+    int value;
+
+    pthread_mutex_lock(&p->mutex);
+    while (p->value < n)
+        pthread_cond_wait(&p->cond, &p->mutex);
+    value = p->value;
+    pthread_mutex_unlock(&p->mutex);
+    return value;
+}
+
 void ff_thread_finish_setup(AVCodecContext *avctx) {
     PerThreadContext *p = avctx->thread_opaque;
 
@@ -670,6 +998,9 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
         av_freep(&p->avctx);
     }
 
+    if (fctx->slice_threads)
+        thread_pool_free(fctx->slice_threads);
+
     av_freep(&fctx->threads);
     pthread_mutex_destroy(&fctx->buffer_mutex);
     av_freep(&avctx->thread_opaque);
@@ -694,6 +1025,12 @@ static int frame_thread_init(AVCodecContext *avctx)
     pthread_mutex_init(&fctx->buffer_mutex, NULL);
     fctx->delaying = 1;
 
+    if ((avctx->active_thread_type&FF_THREAD_SLICE) && !pool_active()) {
+        fctx->slice_threads = thread_pool_alloc(avctx, thread_count);
+        if (!fctx->slice_threads)
+            avctx->active_thread_type &= ~FF_THREAD_SLICE;
+    }
+
     for (i = 0; i < thread_count; i++) {
         AVCodecContext *copy = av_malloc(sizeof(AVCodecContext));
         PerThreadContext *p  = &fctx->threads[i];
@@ -710,6 +1047,10 @@ static int frame_thread_init(AVCodecContext *avctx)
         *copy = *src;
         copy->thread_opaque = p;
         copy->pkt = &p->avpkt;
+        if (avctx->active_thread_type&FF_THREAD_SLICE) {
+            copy->execute  = fctx->slice_threads ? avcodec_thread_execute  : pool_execute;
+            copy->execute2 = fctx->slice_threads ? avcodec_thread_execute2 : pool_execute2;
+        }
 
         if (!i) {
             src = copy;
@@ -869,6 +1210,8 @@ void ff_thread_release_buffer(AVCodecContext *avctx, AVFrame *f)
  * Threading requires more than one thread.
  * Frame threading requires entire frames to be passed to the codec,
  * and introduces extra decoding delay, so is incompatible with low_delay.
+ * Hybrid threading uses frame threading, with the slices of each frame
+ * additionally decoded in parallel if the codec supports slice threading.
  *
  * @param avctx The context.
  */
@@ -880,10 +1223,14 @@ static void validate_thread_parameters(AVCodecContext *avctx)
                                 && !(avctx->flags2 & CODEC_FLAG2_CHUNKS);
     if (avctx->thread_count == 1) {
         avctx->active_thread_type = 0;
-    } else if (frame_threading_supported && (avctx->thread_type & FF_THREAD_FRAME)) {
+    } else if (frame_threading_supported &&
+               (avctx->thread_type & (FF_THREAD_FRAME|FF_THREAD_HYBRID))) {
         avctx->active_thread_type = FF_THREAD_FRAME;
+        if (avctx->codec->capabilities & CODEC_CAP_SLICE_THREADS &&
+            avctx->thread_type & FF_THREAD_HYBRID)
+            avctx->active_thread_type |= FF_THREAD_SLICE;
     } else if (avctx->codec->capabilities & CODEC_CAP_SLICE_THREADS &&
-               avctx->thread_type & FF_THREAD_SLICE) {
+               avctx->thread_type & (FF_THREAD_SLICE|FF_THREAD_HYBRID)) {
         avctx->active_thread_type = FF_THREAD_SLICE;
     }
 }
@@ -898,10 +1245,10 @@ int ff_thread_init(AVCodecContext *avctx)
     if (avctx->codec) {
         validate_thread_parameters(avctx);
 
-        if (avctx->active_thread_type&FF_THREAD_SLICE)
-            return thread_init(avctx);
-        else if (avctx->active_thread_type&FF_THREAD_FRAME)
+        if (avctx->active_thread_type&FF_THREAD_FRAME)
             return frame_thread_init(avctx);
+        else if (avctx->active_thread_type&FF_THREAD_SLICE)
+            return thread_init(avctx);
     }
 
     return 0;
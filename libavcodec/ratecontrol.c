@@ -126,6 +126,31 @@ int ff_rate_control_init(MpegEncContext *s)
     }
     rcc->buffer_index= s->avctx->rc_initial_buffer_occupancy;
 
+    rcc->mbtree_picture_number= -1;
+    if(s->lookahead){
+        const int mb_size= s->mb_stride * s->mb_height;
+        const int mv_table_size= s->mb_stride * (s->mb_height + 2) + 1;
+
+        rcc->nb_lookahead= s->lookahead + s->max_b_frames + 2;
+        rcc->lookahead= av_mallocz(rcc->nb_lookahead * sizeof(*rcc->lookahead));
+        rcc->mbtree_propagate[0]= av_malloc(mb_size * sizeof(float));
+        rcc->mbtree_propagate[1]= av_malloc(mb_size * sizeof(float));
+        rcc->mbtree_factor      = av_malloc(mb_size * sizeof(float));
+        if(!rcc->lookahead || !rcc->mbtree_propagate[0] || !rcc->mbtree_propagate[1] || !rcc->mbtree_factor)
+            return AVERROR(ENOMEM);
+        for(i=0; i<rcc->nb_lookahead; i++){
+            RateControlLookahead *la= &rcc->lookahead[i];
+
+            la->picture_number= -1;
+            la->intra_cost= av_mallocz(mb_size * sizeof(int));
+            la->inter_cost= av_mallocz(mb_size * sizeof(int));
+            la->mv_base   = av_mallocz(mv_table_size * 2 * sizeof(int16_t));
+            if(!la->intra_cost || !la->inter_cost || !la->mv_base)
+                return AVERROR(ENOMEM);
+            la->mv= la->mv_base + s->mb_stride + 1;
+        }
+    }
+
     if(s->flags&CODEC_FLAG_PASS2){
         int i;
         char *p;
@@ -180,6 +205,12 @@ int ff_rate_control_init(MpegEncContext *s)
             p= next;
         }
 
+        if(s->rc_stats_offset >= rcc->num_entries){
+            av_log(s->avctx, AV_LOG_ERROR, "rc_stats_offset %d is beyond the %d frames of the statistics\n",
+                   s->rc_stats_offset, rcc->num_entries);
+            return -1;
+        }
+
         if(init_pass2(s) < 0) return -1;
 
         //FIXME maybe move to end
@@ -257,6 +288,19 @@ void ff_rate_control_uninit(MpegEncContext *s)
     av_expr_free(rcc->rc_eq_eval);
     av_freep(&rcc->entry);
 
+    if(rcc->lookahead){
+        int i;
+        for(i=0; i<rcc->nb_lookahead; i++){
+            av_freep(&rcc->lookahead[i].intra_cost);
+            av_freep(&rcc->lookahead[i].inter_cost);
+            av_freep(&rcc->lookahead[i].mv_base);
+        }
+        av_freep(&rcc->lookahead);
+    }
+    av_freep(&rcc->mbtree_propagate[0]);
+    av_freep(&rcc->mbtree_propagate[1]);
+    av_freep(&rcc->mbtree_factor);
+
 #if CONFIG_LIBXVID
     if((s->flags&CODEC_FLAG_PASS2) && s->avctx->rc_strategy == FF_RC_STRATEGY_XVID)
         ff_xvid_rate_control_uninit(s);
@@ -593,6 +637,9 @@ static void adaptive_quantization(MpegEncContext *s, double q){
 
         factor*= 1.0 - border_masking*mb_factor;
 
+        if(s->rc_context.mbtree_picture_number == pic->f.display_picture_number)
+            factor*= s->rc_context.mbtree_factor[mb_xy];
+
         if(factor<0.00001) factor= 0.00001;
 
         bits= cplx*factor;
@@ -641,6 +688,78 @@ static void adaptive_quantization(MpegEncContext *s, double q){
     }
 }
 
+void ff_rate_control_mbtree(MpegEncContext *s, RateControlLookahead **la, int nb_pictures){
+    RateControlContext *rcc= &s->rc_context;
+    const int mb_width = s->width  >> 4;
+    const int mb_height= s->height >> 4;
+    const int shift= 1 + s->quarter_sample;
+    /* qscale doubles every 6 steps of the per MB offset
+     * -5 * (1 - qcompress) * log2((intra + propagate) / intra) */
+    const float strength= 5.0 * (1.0 - s->avctx->qcompress) / 6.0;
+    float *propagate    = rcc->mbtree_propagate[0];
+    float *ref_propagate= rcc->mbtree_propagate[1];
+    double cost_sum= 0, factor_sum= 0;
+    int i, mb_x, mb_y;
+
+    memset(propagate, 0, s->mb_stride * s->mb_height * sizeof(float));
+
+    for(i=nb_pictures-1; i>0; i--){
+        memset(ref_propagate, 0, s->mb_stride * s->mb_height * sizeof(float));
+
+        for(mb_y=0; mb_y<mb_height; mb_y++){
+            for(mb_x=0; mb_x<mb_width; mb_x++){
+                const int mb_xy= mb_x + mb_y*s->mb_stride;
+                const int intra= la[i]->intra_cost[mb_xy];
+                const int inter= FFMIN(la[i]->inter_cost[mb_xy], intra);
+                /* the part of the information of this MB which comes from the reference */
+                const float amount= (intra + propagate[mb_xy]) * (intra - inter) / intra;
+                const int x= 16*mb_x + (la[i]->mv[mb_xy][0] >> shift);
+                const int y= 16*mb_y + (la[i]->mv[mb_xy][1] >> shift);
+                const int ref_xy= (x>>4) + (y>>4)*s->mb_stride;
+                const int fx= x&15;
+                const int fy= y&15;
+
+                if(amount <= 0)
+                    continue;
+
+                /* split between the up to 4 MBs the prediction overlaps */
+                ref_propagate[ref_xy]                       += amount * (16-fx)*(16-fy) / 256;
+                if(fx)
+                    ref_propagate[ref_xy + 1]               += amount *     fx *(16-fy) / 256;
+                if(fy)
+                    ref_propagate[ref_xy + s->mb_stride]    += amount * (16-fx)*    fy  / 256;
+                if(fx && fy)
+                    ref_propagate[ref_xy + s->mb_stride + 1]+= amount *     fx *    fy  / 256;
+            }
+        }
+        FFSWAP(float*, propagate, ref_propagate);
+    }
+
+    for(i=0; i<s->mb_stride * s->mb_height; i++)
+        rcc->mbtree_factor[i]= 1.0;
+    for(mb_y=0; mb_y<mb_height; mb_y++){
+        for(mb_x=0; mb_x<mb_width; mb_x++){
+            const int mb_xy= mb_x + mb_y*s->mb_stride;
+            const int intra= la[0]->intra_cost[mb_xy];
+
+            rcc->mbtree_factor[mb_xy]= pow((intra + propagate[mb_xy]) / intra, strength);
+            cost_sum  += intra;
+            factor_sum+= intra * rcc->mbtree_factor[mb_xy];
+        }
+    }
+
+    /* The factors only move bits between the MBs of the picture, its total
+     * is left to the frame level rate control. Otherwise the picture gets
+     * larger whenever its qscale is clipped at qmax. */
+    if(factor_sum > 0){
+        const double norm= cost_sum / factor_sum;
+        for(mb_y=0; mb_y<mb_height; mb_y++)
+            for(mb_x=0; mb_x<mb_width; mb_x++)
+                rcc->mbtree_factor[mb_x + mb_y*s->mb_stride]*= norm;
+    }
+    rcc->mbtree_picture_number= la[0]->picture_number;
+}
+
 void ff_get_2pass_fcode(MpegEncContext *s){
     RateControlContext *rcc= &s->rc_context;
     int picture_number= s->picture_number;
@@ -828,6 +947,9 @@ static int init_pass2(MpegEncContext *s)
     const int filter_size= (int)(a->qblur*4) | 1;
     double expected_bits;
     double *qscale, *blurred_qscale, qscale_sum;
+    double last_qscale_for[5];
+    int last_non_b_pict_type= rcc->last_non_b_pict_type;
+    double start_buffer_index= 0;
 
     /* find complexity & const_bits & decide the pict_types */
     for(i=0; i<rcc->num_entries; i++){
@@ -852,12 +974,18 @@ static int init_pass2(MpegEncContext *s)
     qscale= av_malloc(sizeof(double)*rcc->num_entries);
     blurred_qscale= av_malloc(sizeof(double)*rcc->num_entries);
     toobig = 0;
+    memcpy(last_qscale_for, rcc->last_qscale_for, sizeof(last_qscale_for));
 
     for(step=256*256; step>0.0000001; step*=0.5){
         expected_bits=0;
         rate_factor+= step;
 
         rcc->buffer_index= s->avctx->rc_buffer_size/2;
+        /* the I/B and max_qdiff limits depend on the previous pictures,
+         * start every iteration from the same state so that the expected
+         * bits only depend on rate_factor */
+        memcpy(rcc->last_qscale_for, last_qscale_for, sizeof(last_qscale_for));
+        rcc->last_non_b_pict_type= last_non_b_pict_type;
 
         /* find qscale */
         for(i=0; i<rcc->num_entries; i++){
@@ -896,6 +1024,8 @@ static int init_pass2(MpegEncContext *s)
         for(i=0; i<rcc->num_entries; i++){
             RateControlEntry *rce= &rcc->entry[i];
             double bits;
+            if(i == s->rc_stats_offset)
+                start_buffer_index= rcc->buffer_index;
             rce->new_qscale= modify_qscale(s, rce, blurred_qscale[i], i);
             bits= qp2bits(rce, rce->new_qscale) + rce->mv_bits + rce->misc_bits;
 //printf("%d %f\n", rce->new_bits, blurred_qscale[i]);
@@ -948,5 +1078,19 @@ static int init_pass2(MpegEncContext *s)
         return -1;
     }
 
+    /* The bits were distributed over the whole analyzed file. Keep the part
+     * of the segment we encode, count its bits from zero and start with the
+     * VBV fullness the whole file encode would have at its first picture. */
+    if(s->rc_stats_offset){
+        uint64_t start_bits;
+
+        rcc->num_entries -= s->rc_stats_offset;
+        memmove(rcc->entry, rcc->entry + s->rc_stats_offset, rcc->num_entries*sizeof(RateControlEntry));
+        start_bits= rcc->entry[0].expected_bits;
+        for(i=0; i<rcc->num_entries; i++)
+            rcc->entry[i].expected_bits -= start_bits;
+        rcc->buffer_index= start_buffer_index;
+    }
+
     return 0;
 }
@@ -57,6 +57,18 @@ typedef struct RateControlEntry{
     int b_code;
 }RateControlEntry;
 
+/**
+ * Lookahead analysis of one input picture, used by ff_rate_control_mbtree().
+ */
+typedef struct RateControlLookahead{
+    int picture_number;           ///< display_picture_number of the analyzed picture, -1 if unused
+    int has_inter;                ///< inter_cost and mv are valid
+    int *intra_cost;              ///< intra cost of each MB
+    int *inter_cost;              ///< cost of each MB predicted from the previous input picture
+    int16_t (*mv_base)[2];
+    int16_t (*mv)[2];             ///< motion vector of each MB, same layout and units as p_mv_table
+}RateControlLookahead;
+
 /**
  * rate control context.
  */
@@ -85,6 +97,13 @@ typedef struct RateControlContext{
     float dry_run_qscale;         ///< for xvid rc
     int last_picture_number;      ///< for xvid rc
     AVExpr * rc_eq_eval;
+
+    /* macroblock-tree */
+    RateControlLookahead *lookahead; ///< analysis of the most recent input pictures
+    int nb_lookahead;
+    float *mbtree_propagate[2];   ///< cost propagated to the MBs of two consecutive pictures
+    float *mbtree_factor;         ///< qscale divisor of each MB of picture mbtree_picture_number
+    int mbtree_picture_number;    ///< display_picture_number mbtree_factor applies to, -1 if none
 }RateControlContext;
 
 struct MpegEncContext;
@@ -97,6 +116,16 @@ void ff_rate_control_uninit(struct MpegEncContext *s);
 int ff_vbv_update(struct MpegEncContext *s, int frame_size);
 void ff_get_2pass_fcode(struct MpegEncContext *s);
 
+/**
+ * Propagate the lookahead costs of the pictures following a reference
+ * picture back to it and derive the qscale of each of its MBs, which
+ * adaptive quantization applies when the picture is encoded.
+ * @param la          lookahead analysis of the reference picture followed
+ *                    by the pictures predicted from it, in display order
+ * @param nb_pictures number of entries in la
+ */
+void ff_rate_control_mbtree(struct MpegEncContext *s, RateControlLookahead **la, int nb_pictures);
+
 int ff_xvid_rate_control_init(struct MpegEncContext *s);
 void ff_xvid_rate_control_uninit(struct MpegEncContext *s);
 float ff_xvid_rate_estimate_qscale(struct MpegEncContext *s, int dry_run);
@@ -108,6 +108,40 @@ int ff_thread_get_buffer(AVCodecContext *avctx, AVFrame *f);
  */
 void ff_thread_release_buffer(AVCodecContext *avctx, AVFrame *f);
 
+/**
+ * Progress counter shared by the jobs of one execute() call, for
+ * pipelining stages of the same picture, e.g. a loop filter running
+ * behind reconstruction.
+ */
+typedef struct ThreadProgress ThreadProgress;
+
+/**
+ * Allocate a progress counter set to 0.
+ *
+ * @return the counter, or NULL if jobs cannot wait on each other
+ * in this build
+ */
+ThreadProgress *ff_thread_progress_alloc(void);
+
+/**
+ * Free a progress counter and set *p to NULL.
+ */
+void ff_thread_progress_free(ThreadProgress **p);
+
+/**
+ * Set the counter and wake up the jobs waiting on it.
+ * Unlike ff_thread_report_progress() the value may also go back,
+ * which must only be done while nobody is waiting.
+ */
+void ff_thread_progress_set(ThreadProgress *p, int n);
+
+/**
+ * Wait until the counter is at least n.
+ *
+ * @return the current value of the counter
+ */
+int ff_thread_progress_wait(ThreadProgress *p, int n);
+
 int ff_thread_init(AVCodecContext *s);
 void ff_thread_free(AVCodecContext *s);
 
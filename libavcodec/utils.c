@@ -863,21 +863,8 @@ void avsubtitle_free(AVSubtitle *sub)
     memset(sub, 0, sizeof(AVSubtitle));
 }
 
-av_cold int avcodec_close(AVCodecContext *avctx)
+av_cold void ff_codec_close_nested(AVCodecContext *avctx)
 {
-    /* If there is a user-supplied mutex locking routine, call it. */
-    if (ff_lockmgr_cb) {
-        if ((*ff_lockmgr_cb)(&codec_mutex, AV_LOCK_OBTAIN))
-            return -1;
-    }
-
-    entangled_thread_counter++;
-    if(entangled_thread_counter != 1){
-        av_log(avctx, AV_LOG_ERROR, "insufficient thread locking around avcodec_open/close()\n");
-        entangled_thread_counter--;
-        return -1;
-    }
-
     if (HAVE_THREADS && avctx->thread_opaque)
         ff_thread_free(avctx);
     if (avctx->codec && avctx->codec->close)
@@ -892,6 +879,24 @@ av_cold int avcodec_close(AVCodecContext *avctx)
         av_freep(&avctx->extradata);
     avctx->codec = NULL;
     avctx->active_thread_type = 0;
+}
+
+av_cold int avcodec_close(AVCodecContext *avctx)
+{
+    /* If there is a user-supplied mutex locking routine, call it. */
+    if (ff_lockmgr_cb) {
+        if ((*ff_lockmgr_cb)(&codec_mutex, AV_LOCK_OBTAIN))
+            return -1;
+    }
+
+    entangled_thread_counter++;
+    if(entangled_thread_counter != 1){
+        av_log(avctx, AV_LOG_ERROR, "insufficient thread locking around avcodec_open/close()\n");
+        entangled_thread_counter--;
+        return -1;
+    }
+
+    ff_codec_close_nested(avctx);
     entangled_thread_counter--;
 
     /* Release any user-supplied mutex. */
@@ -1249,6 +1254,17 @@ int ff_thread_init(AVCodecContext *s){
 }
 #endif
 
+#if !HAVE_PTHREADS
+int avcodec_thread_pool_init(int thread_count)
+{
+    return AVERROR(ENOSYS);
+}
+
+void avcodec_thread_pool_uninit(void)
+{
+}
+#endif
+
 unsigned int av_xiphlacing(unsigned char *s, unsigned int v)
 {
     unsigned int n = 0;
@@ -1371,6 +1387,24 @@ void ff_thread_await_progress(AVFrame *f, int progress, int field)
 {
 }
 
+ThreadProgress *ff_thread_progress_alloc(void)
+{
+    return NULL;
+}
+
+void ff_thread_progress_free(ThreadProgress **p)
+{
+}
+
+void ff_thread_progress_set(ThreadProgress *p, int n)
+{
+}
+
+int ff_thread_progress_wait(ThreadProgress *p, int n)
+{
+    return INT_MAX;
+}
+
 #endif
 
 #if FF_API_THREAD_INIT
@@ -0,0 +1,145 @@
+/*
+ * SIMD optimized AAC encoder DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/aacencdsp.h"
+
+DECLARE_ALIGNED(32, static const uint32_t, abs_mask)[8] = {
+    0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
+    0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff,
+};
+DECLARE_ALIGNED(16, static const double, round_bias)[2] = { 0.4054, 0.4054 };
+
+static void abs_pow34_sse(float *out, const float *in, int size)
+{
+    x86_reg i = -4 * size;
+
+    __asm__ volatile(
+        "movaps         %3, %%xmm2          \n\t"
+        "1:                                 \n\t"
+        "movups   (%2,%0), %%xmm0           \n\t"
+        "andps      %%xmm2, %%xmm0          \n\t"
+        "sqrtps     %%xmm0, %%xmm1          \n\t"
+        "mulps      %%xmm1, %%xmm0          \n\t"
+        "sqrtps     %%xmm0, %%xmm0          \n\t"
+        "movups     %%xmm0, (%1,%0)         \n\t"
+        "add           $16, %0              \n\t"
+        "jl 1b                              \n\t"
+        :"+&r"(i)
+        :"r"(out + size), "r"(in + size), "m"(*abs_mask)
+        :"memory"
+         XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")
+    );
+}
+
+#if HAVE_AVX
+static void abs_pow34_avx(float *out, const float *in, int size)
+{
+    int len = size & ~7;
+    x86_reg i = -4 * len;
+
+    if (len) {
+        __asm__ volatile(
+            "vmovaps          %3, %%ymm2                \n\t"
+            "1:                                         \n\t"
+            "vandps     (%2,%0), %%ymm2, %%ymm0         \n\t"
+            "vsqrtps     %%ymm0, %%ymm1                 \n\t"
+            "vmulps      %%ymm1, %%ymm0, %%ymm0         \n\t"
+            "vsqrtps     %%ymm0, %%ymm0                 \n\t"
+            "vmovups     %%ymm0, (%1,%0)                \n\t"
+            "add            $32, %0                     \n\t"
+            "jl 1b                                      \n\t"
+            "vzeroupper                                 \n\t"
+            :"+&r"(i)
+            :"r"(out + len), "r"(in + len), "m"(*abs_mask)
+            :"memory"
+             XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")
+        );
+    }
+    if (len < size)
+        abs_pow34_sse(out + len, in + len, size - len);
+}
+#endif /* HAVE_AVX */
+
+/* The products are rounded to float as in C and then widened, so that
+ * bias, clipping and truncation happen in double precision as well. */
+static void quant_bands_sse2(int *out, const float *in, const float *scaled,
+                             int size, float Q34, int is_signed, int maxval)
+{
+    double maxval_d = maxval;
+    x86_reg i = -4 * size;
+
+    __asm__ volatile(
+        "movss          %4, %%xmm7          \n\t"
+        "shufps $0, %%xmm7, %%xmm7          \n\t"
+        "movsd          %5, %%xmm5          \n\t"
+        "unpcklpd   %%xmm5, %%xmm5          \n\t"
+        "movapd         %6, %%xmm6          \n\t"
+        "1:                                 \n\t"
+        "movups   (%3,%0), %%xmm0           \n\t"
+        "mulps      %%xmm7, %%xmm0          \n\t"
+        "cvtps2pd   %%xmm0, %%xmm1          \n\t"
+        "movhlps    %%xmm0, %%xmm0          \n\t"
+        "cvtps2pd   %%xmm0, %%xmm2          \n\t"
+        "addpd      %%xmm6, %%xmm1          \n\t"
+        "addpd      %%xmm6, %%xmm2          \n\t"
+        "minpd      %%xmm5, %%xmm1          \n\t"
+        "minpd      %%xmm5, %%xmm2          \n\t"
+        "cvttpd2dq  %%xmm1, %%xmm1          \n\t"
+        "cvttpd2dq  %%xmm2, %%xmm2          \n\t"
+        "punpcklqdq %%xmm2, %%xmm1          \n\t"
+        "test           %7, %7              \n\t"
+        "jz 2f                              \n\t"
+        "movups   (%2,%0), %%xmm3           \n\t"
+        "xorps      %%xmm4, %%xmm4          \n\t"
+        "cmpltps    %%xmm4, %%xmm3          \n\t"
+        "pxor       %%xmm3, %%xmm1          \n\t"
+        "psubd      %%xmm3, %%xmm1          \n\t"
+        "2:                                 \n\t"
+        "movdqu     %%xmm1, (%1,%0)         \n\t"
+        "add           $16, %0              \n\t"
+        "jl 1b                              \n\t"
+        :"+&r"(i)
+        :"r"(out + size), "r"(in + size), "r"(scaled + size),
+         "m"(Q34), "m"(maxval_d), "m"(*round_bias), "r"(is_signed)
+        :"memory"
+         XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                        "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+    );
+}
+
+av_cold void ff_aacencdsp_init_x86(AACEncDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE) {
+        c->abs_pow34   = abs_pow34_sse;
+    }
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        c->quant_bands = quant_bands_sse2;
+    }
+#if HAVE_AVX
+    if (mm_flags & AV_CPU_FLAG_AVX) {
+        c->abs_pow34   = abs_pow34_avx;
+    }
+#endif
+}
@@ -23,11 +23,52 @@
 
 #include "libavcodec/cabac.h"
 #include "libavutil/attributes.h"
+#include "libavutil/avutil.h"
 #include "libavutil/x86_cpu.h"
 #include "config.h"
 
+#ifdef BROKEN_RELOCATIONS
+/* The tables cannot be addressed absolutely, pass their address in a
+ * register, with the indexes sign extended to 64 bits. */
+#define TABLES_ARG , "r"(tables)
+#define CABAC_TABLE(off, tables, index, indexq) AV_STRINGIFY(off)"("tables", "indexq")"
+#define LOAD_LPS_RANGE(state, range, tables)                             \
+        "lea    ("state", "range", 2), %%ecx                           \n\t"\
+        "movzbl "CABAC_TABLE(H264_LPS_RANGE_OFFSET, tables, , "%%rcx")", "range"\n\t"
+
+#if HAVE_FAST_CMOV
+#define BRANCHLESS_GET_CABAC_UPDATE(ret, retq, low, range, tmp)\
+        "mov    "tmp"       , %%ecx     \n\t"\
+        "shl    $17         , "tmp"     \n\t"\
+        "cmp    "low"       , "tmp"     \n\t"\
+        "cmova  %%ecx       , "range"   \n\t"\
+        "sbb    %%rcx       , %%rcx     \n\t"\
+        "and    %%ecx       , "tmp"     \n\t"\
+        "xor    %%rcx       , "retq"    \n\t"\
+        "sub    "tmp"       , "low"     \n\t"
+#else /* HAVE_FAST_CMOV */
+#define BRANCHLESS_GET_CABAC_UPDATE(ret, retq, low, range, tmp)\
+        "mov    "tmp"       , %%ecx     \n\t"\
+        "shl    $17         , "tmp"     \n\t"\
+        "sub    "low"       , "tmp"     \n\t"\
+        "sar    $31         , "tmp"     \n\t" /*lps_mask*/\
+        "sub    %%ecx       , "range"   \n\t" /*RangeLPS - range*/\
+        "and    "tmp"       , "range"   \n\t" /*(RangeLPS - range)&lps_mask*/\
+        "add    %%ecx       , "range"   \n\t" /*new range*/\
+        "shl    $17         , %%ecx     \n\t"\
+        "and    "tmp"       , %%ecx     \n\t"\
+        "sub    %%ecx       , "low"     \n\t"\
+        "xor    "tmp"       , "ret"     \n\t"\
+        "movslq "ret"       , "retq"    \n\t"
+#endif /* HAVE_FAST_CMOV */
+#else /* BROKEN_RELOCATIONS */
+#define TABLES_ARG
+#define CABAC_TABLE(off, tables, index, indexq) MANGLE(ff_h264_cabac_tables)"+"AV_STRINGIFY(off)"("index")"
+#define LOAD_LPS_RANGE(state, range, tables)                             \
+        "movzbl "MANGLE(ff_h264_cabac_tables)"+"AV_STRINGIFY(H264_LPS_RANGE_OFFSET)"("state", "range", 2), "range"\n\t"
+
 #if HAVE_FAST_CMOV
-#define BRANCHLESS_GET_CABAC_UPDATE(ret, cabac, statep, low, lowword, range, tmp)\
+#define BRANCHLESS_GET_CABAC_UPDATE(ret, retq, low, range, tmp)\
         "mov    "tmp"       , %%ecx     \n\t"\
         "shl    $17         , "tmp"     \n\t"\
         "cmp    "low"       , "tmp"     \n\t"\
@@ -37,7 +78,7 @@
         "xor    %%ecx       , "ret"     \n\t"\
         "sub    "tmp"       , "low"     \n\t"
 #else /* HAVE_FAST_CMOV */
-#define BRANCHLESS_GET_CABAC_UPDATE(ret, cabac, statep, low, lowword, range, tmp)\
+#define BRANCHLESS_GET_CABAC_UPDATE(ret, retq, low, range, tmp)\
         "mov    "tmp"       , %%ecx     \n\t"\
         "shl    $17         , "tmp"     \n\t"\
         "sub    "low"       , "tmp"     \n\t"\
@@ -50,18 +91,18 @@
         "sub    %%ecx       , "low"     \n\t"\
         "xor    "tmp"       , "ret"     \n\t"
 #endif /* HAVE_FAST_CMOV */
+#endif /* BROKEN_RELOCATIONS */
 
-#define BRANCHLESS_GET_CABAC(ret, cabac, statep, low, lowword, range, tmp, tmpbyte, byte) \
+#define BRANCHLESS_GET_CABAC(ret, retq, cabac, statep, low, lowword, range, rangeq, tmp, tmpbyte, byte, tables) \
         "movzbl "statep"    , "ret"                                     \n\t"\
         "mov    "range"     , "tmp"                                     \n\t"\
         "and    $0xC0       , "range"                                   \n\t"\
-        "movzbl "MANGLE(ff_h264_lps_range)"("ret", "range", 2), "range" \n\t"\
+        LOAD_LPS_RANGE(ret, range, tables)                                   \
         "sub    "range"     , "tmp"                                     \n\t"\
-        BRANCHLESS_GET_CABAC_UPDATE(ret, cabac, statep, low, lowword,        \
-                                    range, tmp)                              \
-        "movzbl " MANGLE(ff_h264_norm_shift) "("range"), %%ecx          \n\t"\
+        BRANCHLESS_GET_CABAC_UPDATE(ret, retq, low, range, tmp)              \
+        "movzbl "CABAC_TABLE(H264_NORM_SHIFT_OFFSET, tables, range, rangeq)", %%ecx\n\t"\
         "shl    %%cl        , "range"                                   \n\t"\
-        "movzbl "MANGLE(ff_h264_mlps_state)"+128("ret"), "tmp"          \n\t"\
+        "movzbl "CABAC_TABLE(H264_MLPS_STATE_OFFSET+128, tables, ret, retq)", "tmp"\n\t"\
         "shl    %%cl        , "low"                                     \n\t"\
         "mov    "tmpbyte"   , "statep"                                  \n\t"\
         "test   "lowword"   , "lowword"                                 \n\t"\
@@ -74,7 +115,7 @@
         "shr    $15         , %%ecx                                     \n\t"\
         "bswap  "tmp"                                                   \n\t"\
         "shr    $15         , "tmp"                                     \n\t"\
-        "movzbl " MANGLE(ff_h264_norm_shift) "(%%ecx), %%ecx            \n\t"\
+        "movzbl "CABAC_TABLE(H264_NORM_SHIFT_OFFSET, tables, "%%ecx", "%%rcx")", %%ecx\n\t"\
         "sub    $0xFFFF     , "tmp"                                     \n\t"\
         "neg    %%ecx                                                   \n\t"\
         "add    $7          , %%ecx                                     \n\t"\
@@ -82,18 +123,21 @@
         "add    "tmp"       , "low"                                     \n\t"\
         "1:                                                             \n\t"
 
-#if ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS)
+#if ARCH_X86 && HAVE_7REGS
 #define get_cabac_inline get_cabac_inline_x86
 static av_always_inline int get_cabac_inline_x86(CABACContext *c,
                                                  uint8_t *const state)
 {
     int bit, low, range, tmp;
+#ifdef BROKEN_RELOCATIONS
+    const uint8_t *tables = ff_h264_cabac_tables;
+#endif
 
     __asm__ volatile(
         "movl %a6(%5), %2               \n\t"
         "movl %a7(%5), %1               \n\t"
-        BRANCHLESS_GET_CABAC("%0", "%5", "(%4)", "%1", "%w1", "%2",
-                             "%3", "%b3", "%a8")
+        BRANCHLESS_GET_CABAC("%0", "%q0", "%5", "(%4)", "%1", "%w1", "%2", "%q2",
+                             "%3", "%b3", "%a8", "%9")
         "movl %2, %a6(%5)               \n\t"
         "movl %1, %a7(%5)               \n\t"
 
@@ -101,11 +145,12 @@ static av_always_inline int get_cabac_inline_x86(CABACContext *c,
         :"r"(state), "r"(c),
          "i"(offsetof(CABACContext, range)), "i"(offsetof(CABACContext, low)),
          "i"(offsetof(CABACContext, bytestream))
+         TABLES_ARG
         : "%"REG_c, "memory"
     );
     return bit & 1;
 }
-#endif /* ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS) */
+#endif /* ARCH_X86 && HAVE_7REGS */
 
 #define get_cabac_bypass_sign get_cabac_bypass_sign_x86
 static av_always_inline int get_cabac_bypass_sign_x86(CABACContext *c, int val)
@@ -144,4 +189,41 @@ static av_always_inline int get_cabac_bypass_sign_x86(CABACContext *c, int val)
     return val;
 }
 
+#define get_cabac_bypass get_cabac_bypass_x86
+static av_always_inline int get_cabac_bypass_x86(CABACContext *c)
+{
+    x86_reg tmp;
+    int res;
+    __asm__ volatile(
+        "movl %a3(%2), %k1                      \n\t"
+        "movl %a4(%2), %%eax                    \n\t"
+        "shl $17, %k1                           \n\t"
+        "add %%eax, %%eax                       \n\t"
+        "sub %k1, %%eax                         \n\t"
+        "cltd                                   \n\t"
+        "and %%edx, %k1                         \n\t"
+        "add %k1, %%eax                         \n\t"
+        "inc %%edx                              \n\t"
+        "test %%ax, %%ax                        \n\t"
+        " jnz 1f                                \n\t"
+        "mov  %a5(%2), %1                       \n\t"
+        "subl $0xFFFF, %%eax                    \n\t"
+        "movzwl (%1), %%ecx                     \n\t"
+        "bswap %%ecx                            \n\t"
+        "shrl $15, %%ecx                        \n\t"
+        "add  $2, %1                            \n\t"
+        "addl %%ecx, %%eax                      \n\t"
+        "mov  %1, %a5(%2)                       \n\t"
+        "1:                                     \n\t"
+        "movl %%eax, %a4(%2)                    \n\t"
+
+        :"=&d"(res), "=&r"(tmp)
+        :"r"(c),
+         "i"(offsetof(CABACContext, range)), "i"(offsetof(CABACContext, low)),
+         "i"(offsetof(CABACContext, bytestream))
+        : "%eax", "%ecx", "memory"
+    );
+    return res;
+}
+
 #endif /* AVCODEC_X86_CABAC_H */
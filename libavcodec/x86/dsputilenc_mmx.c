@@ -821,6 +821,335 @@ static int vsad16_mmx2(void *v, uint8_t * pix1, uint8_t * pix2, int line_size, i
 }
 #undef SUM
 
+static int vsad_intra16_sse2(void *v, uint8_t * pix, uint8_t * dummy, int line_size, int h) {
+    int tmp;
+
+    assert((h & 1) == 0);
+
+#define SUM(in0, out0) \
+      "movdqu (%0), " #out0 "\n"\
+      "add %2,%0\n"\
+      "psadbw " #out0 ", " #in0 "\n"\
+      "paddw " #in0 ", %%xmm6\n"
+
+  __asm__ volatile (
+      "movl %3,%%ecx\n"
+      "pxor %%xmm6,%%xmm6\n"
+      "movdqu (%0),%%xmm0\n"
+      "add %2,%0\n"
+      "jmp 2f\n"
+      "1:\n"
+
+      SUM(%%xmm1, %%xmm0)
+      "2:\n"
+      SUM(%%xmm0, %%xmm1)
+
+      "subl $2, %%ecx\n"
+      "jnz 1b\n"
+
+      "movhlps %%xmm6, %%xmm0\n"
+      "paddw %%xmm0, %%xmm6\n"
+      "movd %%xmm6,%1\n"
+      : "+r" (pix), "=r"(tmp)
+      : "r" ((x86_reg)line_size) , "m" (h)
+      : "%ecx"
+        XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm6"));
+    return tmp;
+}
+#undef SUM
+
+/* Load a row of pix1 - pix2 as 16 words into out0/out1, xmm7 must be 0. */
+#define LOAD_DIFF(out0, out1) \
+      "movdqu (%0), " #out0 "\n"\
+      "movdqu (%1), %%xmm4\n"\
+      "add %3,%0\n"\
+      "add %3,%1\n"\
+      "movdqa " #out0 ", " #out1 "\n"\
+      "movdqa %%xmm4, %%xmm5\n"\
+      "punpcklbw %%xmm7, " #out0 "\n"\
+      "punpckhbw %%xmm7, " #out1 "\n"\
+      "punpcklbw %%xmm7, %%xmm4\n"\
+      "punpckhbw %%xmm7, %%xmm5\n"\
+      "psubw %%xmm4, " #out0 "\n"\
+      "psubw %%xmm5, " #out1 "\n"
+
+/* unlike vsad16_mmx2() this is exact, the differences are taken on words */
+static int vsad16_sse2(void *v, uint8_t * pix1, uint8_t * pix2, int line_size, int h) {
+    int tmp;
+
+    assert((h & 1) == 0);
+
+#define SUM(in0, in1, out0, out1) \
+      LOAD_DIFF(out0, out1)\
+      "psubw " #out0 ", " #in0 "\n"\
+      "psubw " #out1 ", " #in1 "\n"\
+      "pxor %%xmm4, %%xmm4\n"\
+      "pxor %%xmm5, %%xmm5\n"\
+      "psubw " #in0 ", %%xmm4\n"\
+      "psubw " #in1 ", %%xmm5\n"\
+      "pmaxsw %%xmm4, " #in0 "\n"\
+      "pmaxsw %%xmm5, " #in1 "\n"\
+      "paddw " #in1 ", " #in0 "\n"\
+      "paddw " #in0 ", %%xmm6\n"
+
+  __asm__ volatile (
+      "movl %4,%%ecx\n"
+      "pxor %%xmm6,%%xmm6\n"
+      "pxor %%xmm7,%%xmm7\n"
+      LOAD_DIFF(%%xmm0, %%xmm1)
+      "jmp 2f\n"
+      "1:\n"
+
+      SUM(%%xmm2, %%xmm3, %%xmm0, %%xmm1)
+      "2:\n"
+      SUM(%%xmm0, %%xmm1, %%xmm2, %%xmm3)
+
+      "subl $2, %%ecx\n"
+      "jnz 1b\n"
+
+      "movdqa %%xmm6, %%xmm0\n"
+      "punpcklwd %%xmm7, %%xmm6\n"
+      "punpckhwd %%xmm7, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "movhlps %%xmm6, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "pshuflw $0x4E, %%xmm6, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "movd %%xmm6,%2\n"
+      : "+r" (pix1), "+r" (pix2), "=r"(tmp)
+      : "r" ((x86_reg)line_size) , "m" (h)
+      : "%ecx"
+        XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7"));
+    return tmp;
+}
+#undef SUM
+
+static int vsse16_sse2(void *v, uint8_t * pix1, uint8_t * pix2, int line_size, int h) {
+    int tmp;
+
+    assert((h & 1) == 0);
+
+#define SUM(in0, in1, out0, out1) \
+      LOAD_DIFF(out0, out1)\
+      "psubw " #out0 ", " #in0 "\n"\
+      "psubw " #out1 ", " #in1 "\n"\
+      "pmaddwd " #in0 ", " #in0 "\n"\
+      "pmaddwd " #in1 ", " #in1 "\n"\
+      "paddd " #in1 ", " #in0 "\n"\
+      "paddd " #in0 ", %%xmm6\n"
+
+  __asm__ volatile (
+      "movl %4,%%ecx\n"
+      "pxor %%xmm6,%%xmm6\n"
+      "pxor %%xmm7,%%xmm7\n"
+      LOAD_DIFF(%%xmm0, %%xmm1)
+      "jmp 2f\n"
+      "1:\n"
+
+      SUM(%%xmm2, %%xmm3, %%xmm0, %%xmm1)
+      "2:\n"
+      SUM(%%xmm0, %%xmm1, %%xmm2, %%xmm3)
+
+      "subl $2, %%ecx\n"
+      "jnz 1b\n"
+
+      "movhlps %%xmm6, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "pshuflw $0x4E, %%xmm6, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "movd %%xmm6,%2\n"
+      : "+r" (pix1), "+r" (pix2), "=r"(tmp)
+      : "r" ((x86_reg)line_size) , "m" (h)
+      : "%ecx"
+        XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7"));
+    return tmp;
+}
+#undef SUM
+#undef LOAD_DIFF
+
+static int vsse_intra16_sse2(void *v, uint8_t * pix, uint8_t * dummy, int line_size, int h) {
+    int tmp;
+
+    assert((h & 1) == 0);
+
+#define LOAD(out0, out1) \
+      "movdqu (%0), " #out0 "\n"\
+      "add %2,%0\n"\
+      "movdqa " #out0 ", " #out1 "\n"\
+      "punpcklbw %%xmm7, " #out0 "\n"\
+      "punpckhbw %%xmm7, " #out1 "\n"
+
+#define SUM(in0, in1, out0, out1) \
+      LOAD(out0, out1)\
+      "psubw " #out0 ", " #in0 "\n"\
+      "psubw " #out1 ", " #in1 "\n"\
+      "pmaddwd " #in0 ", " #in0 "\n"\
+      "pmaddwd " #in1 ", " #in1 "\n"\
+      "paddd " #in1 ", " #in0 "\n"\
+      "paddd " #in0 ", %%xmm6\n"
+
+  __asm__ volatile (
+      "movl %3,%%ecx\n"
+      "pxor %%xmm6,%%xmm6\n"
+      "pxor %%xmm7,%%xmm7\n"
+      LOAD(%%xmm0, %%xmm1)
+      "jmp 2f\n"
+      "1:\n"
+
+      SUM(%%xmm2, %%xmm3, %%xmm0, %%xmm1)
+      "2:\n"
+      SUM(%%xmm0, %%xmm1, %%xmm2, %%xmm3)
+
+      "subl $2, %%ecx\n"
+      "jnz 1b\n"
+
+      "movhlps %%xmm6, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "pshuflw $0x4E, %%xmm6, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "movd %%xmm6,%1\n"
+      : "+r" (pix), "=r"(tmp)
+      : "r" ((x86_reg)line_size) , "m" (h)
+      : "%ecx"
+        XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm6", "%xmm7"));
+    return tmp;
+}
+#undef SUM
+#undef LOAD
+
+/* Load the differences of horizontally adjacent pixels of a 16 pixel row as
+ * words, columns 0-7 into out0 and 8-15 into out1, the last one is 0.
+ * xmm7 must be 0. */
+#define LOAD_HDIFF(out0, out1) \
+      "movdqu (%0), " #out0 "\n"\
+      "add %2,%0\n"\
+      "movdqa " #out0 ", " #out1 "\n"\
+      "pslldq $1, " #out0 "\n"\
+      "psrldq $1, " #out0 "\n"\
+      "psrldq $1, " #out1 "\n"\
+      "movdqa " #out0 ", %%xmm2\n"\
+      "movdqa " #out1 ", %%xmm3\n"\
+      "punpcklbw %%xmm7, " #out0 "\n"\
+      "punpcklbw %%xmm7, " #out1 "\n"\
+      "punpckhbw %%xmm7, %%xmm2\n"\
+      "punpckhbw %%xmm7, %%xmm3\n"\
+      "psubw " #out1 ", " #out0 "\n"\
+      "psubw %%xmm3, %%xmm2\n"\
+      "movdqa %%xmm2, " #out1 "\n"
+
+/* Same for an 8 pixel row, into out. */
+#define LOAD_HDIFF8(out) \
+      "movq (%0), " #out "\n"\
+      "add %2,%0\n"\
+      "punpcklbw %%xmm7, " #out "\n"\
+      "movdqa " #out ", %%xmm2\n"\
+      "pslldq $2, " #out "\n"\
+      "psrldq $2, " #out "\n"\
+      "psrldq $2, %%xmm2\n"\
+      "psubw %%xmm2, " #out "\n"
+
+/* Add the absolute values of the words of in to xmm6. */
+#define ABS_SUM(in, tmp) \
+      "pxor " #tmp ", " #tmp "\n"\
+      "pcmpgtw " #in ", " #tmp "\n"\
+      "pxor " #tmp ", " #in "\n"\
+      "psubw " #tmp ", " #in "\n"\
+      "paddw " #in ", %%xmm6\n"
+
+/* Add the words of xmm6 and store the sum in out. */
+#define HSUM_WORDS(out) \
+      "pcmpeqw %%xmm0, %%xmm0\n"\
+      "psrlw $15, %%xmm0\n"\
+      "pmaddwd %%xmm0, %%xmm6\n"\
+      "movhlps %%xmm6, %%xmm0\n"\
+      "paddd %%xmm0, %%xmm6\n"\
+      "pshuflw $0x4E, %%xmm6, %%xmm0\n"\
+      "paddd %%xmm0, %%xmm6\n"\
+      "movd %%xmm6, " #out "\n"
+
+static int hf_noise16_sse2(uint8_t * pix, int line_size, int h) {
+    int tmp;
+
+    assert(h >= 2);
+
+  __asm__ volatile (
+      "movl %3,%%ecx\n"
+      "pxor %%xmm7,%%xmm7\n"
+      "pxor %%xmm6,%%xmm6\n"
+      LOAD_HDIFF(%%xmm4, %%xmm5)
+      "1:\n"
+      LOAD_HDIFF(%%xmm0, %%xmm1)
+      "psubw %%xmm0, %%xmm4\n"
+      "psubw %%xmm1, %%xmm5\n"
+      ABS_SUM(%%xmm4, %%xmm2)
+      ABS_SUM(%%xmm5, %%xmm3)
+      "movdqa %%xmm0, %%xmm4\n"
+      "movdqa %%xmm1, %%xmm5\n"
+      "decl %%ecx\n"
+      "jnz 1b\n"
+      HSUM_WORDS(%1)
+      : "+r" (pix), "=r"(tmp)
+      : "r" ((x86_reg)line_size) , "g" (h-1)
+      : "%ecx"
+        XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7"));
+    return tmp;
+}
+
+static int hf_noise8_sse2(uint8_t * pix, int line_size, int h) {
+    int tmp;
+
+    assert(h >= 2);
+
+  __asm__ volatile (
+      "movl %3,%%ecx\n"
+      "pxor %%xmm7,%%xmm7\n"
+      "pxor %%xmm6,%%xmm6\n"
+      LOAD_HDIFF8(%%xmm4)
+      "1:\n"
+      LOAD_HDIFF8(%%xmm1)
+      "psubw %%xmm1, %%xmm4\n"
+      ABS_SUM(%%xmm4, %%xmm3)
+      "movdqa %%xmm1, %%xmm4\n"
+      "decl %%ecx\n"
+      "jnz 1b\n"
+      HSUM_WORDS(%1)
+      : "+r" (pix), "=r"(tmp)
+      : "r" ((x86_reg)line_size) , "g" (h-1)
+      : "%ecx"
+        XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm6", "%xmm7"));
+    return tmp;
+}
+#undef LOAD_HDIFF
+#undef LOAD_HDIFF8
+#undef ABS_SUM
+#undef HSUM_WORDS
+
+static int nsse16_sse2(void *p, uint8_t * pix1, uint8_t * pix2, int line_size, int h) {
+    MpegEncContext *c = p;
+    int score1, score2;
+
+    if(c) score1 = c->dsp.sse[0](c, pix1, pix2, line_size, h);
+    else  score1 = sse16_mmx(c, pix1, pix2, line_size, h);
+    score2= hf_noise16_sse2(pix1, line_size, h) - hf_noise16_sse2(pix2, line_size, h);
+
+    if(c) return score1 + FFABS(score2)*c->avctx->nsse_weight;
+    else  return score1 + FFABS(score2)*8;
+}
+
+static int nsse8_sse2(void *p, uint8_t * pix1, uint8_t * pix2, int line_size, int h) {
+    MpegEncContext *c = p;
+    int score1= sse8_mmx(c, pix1, pix2, line_size, h);
+    int score2= hf_noise8_sse2(pix1, line_size, h) - hf_noise8_sse2(pix2, line_size, h);
+
+    if(c) return score1 + FFABS(score2)*c->avctx->nsse_weight;
+    else  return score1 + FFABS(score2)*8;
+}
+
 static void diff_bytes_mmx(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w){
     x86_reg i=0;
     __asm__ volatile(
@@ -1168,6 +1497,14 @@ void dsputilenc_init_mmx(DSPContext* c, AVCodecContext *avctx)
             c->hadamard8_diff[0]= ff_hadamard8_diff16_sse2;
             c->hadamard8_diff[1]= ff_hadamard8_diff_sse2;
 #endif
+            c->vsad[0]= vsad16_sse2;
+            c->vsad[4]= vsad_intra16_sse2;
+            c->vsse[0]= vsse16_sse2;
+            c->vsse[4]= vsse_intra16_sse2;
+            c->nsse[0]= nsse16_sse2;
+            c->nsse[1]= nsse8_sse2;
+            /* dct_sad and dct_max need no versions of their own, the C ones
+             * spend their time in diff_pixels, fdct and sum_abs_dctelem */
         }
 
 #if HAVE_SSSE3
@@ -36,7 +36,7 @@
 
 //FIXME use some macros to avoid duplicating get_cabac (cannot be done yet
 //as that would make optimization work hard)
-#if ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS)
+#if ARCH_X86 && HAVE_7REGS
 static int decode_significance_x86(CABACContext *c, int max_coeff,
                                    uint8_t *significant_coeff_ctx_base,
                                    int *index, x86_reg last_off){
@@ -45,18 +45,21 @@ static int decode_significance_x86(CABACContext *c, int max_coeff,
     int minusindex= 4-(intptr_t)index;
     int bit;
     x86_reg coeff_count;
+#ifdef BROKEN_RELOCATIONS
+    const uint8_t *tables = ff_h264_cabac_tables;
+#endif
     __asm__ volatile(
         "2:                                     \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%6", "(%1)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a11")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%6", "(%1)", "%3",
+                             "%w3", "%5", "%q5", "%k0", "%b0", "%a11", "%12")
 
         "test $1, %4                            \n\t"
         " jz 3f                                 \n\t"
         "add  %10, %1                           \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%6", "(%1)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a11")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%6", "(%1)", "%3",
+                             "%w3", "%5", "%q5", "%k0", "%b0", "%a11", "%12")
 
         "sub  %10, %1                           \n\t"
         "mov  %2, %0                            \n\t"
@@ -84,6 +87,7 @@ static int decode_significance_x86(CABACContext *c, int max_coeff,
          "+&r"(c->low), "=&r"(bit), "+&r"(c->range)
         :"r"(c), "m"(minusstart), "m"(end), "m"(minusindex), "m"(last_off),
          "i"(offsetof(CABACContext, bytestream))
+         TABLES_ARG
         : "%"REG_c, "memory"
     );
     return coeff_count;
@@ -97,6 +101,9 @@ static int decode_significance_8x8_x86(CABACContext *c,
     x86_reg coeff_count;
     x86_reg last=0;
     x86_reg state;
+#ifdef BROKEN_RELOCATIONS
+    const uint8_t *tables = ff_h264_cabac_tables;
+#endif
     __asm__ volatile(
         "mov %1, %6                             \n\t"
         "2:                                     \n\t"
@@ -105,18 +112,18 @@ static int decode_significance_8x8_x86(CABACContext *c,
         "movzbl (%0, %6), %k6                   \n\t"
         "add %9, %6                             \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%7", "(%6)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a12")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%7", "(%6)", "%3",
+                             "%w3", "%5", "%q5", "%k0", "%b0", "%a12", "%13")
 
         "mov %1, %k6                            \n\t"
         "test $1, %4                            \n\t"
         " jz 3f                                 \n\t"
 
-        "movzbl "MANGLE(last_coeff_flag_offset_8x8)"(%k6), %k6\n\t"
+        "movzbl "CABAC_TABLE(H264_LAST_COEFF_FLAG_OFFSET_8x8_OFFSET, "%13", "%k6", "%q6")", %k6\n\t"
         "add %11, %6                            \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%7", "(%6)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a12")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%7", "(%6)", "%3",
+                             "%w3", "%5", "%q5", "%k0", "%b0", "%a12", "%13")
 
         "mov %2, %0                             \n\t"
         "mov %1, %k6                            \n\t"
@@ -141,10 +148,11 @@ static int decode_significance_8x8_x86(CABACContext *c,
          "+&r"(c->range), "=&r"(state)
         :"r"(c), "m"(minusindex), "m"(significant_coeff_ctx_base), "m"(sig_off), "m"(last_coeff_ctx_base),
          "i"(offsetof(CABACContext, bytestream))
+         TABLES_ARG
         : "%"REG_c, "memory"
     );
     return coeff_count;
 }
-#endif /* ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS) */
+#endif /* ARCH_X86 && HAVE_7REGS */
 
 #endif /* AVCODEC_X86_H264_I386_H */
@@ -136,6 +136,63 @@ static void lpc_compute_autocorr_sse2(const double *data, int len, int lag,
     }
 }
 
+static void lpc_compute_residual_sse2(int32_t *res, const int32_t *smp, int len,
+                                      int order, const int32_t *coefs, int shift)
+{
+    DECLARE_ALIGNED(16, int32_t, coefs_splat)[MAX_LPC_ORDER][4];
+    int i, j;
+
+    /* coefficients in sample order, each one repeated across a register */
+    for (j = 0; j < order; j++)
+        coefs_splat[j][0] = coefs_splat[j][1] =
+        coefs_splat[j][2] = coefs_splat[j][3] = coefs[order-1-j];
+
+    for (i = 0; i < order; i++)
+        res[i] = smp[i];
+
+    /* pmuludq gives the low 32 bits of the signed products in the even
+     * lanes, the odd samples are shifted down into them and accumulated
+     * separately */
+    for (; i <= len - 4; i += 4) {
+        x86_reg k = -order*sizeof(int32_t);
+        __asm__ volatile(
+            "movd       %4,        %%xmm7           \n\t"
+            "pxor       %%xmm0,    %%xmm0           \n\t"
+            "pxor       %%xmm1,    %%xmm1           \n\t"
+            "1:                                     \n\t"
+            "movdqu     (%2,%0),   %%xmm2           \n\t"
+            "movdqa     (%3,%0,4), %%xmm3           \n\t"
+            "movdqa     %%xmm2,    %%xmm4           \n\t"
+            "psrlq      $32,       %%xmm4           \n\t"
+            "pmuludq    %%xmm3,    %%xmm2           \n\t"
+            "pmuludq    %%xmm3,    %%xmm4           \n\t"
+            "paddd      %%xmm2,    %%xmm0           \n\t"
+            "paddd      %%xmm4,    %%xmm1           \n\t"
+            "add        $4,        %0               \n\t"
+            "jl 1b                                  \n\t"
+            "pshufd     $0x08,     %%xmm0, %%xmm0   \n\t"
+            "pshufd     $0x08,     %%xmm1, %%xmm1   \n\t"
+            "punpckldq  %%xmm1,    %%xmm0           \n\t"
+            "psrad      %%xmm7,    %%xmm0           \n\t"
+            "movdqu     (%2),      %%xmm2           \n\t"
+            "psubd      %%xmm0,    %%xmm2           \n\t"
+            "movdqu     %%xmm2,    (%1)             \n\t"
+            :"+&r"(k)
+            :"r"(res+i), "r"(smp+i), "r"(coefs_splat+order), "r"(shift)
+            :"memory"
+             XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                            "%xmm4", "%xmm7")
+        );
+    }
+
+    for (; i < len; i++) {
+        int p = 0;
+        for (j = 0; j < order; j++)
+            p += coefs[j] * smp[i-j-1];
+        res[i] = smp[i] - (p >> shift);
+    }
+}
+
 av_cold void ff_lpc_init_x86(LPCContext *c)
 {
     int mm_flags = av_get_cpu_flags();
@@ -143,5 +200,6 @@ av_cold void ff_lpc_init_x86(LPCContext *c)
     if (mm_flags & (AV_CPU_FLAG_SSE2|AV_CPU_FLAG_SSE2SLOW)) {
         c->lpc_apply_welch_window = lpc_apply_welch_window_sse2;
         c->lpc_compute_autocorr   = lpc_compute_autocorr_sse2;
+        c->lpc_compute_residual   = lpc_compute_residual_sse2;
     }
 }
@@ -23,7 +23,7 @@
 #include "libavutil/cpu.h"
 #include "libavutil/x86_cpu.h"
 #include "libavcodec/dsputil.h"
-#include "libavcodec/png.h"
+#include "libavcodec/pngdsp.h"
 #include "dsputil_mmx.h"
 
 //#undef NDEBUG
@@ -128,16 +128,148 @@ PAETH(mmx2, ABS3_MMX2)
 PAETH(ssse3, ABS3_SSSE3)
 #endif
 
-void ff_png_init_mmx(PNGDecContext *s)
+static void sub_avg_prediction_sse2(uint8_t *dst, const uint8_t *src,
+                                    const uint8_t *top, int w, int bpp)
+{
+    x86_reg i = 0;
+    __asm__ volatile(
+        "pcmpeqb   %%xmm6, %%xmm6       \n\t"
+        "pxor      %%xmm7, %%xmm7       \n\t"
+        "psubb     %%xmm6, %%xmm7       \n\t" // pb_1
+        "jmp 2f                         \n\t"
+        "1:                             \n\t"
+        "movdqu  (%2,%0), %%xmm0        \n\t" // src[i]
+        "movdqu  (%3,%0), %%xmm1        \n\t" // src[i - bpp]
+        "movdqu  (%4,%0), %%xmm2        \n\t" // top[i]
+        "movdqa    %%xmm1, %%xmm3       \n\t"
+        "pxor      %%xmm2, %%xmm3       \n\t"
+        "pand      %%xmm7, %%xmm3       \n\t"
+        "pavgb     %%xmm2, %%xmm1       \n\t" // rounds up, remove the carry
+        "psubb     %%xmm3, %%xmm1       \n\t"
+        "psubb     %%xmm1, %%xmm0       \n\t"
+        "movdqu    %%xmm0, (%1,%0)      \n\t"
+        "add          $16, %0           \n\t"
+        "2:                             \n\t"
+        "cmp           %5, %0           \n\t"
+        " jl 1b                         \n\t"
+        : "+r"(i)
+        : "r"(dst), "r"(src), "r"(src - bpp), "r"(top), "g"((x86_reg)w-15)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm6", "%xmm7")
+    );
+    for(; i<w; i++)
+        dst[i] = src[i] - ((src[i - bpp] + top[i]) >> 1);
+}
+
+/* Unlike in the decoder, all predictors are known, so 8 pixels are filtered
+ * at a time whatever bpp is. */
+static void sub_paeth_prediction_sse2(uint8_t *dst, const uint8_t *src,
+                                      const uint8_t *top, int w, int bpp)
+{
+    x86_reg i = 0, j = -bpp;
+    __asm__ volatile(
+        "pxor      %%xmm7, %%xmm7       \n\t"
+        "jmp 2f                         \n\t"
+        "1:                             \n\t"
+        "movq    (%2,%1), %%xmm0        \n\t" // a
+        "movq    (%3,%0), %%xmm1        \n\t" // b
+        "movq    (%3,%1), %%xmm2        \n\t" // c
+        "punpcklbw %%xmm7, %%xmm0       \n\t"
+        "punpcklbw %%xmm7, %%xmm1       \n\t"
+        "punpcklbw %%xmm7, %%xmm2       \n\t"
+        "movdqa    %%xmm1, %%xmm3       \n\t"
+        "psubw     %%xmm2, %%xmm3       \n\t" // b - c
+        "movdqa    %%xmm0, %%xmm4       \n\t"
+        "psubw     %%xmm2, %%xmm4       \n\t" // a - c
+        "movdqa    %%xmm3, %%xmm5       \n\t"
+        "paddw     %%xmm4, %%xmm5       \n\t" // a + b - 2c
+        "pxor      %%xmm6, %%xmm6       \n\t"
+        "psubw     %%xmm3, %%xmm6       \n\t"
+        "pmaxsw    %%xmm6, %%xmm3       \n\t" // pa
+        "pxor      %%xmm6, %%xmm6       \n\t"
+        "psubw     %%xmm4, %%xmm6       \n\t"
+        "pmaxsw    %%xmm6, %%xmm4       \n\t" // pb
+        "pxor      %%xmm6, %%xmm6       \n\t"
+        "psubw     %%xmm5, %%xmm6       \n\t"
+        "pmaxsw    %%xmm6, %%xmm5       \n\t" // pc
+        "movdqa    %%xmm4, %%xmm6       \n\t"
+        "pminsw    %%xmm5, %%xmm6       \n\t"
+        "pcmpgtw   %%xmm5, %%xmm4       \n\t" // pb > pc
+        "pcmpgtw   %%xmm6, %%xmm3       \n\t" // pa > FFMIN(pb, pc)
+        "pxor      %%xmm1, %%xmm2       \n\t"
+        "pand      %%xmm4, %%xmm2       \n\t"
+        "pxor      %%xmm2, %%xmm1       \n\t" // pb > pc ? c : b
+        "pxor      %%xmm0, %%xmm1       \n\t"
+        "pand      %%xmm3, %%xmm1       \n\t"
+        "pxor      %%xmm1, %%xmm0       \n\t" // predictor
+        "packuswb  %%xmm0, %%xmm0       \n\t"
+        "movq    (%2,%0), %%xmm1        \n\t"
+        "psubb     %%xmm0, %%xmm1       \n\t"
+        "movq      %%xmm1, (%4,%0)      \n\t"
+        "add           $8, %0           \n\t"
+        "add           $8, %1           \n\t"
+        "2:                             \n\t"
+        "cmp           %5, %0           \n\t"
+        " jl 1b                         \n\t"
+        : "+r"(i), "+r"(j)
+        : "r"(src), "r"(top), "r"(dst), "g"((x86_reg)w-7)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+    );
+    if (i < w)
+        ff_sub_png_paeth_prediction(dst+i, src+i, top+i, w-i, bpp);
+}
+
+static int filter_cost_sse2(const uint8_t *buf, int w)
+{
+    x86_reg i = 0;
+    int cost;
+    /* psadbw against 0x80 of the bytes with their sign bit flipped sums
+     * their absolute values as int8_t */
+    __asm__ volatile(
+        "pcmpeqb   %%xmm7, %%xmm7       \n\t"
+        "psllw         $7, %%xmm7       \n\t"
+        "packsswb  %%xmm7, %%xmm7       \n\t" // pb_80
+        "pxor      %%xmm6, %%xmm6       \n\t"
+        "jmp 2f                         \n\t"
+        "1:                             \n\t"
+        "movdqu  (%2,%0), %%xmm0        \n\t"
+        "pxor      %%xmm7, %%xmm0       \n\t"
+        "psadbw    %%xmm7, %%xmm0       \n\t"
+        "paddq     %%xmm0, %%xmm6       \n\t"
+        "add          $16, %0           \n\t"
+        "2:                             \n\t"
+        "cmp           %3, %0           \n\t"
+        " jl 1b                         \n\t"
+        "movhlps   %%xmm6, %%xmm0       \n\t"
+        "paddq     %%xmm0, %%xmm6       \n\t"
+        "movd      %%xmm6, %1           \n\t"
+        : "+r"(i), "=r"(cost)
+        : "r"(buf), "g"((x86_reg)w-15)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm6", "%xmm7")
+    );
+    for(; i<w; i++)
+        cost += abs((int8_t)buf[i]);
+    return cost;
+}
+
+void ff_pngdsp_init_x86(PNGDSPContext *c)
 {
     int mm_flags = av_get_cpu_flags();
 
     if (mm_flags & AV_CPU_FLAG_MMX2) {
-        s->add_bytes_l2 = add_bytes_l2_mmx;
-        s->add_paeth_prediction = add_paeth_prediction_mmx2;
+        c->add_bytes_l2 = add_bytes_l2_mmx;
+        c->add_paeth_prediction = add_paeth_prediction_mmx2;
 #if HAVE_SSSE3
         if (mm_flags & AV_CPU_FLAG_SSSE3)
-            s->add_paeth_prediction = add_paeth_prediction_ssse3;
+            c->add_paeth_prediction = add_paeth_prediction_ssse3;
 #endif
     }
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        c->sub_avg_prediction   = sub_avg_prediction_sse2;
+        c->sub_paeth_prediction = sub_paeth_prediction_sse2;
+        c->filter_cost          = filter_cost_sse2;
+    }
 }
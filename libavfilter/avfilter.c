@@ -815,3 +815,26 @@ int avfilter_init_filter(AVFilterContext *filter, const char *args, void *opaque
     return ret;
 }
 
+int ff_filter_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                      void *arg, int *ret, int nb_jobs)
+{
+    int i;
+
+    if (ctx->graph && ctx->graph->execute)
+        return ctx->graph->execute(ctx, func, arg, ret, nb_jobs);
+
+    for (i = 0; i < nb_jobs; i++) {
+        int r = func(ctx, arg, i, nb_jobs);
+        if (ret)
+            ret[i] = r;
+    }
+    return 0;
+}
+
+int ff_filter_get_nb_threads(AVFilterContext *ctx)
+{
+    if (ctx->graph && ctx->graph->execute)
+        return FFMAX(ctx->graph->nb_threads, 1);
+    return 1;
+}
+
@@ -29,8 +29,8 @@
 #include "libavutil/rational.h"
 
 #define LIBAVFILTER_VERSION_MAJOR  2
-#define LIBAVFILTER_VERSION_MINOR 29
-#define LIBAVFILTER_VERSION_MICRO  1
+#define LIBAVFILTER_VERSION_MINOR 30
+#define LIBAVFILTER_VERSION_MICRO  0
 
 #define LIBAVFILTER_VERSION_INT AV_VERSION_INT(LIBAVFILTER_VERSION_MAJOR, \
                                                LIBAVFILTER_VERSION_MINOR, \
@@ -571,8 +571,32 @@ struct AVFilterContext {
     AVFilterLink **outputs;         ///< array of pointers to output links
 
     void *priv;                     ///< private data for use by the filter
+
+    struct AVFilterGraph *graph;    ///< filtergraph this filter belongs to, NULL if none
 };
 
+/**
+ * A function executing one job of a slice threaded filter.
+ *
+ * @param ctx     the filter context the job is executed for
+ * @param arg     the argument passed to the execute function
+ * @param jobnr   index of the job being executed, 0 <= jobnr < nb_jobs
+ * @param nb_jobs total number of jobs
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+typedef int (avfilter_action_func)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+
+/**
+ * A function executing func nb_jobs times, possibly in parallel, and
+ * returning when all the jobs are done.
+ *
+ * @param ret array of nb_jobs elements receiving the return values of
+ *            func, may be NULL
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+typedef int (avfilter_execute_func)(AVFilterContext *ctx, avfilter_action_func *func,
+                                    void *arg, int *ret, int nb_jobs);
+
 enum AVFilterPacking {
     AVFILTER_PACKED = 0,
     AVFILTER_PLANAR,
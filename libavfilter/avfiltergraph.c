@@ -26,6 +26,7 @@
 #include "avfilter.h"
 #include "avfiltergraph.h"
 #include "internal.h"
+#include "thread.h"
 
 AVFilterGraph *avfilter_graph_alloc(void)
 {
@@ -38,6 +39,7 @@ void avfilter_graph_free(AVFilterGraph **graph)
         return;
     for (; (*graph)->filter_count > 0; (*graph)->filter_count--)
         avfilter_free((*graph)->filters[(*graph)->filter_count - 1]);
+    ff_graph_thread_free(*graph);
     av_freep(&(*graph)->scale_sws_opts);
     av_freep(&(*graph)->filters);
     av_freep(graph);
@@ -52,6 +54,7 @@ int avfilter_graph_add_filter(AVFilterGraph *graph, AVFilterContext *filter)
 
     graph->filters = filters;
     graph->filters[graph->filter_count++] = filter;
+    filter->graph = graph;
 
     return 0;
 }
@@ -246,6 +249,9 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 
     if ((ret = ff_avfilter_graph_check_validity(graphctx, log_ctx)))
         return ret;
+    if (!graphctx->execute && graphctx->nb_threads > 1 &&
+        (ret = ff_graph_thread_init(graphctx)) < 0)
+        return ret;
     if ((ret = ff_avfilter_graph_config_formats(graphctx, log_ctx)))
         return ret;
     if ((ret = ff_avfilter_graph_config_links(graphctx, log_ctx)))
@@ -29,6 +29,29 @@ typedef struct AVFilterGraph {
     AVFilterContext **filters;
 
     char *scale_sws_opts; ///< sws options to use for the auto-inserted scale filters
+
+    /**
+     * Maximum number of threads the filters of the graph may use to
+     * process a frame, values <= 1 disable threading.
+     * Must be set before avfilter_graph_config().
+     */
+    int nb_threads;
+
+    /**
+     * Function the filters of the graph use to run their jobs.
+     * If NULL and nb_threads > 1, avfilter_graph_config() sets it to
+     * the internal thread pool implementation. The caller may set it
+     * to its own implementation before that instead, which must start
+     * the jobs in the order of their index, as a job may wait for the
+     * results of the jobs before it.
+     */
+    avfilter_execute_func *execute;
+
+    /**
+     * thread pool used by execute
+     * - set by libavfilter, must not be touched by the caller
+     */
+    void *thread_opaque;
 } AVFilterGraph;
 
 /**
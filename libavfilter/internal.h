@@ -61,4 +61,21 @@ void ff_avfilter_default_free_buffer(AVFilterBuffer *buf);
 /** Tell is a format is contained in the provided list terminated by -1. */
 int ff_fmt_is_in(int fmt, const int *fmts);
 
+/**
+ * Run func for each of nb_jobs jobs, in parallel if the graph of ctx has
+ * threads, and wait for all of them to finish.
+ *
+ * @param ret array of nb_jobs elements receiving the return values of
+ *            func, may be NULL
+ */
+int ff_filter_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                      void *arg, int *ret, int nb_jobs);
+
+/**
+ * Get the number of threads ff_filter_execute() may run jobs of ctx on.
+ * Filters keeping scratch buffers per job should split their work in
+ * this many jobs.
+ */
+int ff_filter_get_nb_threads(AVFilterContext *ctx);
+
 #endif /* AVFILTER_INTERNAL_H */
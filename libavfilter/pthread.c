@@ -0,0 +1,224 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * filtergraph thread pool, works like the slice threads in
+ * libavcodec/pthread.c
+ */
+
+#include <pthread.h>
+
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "avfilter.h"
+#include "avfiltergraph.h"
+#include "thread.h"
+
+typedef struct ThreadContext {
+    pthread_t *workers;
+    int nb_threads;
+    AVFilterContext *ctx;           ///< Filter the current jobs are executed for.
+    avfilter_action_func *func;
+    void *arg;
+    int *rets;
+    int nb_rets;
+    int nb_jobs;
+
+    pthread_cond_t last_job_cond;
+    pthread_cond_t current_job_cond;
+    pthread_mutex_t current_job_lock;
+    int current_job;
+    int done;
+} ThreadContext;
+
+static void* attribute_align_arg worker(void *v)
+{
+    ThreadContext *c = v;
+    int our_job = c->nb_jobs;
+    int nb_threads = c->nb_threads;
+    int self_id;
+
+    pthread_mutex_lock(&c->current_job_lock);
+    self_id = c->current_job++;
+    for (;;) {
+        while (our_job >= c->nb_jobs) {
+            if (c->current_job == nb_threads + c->nb_jobs)
+                pthread_cond_signal(&c->last_job_cond);
+
+            pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
+            our_job = self_id;
+
+            if (c->done) {
+                pthread_mutex_unlock(&c->current_job_lock);
+                return NULL;
+            }
+        }
+        pthread_mutex_unlock(&c->current_job_lock);
+
+        c->rets[our_job % c->nb_rets] = c->func(c->ctx, c->arg, our_job, c->nb_jobs);
+
+        pthread_mutex_lock(&c->current_job_lock);
+        our_job = c->current_job++;
+    }
+}
+
+static void park_workers(ThreadContext *c)
+{
+    pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
+    pthread_mutex_unlock(&c->current_job_lock);
+}
+
+static void thread_pool_free(ThreadContext *c)
+{
+    int i;
+
+    pthread_mutex_lock(&c->current_job_lock);
+    c->done = 1;
+    pthread_cond_broadcast(&c->current_job_cond);
+    pthread_mutex_unlock(&c->current_job_lock);
+
+    for (i = 0; i < c->nb_threads; i++)
+        pthread_join(c->workers[i], NULL);
+
+    pthread_mutex_destroy(&c->current_job_lock);
+    pthread_cond_destroy(&c->current_job_cond);
+    pthread_cond_destroy(&c->last_job_cond);
+    av_free(c->workers);
+    av_free(c);
+}
+
+static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->thread_opaque;
+    int dummy_ret;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    pthread_mutex_lock(&c->current_job_lock);
+
+    c->ctx         = ctx;
+    c->current_job = c->nb_threads;
+    c->nb_jobs     = nb_jobs;
+    c->arg         = arg;
+    c->func        = func;
+    if (ret) {
+        c->rets    = ret;
+        c->nb_rets = nb_jobs;
+    } else {
+        c->rets    = &dummy_ret;
+        c->nb_rets = 1;
+    }
+    pthread_cond_broadcast(&c->current_job_cond);
+
+    park_workers(c);
+
+    return 0;
+}
+
+int ff_graph_thread_init(AVFilterGraph *graph)
+{
+    ThreadContext *c;
+    int i;
+
+    if (graph->nb_threads <= 1)
+        return 0;
+
+    c = av_mallocz(sizeof(ThreadContext));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    c->workers = av_mallocz(sizeof(pthread_t) * graph->nb_threads);
+    if (!c->workers) {
+        av_free(c);
+        return AVERROR(ENOMEM);
+    }
+
+    c->nb_threads = graph->nb_threads;
+    pthread_cond_init(&c->current_job_cond, NULL);
+    pthread_cond_init(&c->last_job_cond, NULL);
+    pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_lock(&c->current_job_lock);
+    for (i = 0; i < c->nb_threads; i++) {
+        if (pthread_create(&c->workers[i], NULL, worker, c)) {
+            c->nb_threads = i;
+            pthread_mutex_unlock(&c->current_job_lock);
+            thread_pool_free(c);
+            return AVERROR(EAGAIN);
+        }
+    }
+
+    park_workers(c);
+
+    graph->thread_opaque = c;
+    graph->execute       = thread_execute;
+    return 0;
+}
+
+void ff_graph_thread_free(AVFilterGraph *graph)
+{
+    if (!graph->thread_opaque)
+        return;
+    thread_pool_free(graph->thread_opaque);
+    graph->thread_opaque = NULL;
+    graph->execute       = NULL;
+}
+
+struct FilterProgress {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int value;
+};
+
+FilterProgress *ff_filter_progress_alloc(void)
+{
+    FilterProgress *p = av_mallocz(sizeof(*p));
+
+    if (!p)
+        return NULL;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    return p;
+}
+
+void ff_filter_progress_free(FilterProgress **p)
+{
+    if (!*p)
+        return;
+    pthread_mutex_destroy(&(*p)->mutex);
+    pthread_cond_destroy(&(*p)->cond);
+    av_freep(p);
+}
+
+void ff_filter_progress_set(FilterProgress *p, int n)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->value = n;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+void ff_filter_progress_wait(FilterProgress *p, int n)
+{
+    pthread_mutex_lock(&p->mutex);
+    while (p->value < n)
+        pthread_cond_wait(&p->cond, &p->mutex);
+    pthread_mutex_unlock(&p->mutex);
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * filtergraph thread pool
+ */
+
+#ifndef AVFILTER_THREAD_H
+#define AVFILTER_THREAD_H
+
+#include "config.h"
+#include "avfiltergraph.h"
+
+/**
+ * Progress counter shared by the jobs of one ff_filter_execute() call,
+ * for jobs which depend on the results of an earlier job of the same
+ * call, e.g. a recursive filter split into column bands.
+ */
+typedef struct FilterProgress FilterProgress;
+
+#if HAVE_PTHREADS
+/**
+ * Start graph->nb_threads worker threads and set graph->execute to run
+ * the jobs on them.
+ */
+int ff_graph_thread_init(AVFilterGraph *graph);
+
+/**
+ * Stop and free the threads started by ff_graph_thread_init(), if any.
+ */
+void ff_graph_thread_free(AVFilterGraph *graph);
+
+/**
+ * Allocate a progress counter set to 0.
+ *
+ * @return the counter, or NULL if jobs cannot wait on each other
+ * in this build
+ */
+FilterProgress *ff_filter_progress_alloc(void);
+
+/**
+ * Free a progress counter and set *p to NULL.
+ */
+void ff_filter_progress_free(FilterProgress **p);
+
+/**
+ * Set the counter and wake up the jobs waiting on it.
+ * The value may only go back while nobody is waiting.
+ */
+void ff_filter_progress_set(FilterProgress *p, int n);
+
+/**
+ * Wait until the counter is at least n.
+ */
+void ff_filter_progress_wait(FilterProgress *p, int n);
+#else
+static inline int ff_graph_thread_init(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+static inline void ff_graph_thread_free(AVFilterGraph *graph)
+{
+}
+
+static inline FilterProgress *ff_filter_progress_alloc(void)
+{
+    return NULL;
+}
+
+static inline void ff_filter_progress_free(FilterProgress **p)
+{
+}
+
+static inline void ff_filter_progress_set(FilterProgress *p, int n)
+{
+}
+
+static inline void ff_filter_progress_wait(FilterProgress *p, int n)
+{
+}
+#endif
+
+#endif /* AVFILTER_THREAD_H */
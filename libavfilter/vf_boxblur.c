@@ -29,6 +29,7 @@
 #include "libavutil/eval.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "internal.h"
 
 static const char *var_names[] = {
     "w",
@@ -66,7 +67,9 @@ typedef struct {
     int hsub, vsub;
     int radius[4];
     int power[4];
-    uint8_t *temp[2]; ///< temporary buffer used in blur_power()
+    int nb_threads;
+    int temp_size;
+    uint8_t *temp;    ///< temporary buffers used in blur_power(), 2 per thread
 } BoxBlurContext;
 
 #define Y 0
@@ -114,8 +117,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     BoxBlurContext *boxblur = ctx->priv;
 
-    av_freep(&boxblur->temp[0]);
-    av_freep(&boxblur->temp[1]);
+    av_freep(&boxblur->temp);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -144,8 +146,9 @@ static int config_input(AVFilterLink *inlink)
     char *expr;
     int ret;
 
-    if (!(boxblur->temp[0] = av_malloc(FFMAX(w, h))) ||
-        !(boxblur->temp[1] = av_malloc(FFMAX(w, h))))
+    boxblur->nb_threads = ff_filter_get_nb_threads(ctx);
+    boxblur->temp_size  = FFMAX(w, h);
+    if (!(boxblur->temp = av_malloc(2 * boxblur->temp_size * boxblur->nb_threads)))
         return AVERROR(ENOMEM);
 
     boxblur->hsub = desc->log2_chroma_w;
@@ -298,36 +301,67 @@ static void vblur(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_li
                    h, radius, power, temp);
 }
 
-static void draw_slice(AVFilterLink *inlink, int y0, int h0, int slice_dir)
+typedef struct {
+    int w[4], h[4];
+} ThreadData;
+
+static int hblur_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFilterContext *ctx = inlink->dst;
     BoxBlurContext *boxblur = ctx->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
-    AVFilterBufferRef *inpicref  = inlink ->cur_buf;
-    AVFilterBufferRef *outpicref = outlink->out_buf;
+    ThreadData *td = arg;
+    AVFilterBufferRef *inpicref  = ctx->inputs [0]->cur_buf;
+    AVFilterBufferRef *outpicref = ctx->outputs[0]->out_buf;
+    uint8_t *temp[2] = { boxblur->temp + 2 * jobnr * boxblur->temp_size,
+                         boxblur->temp + (2 * jobnr + 1) * boxblur->temp_size };
+    int plane;
+
+    for (plane = 0; inpicref->data[plane] && plane < 4; plane++) {
+        int start = td->h[plane] *  jobnr      / nb_jobs;
+        int end   = td->h[plane] * (jobnr + 1) / nb_jobs;
+
+        hblur(outpicref->data[plane] + start * outpicref->linesize[plane], outpicref->linesize[plane],
+              inpicref ->data[plane] + start * inpicref ->linesize[plane], inpicref ->linesize[plane],
+              td->w[plane], end - start, boxblur->radius[plane], boxblur->power[plane],
+              temp);
+    }
+    return 0;
+}
+
+static int vblur_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    BoxBlurContext *boxblur = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *inpicref  = ctx->inputs [0]->cur_buf;
+    AVFilterBufferRef *outpicref = ctx->outputs[0]->out_buf;
+    uint8_t *temp[2] = { boxblur->temp + 2 * jobnr * boxblur->temp_size,
+                         boxblur->temp + (2 * jobnr + 1) * boxblur->temp_size };
     int plane;
-    int cw = inlink->w >> boxblur->hsub, ch = h0 >> boxblur->vsub;
-    int w[4] = { inlink->w, cw, cw, inlink->w };
-    int h[4] = { h0, ch, ch, h0 };
-    uint8_t *dst[4], *src[4];
 
     for (plane = 0; inpicref->data[plane] && plane < 4; plane++) {
-        int y = plane == 1 || plane == 2 ? y0 >> boxblur->vsub : y0;
-        src[plane] = inpicref ->data[plane] + inpicref ->linesize[plane] * y;
-        dst[plane] = outpicref->data[plane] + outpicref->linesize[plane] * y;
+        int start = td->w[plane] *  jobnr      / nb_jobs;
+        int end   = td->w[plane] * (jobnr + 1) / nb_jobs;
+
+        vblur(outpicref->data[plane] + start, outpicref->linesize[plane],
+              outpicref->data[plane] + start, outpicref->linesize[plane],
+              end - start, td->h[plane], boxblur->radius[plane], boxblur->power[plane],
+              temp);
     }
+    return 0;
+}
+
+static void draw_slice(AVFilterLink *inlink, int y0, int h0, int slice_dir)
+{
+    AVFilterContext *ctx = inlink->dst;
+    BoxBlurContext *boxblur = ctx->priv;
+    AVFilterLink *outlink = inlink->dst->outputs[0];
+    int cw = inlink->w >> boxblur->hsub, ch = h0 >> boxblur->vsub;
+    ThreadData td = { { inlink->w, cw, cw, inlink->w },
+                      { h0, ch, ch, h0 } };
 
-    for (plane = 0; inpicref->data[plane] && plane < 4; plane++)
-        hblur(outpicref->data[plane], outpicref->linesize[plane],
-              inpicref ->data[plane], inpicref ->linesize[plane],
-              w[plane], h[plane], boxblur->radius[plane], boxblur->power[plane],
-              boxblur->temp);
-
-    for (plane = 0; inpicref->data[plane] && plane < 4; plane++)
-        vblur(outpicref->data[plane], outpicref->linesize[plane],
-              outpicref->data[plane], outpicref->linesize[plane],
-              w[plane], h[plane], boxblur->radius[plane], boxblur->power[plane],
-              boxblur->temp);
+    /* lines are independent in the horizontal pass and columns in the
+     * vertical one, so each pass is split in jobs along the other axis */
+    ff_filter_execute(ctx, hblur_slice, &td, NULL, boxblur->nb_threads);
+    ff_filter_execute(ctx, vblur_slice, &td, NULL, boxblur->nb_threads);
 
     avfilter_draw_slice(outlink, y0, h0, slice_dir);
 }
@@ -27,150 +27,184 @@
 
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "internal.h"
+#include "thread.h"
+
+/* narrower column bands spend more time waiting than filtering */
+#define MIN_BAND_WIDTH 64
 
 typedef struct {
     int Coefs[4][512*16];
-    unsigned int *Line;
+    unsigned int *Line[3];
     unsigned short *Frame[3];
     int hsub, vsub;
+    int depth;
+    int first_frame;
+    int nb_bands[3];                ///< number of jobs each plane is split in
+    unsigned int *BandAnt[3];       ///< horizontal filter state at the right edge of each column band, per line
+    FilterProgress **Progress[3];   ///< number of lines done in each column band
 } HQDN3DContext;
 
-static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, int *Coef)
+static av_always_inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, int *Coef, int depth)
 {
     //    int dMul= (PrevMul&0xFFFFFF)-(CurrMul&0xFFFFFF);
     int dMul= PrevMul-CurrMul;
     unsigned int d=((dMul+0x10007FF)>>12);
+    /* samples deeper than 8 bits reach up to 255.99 << 16, so a full scale
+     * difference would index past the table; the coefficients are 0 at
+     * its ends anyway */
+    if (depth > 8)
+        d = av_clip(d, 16, 16*511);
     return CurrMul + Coef[d];
 }
 
-static void deNoiseTemporal(unsigned char *FrameSrc,
-                            unsigned char *FrameDest,
-                            unsigned short *FrameAnt,
-                            int W, int H, int sStride, int dStride,
-                            int *Temporal)
+/* The filters work on 8.16 fixed point values in units of 8-bit samples,
+ * whatever the bit depth of the input. */
+static av_always_inline unsigned int load_pixel(const uint8_t *src, int x, int depth)
+{
+    if (depth == 8)
+        return src[x] << 16;
+    return ((const uint16_t *)src)[x] << (24 - depth);
+}
+
+static av_always_inline void store_pixel(uint8_t *dst, int x, unsigned int PixelDst, int depth)
+{
+    if (depth == 8)
+        dst[x] = ((PixelDst+0x10007FFF)>>16);
+    else
+        ((uint16_t *)dst)[x] = av_clip_uintp2(((int)PixelDst + (1 << (23 - depth)) - 1) >> (24 - depth), depth);
+}
+
+static av_always_inline void deNoiseTemporal(const uint8_t *Frame,
+                                             uint8_t *FrameDest,
+                                             unsigned short *FrameAnt,
+                                             int W, int H, int sStride, int dStride,
+                                             int *Temporal, int depth)
 {
-    long X, Y;
+    int X, Y;
     unsigned int PixelDst;
 
     for (Y = 0; Y < H; Y++) {
         for (X = 0; X < W; X++) {
-            PixelDst = LowPassMul(FrameAnt[X]<<8, FrameSrc[X]<<16, Temporal);
+            PixelDst = LowPassMul(FrameAnt[X]<<8, load_pixel(Frame, X, depth), Temporal, depth);
             FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+            store_pixel(FrameDest, X, PixelDst, depth);
         }
-        FrameSrc  += sStride;
+        Frame     += sStride;
         FrameDest += dStride;
-        FrameAnt += W;
+        FrameAnt  += W;
     }
 }
 
-static void deNoiseSpacial(unsigned char *Frame,
-                           unsigned char *FrameDest,
-                           unsigned int *LineAnt,
-                           int W, int H, int sStride, int dStride,
-                           int *Horizontal, int *Vertical)
+/**
+ * Filter the pixels x0 to x1 - 1 of a line with the spatial filter and,
+ * if Temporal is not NULL, the temporal one.
+ *
+ * @param PixelAnt horizontal filter state left of x0, unused if x0 is 0
+ * @return the horizontal filter state at x1 - 1
+ */
+static av_always_inline unsigned int deNoiseLine(const uint8_t *Frame,
+                                                 uint8_t *FrameDest,
+                                                 unsigned int *LineAnt,
+                                                 unsigned short *FrameAnt,
+                                                 int x0, int x1, int FirstLine,
+                                                 unsigned int PixelAnt,
+                                                 int *Horizontal, int *Vertical,
+                                                 int *Temporal, int depth)
 {
-    long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
+    int X;
     unsigned int PixelDst;
 
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
-
-    /* First line has no top neighbor, only left. */
-    for (X = 1; X < W; X++) {
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-    }
-
-    for (Y = 1; Y < H; Y++) {
-        unsigned int PixelAnt;
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++) {
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+    for (X = x0; X < x1; X++) {
+        /* The first pixel of a line has no left neighbor and the first
+         * line has no top neighbor. */
+        if (X)
+            PixelDst = LowPassMul(PixelAnt, load_pixel(Frame, X, depth), Horizontal, depth);
+        else
+            PixelDst = load_pixel(Frame, X, depth);
+        /* Without the temporal filter, the first line is filtered against
+         * its first pixel instead of the previous one, as it always was. */
+        if (!FirstLine || Temporal || !X)
+            PixelAnt = PixelDst;
+        if (FirstLine)
+            LineAnt[X] = PixelDst;
+        else
+            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelDst, Vertical, depth);
+
+        if (Temporal) {
+            PixelDst = LowPassMul(FrameAnt[X]<<8, PixelDst, Temporal, depth);
+            FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
         }
+        store_pixel(FrameDest, X, PixelDst, depth);
     }
+    return PixelAnt;
 }
 
-static void deNoise(unsigned char *Frame,
-                    unsigned char *FrameDest,
-                    unsigned int *LineAnt,
-                    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical, int *Temporal)
+static av_always_inline void deNoise(HQDN3DContext *hqdn3d,
+                                     AVFilterBufferRef *inpic, AVFilterBufferRef *outpic,
+                                     int plane, int band, int depth)
 {
-    long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if (!FrameAnt) {
-        (*FrameAntPtr) = FrameAnt = av_malloc(W*H*sizeof(unsigned short));
-        for (Y = 0; Y < H; Y++) {
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (X = 0; X < W; X++) dst[X]=src[X]<<8;
-        }
+    const uint8_t *Frame     = inpic ->data[plane];
+    uint8_t *FrameDest       = outpic->data[plane];
+    unsigned short *FrameAnt = hqdn3d->Frame[plane];
+    unsigned int *LineAnt    = hqdn3d->Line[plane];
+    int sStride  = inpic ->linesize[plane];
+    int dStride  = outpic->linesize[plane];
+    int *Spatial  = hqdn3d->Coefs[plane ? 2 : 0];
+    int *Temporal = hqdn3d->Coefs[plane ? 3 : 1];
+    int nb_bands  = hqdn3d->nb_bands[plane];
+    int W = inpic->video->w;
+    int H = inpic->video->h;
+    unsigned int PixelAnt = 0;
+    int x0, x1, Y;
+
+    if (plane) {
+        W >>= hqdn3d->hsub;
+        H >>= hqdn3d->vsub;
     }
 
-    if (!Horizontal[0] && !Vertical[0]) {
-        deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
-        return;
-    }
-    if (!Temporal[0]) {
-        deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
-        return;
-    }
+    if (!Spatial[0]) {
+        /* the lines are independent without the spatial filter */
+        int y0 = H *  band      / nb_bands;
+        int y1 = H * (band + 1) / nb_bands;
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
-
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (X = 1; X < W; X++) {
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        deNoiseTemporal(Frame + y0 * sStride, FrameDest + y0 * dStride,
+                        FrameAnt + y0 * W, W, y1 - y0, sStride, dStride,
+                        Temporal, depth);
+        return;
     }
+    if (!Temporal[0])
+        Temporal = NULL;
+
+    /* The spatial filter is recursive in both directions, so the plane is
+     * split in column bands filtered as a wavefront: a band starts a line
+     * when the band on its left is done with it. */
+    x0 = W *  band      / nb_bands;
+    x1 = W * (band + 1) / nb_bands;
+    for (Y = 0; Y < H; Y++) {
+        if (band) {
+            ff_filter_progress_wait(hqdn3d->Progress[plane][band - 1], Y + 1);
+            PixelAnt = hqdn3d->BandAnt[plane][(band - 1) * H + Y];
+        }
 
-    for (Y = 1; Y < H; Y++) {
-        unsigned int PixelAnt;
-        unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++) {
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+        /* constant arguments, so that each case gets its own loop */
+        if (Y && Temporal)
+            PixelAnt = deNoiseLine(Frame, FrameDest, LineAnt, FrameAnt, x0, x1, 0,
+                                   PixelAnt, Spatial, Spatial, Temporal, depth);
+        else if (Y)
+            PixelAnt = deNoiseLine(Frame, FrameDest, LineAnt, FrameAnt, x0, x1, 0,
+                                   PixelAnt, Spatial, Spatial, NULL, depth);
+        else
+            PixelAnt = deNoiseLine(Frame, FrameDest, LineAnt, FrameAnt, x0, x1, 1,
+                                   PixelAnt, Spatial, Spatial, Temporal, depth);
+
+        if (band < nb_bands - 1) {
+            hqdn3d->BandAnt[plane][band * H + Y] = PixelAnt;
+            ff_filter_progress_set(hqdn3d->Progress[plane][band], Y + 1);
         }
+        Frame     += sStride;
+        FrameDest += dStride;
+        FrameAnt  += W;
     }
 }
 
@@ -255,17 +289,26 @@ static int init(AVFilterContext *ctx, const char *args, void *opaque)
 static void uninit(AVFilterContext *ctx)
 {
     HQDN3DContext *hqdn3d = ctx->priv;
-
-    av_freep(&hqdn3d->Line);
-    av_freep(&hqdn3d->Frame[0]);
-    av_freep(&hqdn3d->Frame[1]);
-    av_freep(&hqdn3d->Frame[2]);
+    int i, j;
+
+    for (i = 0; i < 3; i++) {
+        av_freep(&hqdn3d->Line[i]);
+        av_freep(&hqdn3d->Frame[i]);
+        av_freep(&hqdn3d->BandAnt[i]);
+        if (hqdn3d->Progress[i])
+            for (j = 0; j < hqdn3d->nb_bands[i] - 1; j++)
+                ff_filter_progress_free(&hqdn3d->Progress[i][j]);
+        av_freep(&hqdn3d->Progress[i]);
+    }
 }
 
 static int query_formats(AVFilterContext *ctx)
 {
     static const enum PixelFormat pix_fmts[] = {
-        PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_YUV411P, PIX_FMT_NONE
+        PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_YUV411P,
+        PIX_FMT_YUV420P9, PIX_FMT_YUV420P10, PIX_FMT_YUV422P10,
+        PIX_FMT_YUV420P16, PIX_FMT_YUV422P16,
+        PIX_FMT_NONE
     };
 
     avfilter_set_common_pixel_formats(ctx, avfilter_make_format_list(pix_fmts));
@@ -276,46 +319,94 @@ static int query_formats(AVFilterContext *ctx)
 static int config_input(AVFilterLink *inlink)
 {
     HQDN3DContext *hqdn3d = inlink->dst->priv;
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[inlink->format];
+    int nb_threads = ff_filter_get_nb_threads(inlink->dst);
+    int i, j;
+
+    hqdn3d->hsub  = desc->log2_chroma_w;
+    hqdn3d->vsub  = desc->log2_chroma_h;
+    hqdn3d->depth = desc->comp[0].depth_minus1 + 1;
+    hqdn3d->first_frame = 1;
+
+    for (i = 0; i < 3; i++) {
+        int w = i ? inlink->w >> hqdn3d->hsub : inlink->w;
+        int h = i ? inlink->h >> hqdn3d->vsub : inlink->h;
+
+        hqdn3d->Line[i]  = av_malloc(w * sizeof(*hqdn3d->Line[i]));
+        hqdn3d->Frame[i] = av_malloc(w * h * sizeof(*hqdn3d->Frame[i]));
+        if (!hqdn3d->Line[i] || !hqdn3d->Frame[i])
+            return AVERROR(ENOMEM);
+
+        if (!hqdn3d->Coefs[i ? 2 : 0][0]) {
+            hqdn3d->nb_bands[i] = FFMIN(nb_threads, h);
+            continue;
+        }
 
-    hqdn3d->hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
-    hqdn3d->vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
-
-    hqdn3d->Line = av_malloc(inlink->w * sizeof(*hqdn3d->Line));
-    if (!hqdn3d->Line)
-        return AVERROR(ENOMEM);
+        hqdn3d->nb_bands[i] = av_clip(w / MIN_BAND_WIDTH, 1, nb_threads);
+        if (hqdn3d->nb_bands[i] == 1)
+            continue;
+        hqdn3d->BandAnt[i]  = av_malloc((hqdn3d->nb_bands[i] - 1) * h * sizeof(*hqdn3d->BandAnt[i]));
+        hqdn3d->Progress[i] = av_mallocz((hqdn3d->nb_bands[i] - 1) * sizeof(*hqdn3d->Progress[i]));
+        if (!hqdn3d->BandAnt[i] || !hqdn3d->Progress[i])
+            return AVERROR(ENOMEM);
+        for (j = 0; j < hqdn3d->nb_bands[i] - 1; j++) {
+            if (!(hqdn3d->Progress[i][j] = ff_filter_progress_alloc())) {
+                /* the jobs cannot wait on each other, filter the whole plane in one */
+                hqdn3d->nb_bands[i] = j + 1;
+                break;
+            }
+        }
+    }
 
     return 0;
 }
 
 static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
 
+static int denoise_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *hqdn3d = ctx->priv;
+    AVFilterBufferRef *inpic  = ctx->inputs [0]->cur_buf;
+    AVFilterBufferRef *outpic = ctx->outputs[0]->out_buf;
+    int plane = 0, band = jobnr;
+
+    while (band >= hqdn3d->nb_bands[plane])
+        band -= hqdn3d->nb_bands[plane++];
+
+    if (hqdn3d->depth == 8)
+        deNoise(hqdn3d, inpic, outpic, plane, band, 8);
+    else
+        deNoise(hqdn3d, inpic, outpic, plane, band, hqdn3d->depth);
+    return 0;
+}
+
 static void end_frame(AVFilterLink *inlink)
 {
-    HQDN3DContext *hqdn3d = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx = inlink->dst;
+    HQDN3DContext *hqdn3d = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFilterBufferRef *inpic  = inlink ->cur_buf;
     AVFilterBufferRef *outpic = outlink->out_buf;
-    int cw = inpic->video->w >> hqdn3d->hsub;
-    int ch = inpic->video->h >> hqdn3d->vsub;
-
-    deNoise(inpic->data[0], outpic->data[0],
-            hqdn3d->Line, &hqdn3d->Frame[0], inpic->video->w, inpic->video->h,
-            inpic->linesize[0], outpic->linesize[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[1]);
-    deNoise(inpic->data[1], outpic->data[1],
-            hqdn3d->Line, &hqdn3d->Frame[1], cw, ch,
-            inpic->linesize[1], outpic->linesize[1],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
-    deNoise(inpic->data[2], outpic->data[2],
-            hqdn3d->Line, &hqdn3d->Frame[2], cw, ch,
-            inpic->linesize[2], outpic->linesize[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
+    int i, j, x, y;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < hqdn3d->nb_bands[i] - 1 && hqdn3d->Progress[i]; j++)
+            ff_filter_progress_set(hqdn3d->Progress[i][j], 0);
+
+        if (hqdn3d->first_frame) {
+            int w = i ? inpic->video->w >> hqdn3d->hsub : inpic->video->w;
+            int h = i ? inpic->video->h >> hqdn3d->vsub : inpic->video->h;
+
+            for (y = 0; y < h; y++)
+                for (x = 0; x < w; x++)
+                    hqdn3d->Frame[i][y * w + x] =
+                        load_pixel(inpic->data[i] + y * inpic->linesize[i], x, hqdn3d->depth) >> 8;
+        }
+    }
+    hqdn3d->first_frame = 0;
+
+    ff_filter_execute(ctx, denoise_job, NULL, NULL,
+                      hqdn3d->nb_bands[0] + hqdn3d->nb_bands[1] + hqdn3d->nb_bands[2]);
 
     avfilter_draw_slice(outlink, 0, inpic->video->h, 1);
     avfilter_end_frame(outlink);
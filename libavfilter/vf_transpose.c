@@ -29,6 +29,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
 #include "avfilter.h"
+#include "internal.h"
 
 typedef struct {
     int hsub, vsub;
@@ -132,12 +133,11 @@ static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *picref)
     avfilter_start_frame(outlink, avfilter_ref_buffer(outlink->out_buf, ~0));
 }
 
-static void end_frame(AVFilterLink *inlink)
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    TransContext *trans = inlink->dst->priv;
-    AVFilterBufferRef *inpic  = inlink->cur_buf;
-    AVFilterBufferRef *outpic = inlink->dst->outputs[0]->out_buf;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    TransContext *trans = ctx->priv;
+    AVFilterBufferRef *inpic  = ctx->inputs [0]->cur_buf;
+    AVFilterBufferRef *outpic = ctx->outputs[0]->out_buf;
     int plane;
 
     for (plane = 0; outpic->data[plane]; plane++) {
@@ -149,7 +149,7 @@ static void end_frame(AVFilterLink *inlink)
         int outh = outpic->video->h>>vsub;
         uint8_t *out, *in;
         int outlinesize, inlinesize;
-        int x, y;
+        int x, y, start, end;
 
         out = outpic->data[plane]; outlinesize = outpic->linesize[plane];
         in  = inpic ->data[plane]; inlinesize  = inpic ->linesize[plane];
@@ -164,7 +164,11 @@ static void end_frame(AVFilterLink *inlink)
             outlinesize *= -1;
         }
 
-        for (y = 0; y < outh; y++) {
+        start = outh *  jobnr      / nb_jobs;
+        end   = outh * (jobnr + 1) / nb_jobs;
+        out  += start * outlinesize;
+
+        for (y = start; y < end; y++) {
             switch (pixstep) {
             case 1:
                 for (x = 0; x < outw; x++)
@@ -188,6 +192,18 @@ static void end_frame(AVFilterLink *inlink)
             out += outlinesize;
         }
     }
+    return 0;
+}
+
+static void end_frame(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterBufferRef *inpic  = inlink->cur_buf;
+    AVFilterBufferRef *outpic = ctx->outputs[0]->out_buf;
+    AVFilterLink *outlink = ctx->outputs[0];
+
+    ff_filter_execute(ctx, filter_slice, NULL, NULL,
+                      FFMIN(outpic->video->h, ff_filter_get_nb_threads(ctx)));
 
     avfilter_unref_buffer(inpic);
     avfilter_draw_slice(outlink, 0, outpic->video->h, 1);
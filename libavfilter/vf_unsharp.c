@@ -37,6 +37,7 @@
  */
 
 #include "avfilter.h"
+#include "internal.h"
 #include "libavutil/common.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixdesc.h"
@@ -55,35 +56,44 @@ typedef struct FilterParam {
     int steps_y;                             ///< vertical step count
     int scalebits;                           ///< bits to shift pixel
     int32_t halfscale;                       ///< amount to add to pixel
-    uint32_t *sc[(MAX_SIZE * MAX_SIZE) - 1]; ///< finite state machine storage
+    uint32_t **sc;                           ///< finite state machine storage, 2 * steps_y lines per thread
 } FilterParam;
 
 typedef struct {
     FilterParam luma;   ///< luma parameters (width, height, amount)
     FilterParam chroma; ///< chroma parameters (width, height, amount)
+    int nb_threads;
 } UnsharpContext;
 
-static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_stride, int width, int height, FilterParam *fp)
+/**
+ * Filter the lines slice_start to slice_end - 1 of a plane.
+ * An output line only depends on the steps_y input lines above and below
+ * it, so starting steps_y lines before the slice with cleared state gives
+ * the same result as filtering the whole plane.
+ */
+static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_stride, int width, int height,
+                      int slice_start, int slice_end, FilterParam *fp, uint32_t **sc)
 {
-    uint32_t **sc = fp->sc;
     uint32_t sr[(MAX_SIZE * MAX_SIZE) - 1], tmp1, tmp2;
 
     int32_t res;
     int x, y, z;
 
     if (!fp->amount) {
-        if (dst_stride == src_stride)
-            memcpy(dst, src, src_stride * height);
-        else
-            for (y = 0; y < height; y++, dst += dst_stride, src += src_stride)
-                memcpy(dst, src, width);
+        dst += slice_start * dst_stride;
+        src += slice_start * src_stride;
+        for (y = slice_start; y < slice_end; y++, dst += dst_stride, src += src_stride)
+            memcpy(dst, src, width);
         return;
     }
 
     for (y = 0; y < 2 * fp->steps_y; y++)
         memset(sc[y], 0, sizeof(sc[y][0]) * (width + 2 * fp->steps_x));
 
-    for (y = -fp->steps_y; y < height + fp->steps_y; y++) {
+    y = slice_start - fp->steps_y;
+    dst += FFMAX(y, 0) * dst_stride;
+    src += FFMAX(y, 0) * src_stride;
+    for (; y < slice_end + fp->steps_y; y++) {
         memset(sr, 0, sizeof(sr[0]) * (2 * fp->steps_x - 1));
         for (x = -fp->steps_x; x < width + fp->steps_x; x++) {
             tmp1 = x <= 0 ? src[0] : x >= width ? src[width-1] : src[x];
@@ -95,7 +105,7 @@ static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_
                 tmp2 = sc[z + 0][x + fp->steps_x] + tmp1; sc[z + 0][x + fp->steps_x] = tmp1;
                 tmp1 = sc[z + 1][x + fp->steps_x] + tmp2; sc[z + 1][x + fp->steps_x] = tmp2;
             }
-            if (x >= fp->steps_x && y >= fp->steps_y) {
+            if (x >= fp->steps_x && y >= slice_start + fp->steps_y) {
                 const uint8_t* srx = src - fp->steps_y * src_stride + x - fp->steps_x;
                 uint8_t* dsx = dst - fp->steps_y * dst_stride + x - fp->steps_x;
 
@@ -160,7 +170,7 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width)
+static int init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width, int nb_threads)
 {
     int z;
     const char *effect;
@@ -170,34 +180,70 @@ static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char
     av_log(ctx, AV_LOG_INFO, "effect:%s type:%s msize_x:%d msize_y:%d amount:%0.2f\n",
            effect, effect_type, fp->msize_x, fp->msize_y, fp->amount / 65535.0);
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        fp->sc[z] = av_malloc(sizeof(*(fp->sc[z])) * (width + 2 * fp->steps_x));
+    if (!fp->amount)
+        return 0;
+
+    fp->sc = av_mallocz(sizeof(*fp->sc) * 2 * fp->steps_y * nb_threads);
+    if (!fp->sc)
+        return AVERROR(ENOMEM);
+    for (z = 0; z < 2 * fp->steps_y * nb_threads; z++)
+        if (!(fp->sc[z] = av_malloc(sizeof(*(fp->sc[z])) * (width + 2 * fp->steps_x))))
+            return AVERROR(ENOMEM);
+
+    return 0;
 }
 
 static int config_props(AVFilterLink *link)
 {
     UnsharpContext *unsharp = link->dst->priv;
+    int ret;
+
+    unsharp->nb_threads = FFMIN(ff_filter_get_nb_threads(link->dst), CHROMA_HEIGHT(link));
 
-    init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w);
-    init_filter_param(link->dst, &unsharp->chroma, "chroma", CHROMA_WIDTH(link));
+    if ((ret = init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w,            unsharp->nb_threads)) < 0 ||
+        (ret = init_filter_param(link->dst, &unsharp->chroma, "chroma", CHROMA_WIDTH(link), unsharp->nb_threads)) < 0)
+        return ret;
 
     return 0;
 }
 
-static void free_filter_param(FilterParam *fp)
+static void free_filter_param(FilterParam *fp, int nb_threads)
 {
     int z;
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
+    if (!fp->sc)
+        return;
+    for (z = 0; z < 2 * fp->steps_y * nb_threads; z++)
         av_free(fp->sc[z]);
+    av_freep(&fp->sc);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
     UnsharpContext *unsharp = ctx->priv;
 
-    free_filter_param(&unsharp->luma);
-    free_filter_param(&unsharp->chroma);
+    free_filter_param(&unsharp->luma,   unsharp->nb_threads);
+    free_filter_param(&unsharp->chroma, unsharp->nb_threads);
+}
+
+static int unsharp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    UnsharpContext *unsharp = ctx->priv;
+    AVFilterLink *link = ctx->inputs[0];
+    AVFilterBufferRef *in  = link->cur_buf;
+    AVFilterBufferRef *out = ctx->outputs[0]->out_buf;
+    int plane;
+
+    for (plane = 0; plane < 3; plane++) {
+        FilterParam *fp = plane ? &unsharp->chroma : &unsharp->luma;
+        int w = plane ? CHROMA_WIDTH(link)  : link->w;
+        int h = plane ? CHROMA_HEIGHT(link) : link->h;
+
+        unsharpen(out->data[plane], in->data[plane], out->linesize[plane], in->linesize[plane], w, h,
+                  h * jobnr / nb_jobs, h * (jobnr + 1) / nb_jobs,
+                  fp, fp->sc + 2 * fp->steps_y * jobnr);
+    }
+    return 0;
 }
 
 static void end_frame(AVFilterLink *link)
@@ -206,9 +252,7 @@ static void end_frame(AVFilterLink *link)
     AVFilterBufferRef *in  = link->cur_buf;
     AVFilterBufferRef *out = link->dst->outputs[0]->out_buf;
 
-    unsharpen(out->data[0], in->data[0], out->linesize[0], in->linesize[0], link->w,            link->h,             &unsharp->luma);
-    unsharpen(out->data[1], in->data[1], out->linesize[1], in->linesize[1], CHROMA_WIDTH(link), CHROMA_HEIGHT(link), &unsharp->chroma);
-    unsharpen(out->data[2], in->data[2], out->linesize[2], in->linesize[2], CHROMA_WIDTH(link), CHROMA_HEIGHT(link), &unsharp->chroma);
+    ff_filter_execute(link->dst, unsharp_slice, NULL, NULL, unsharp->nb_threads);
 
     avfilter_unref_buffer(in);
     avfilter_draw_slice(link->dst->outputs[0], 0, link->h, 1);
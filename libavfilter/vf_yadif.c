@@ -21,6 +21,7 @@
 #include "libavutil/common.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "internal.h"
 #include "yadif.h"
 
 #undef NDEBUG
@@ -133,10 +134,17 @@ static void filter_line_c_16bit(uint16_t *dst,
     FILTER
 }
 
-static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
-                   int parity, int tff)
+typedef struct {
+    AVFilterBufferRef *dstpic;
+    int parity, tff;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     YADIFContext *yadif = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *dstpic = td->dstpic;
+    int parity = td->parity, tff = td->tff;
     int y, i;
 
     for (i = 0; i < yadif->csp->nb_components; i++) {
@@ -151,7 +159,7 @@ static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
             h >>= yadif->csp->log2_chroma_h;
         }
 
-        for (y = 0; y < h; y++) {
+        for (y = h * jobnr / nb_jobs; y < h * (jobnr + 1) / nb_jobs; y++) {
             if ((y ^ parity) & 1) {
                 uint8_t *prev = &yadif->prev->data[i][y*refs];
                 uint8_t *cur  = &yadif->cur ->data[i][y*refs];
@@ -168,6 +176,16 @@ static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
 #if HAVE_MMX
     __asm__ volatile("emms \n\t" : : : "memory");
 #endif
+    return 0;
+}
+
+static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
+                   int parity, int tff)
+{
+    ThreadData td = { dstpic, parity, tff };
+
+    ff_filter_execute(ctx, filter_slice, &td, NULL,
+                      FFMIN(dstpic->video->h, ff_filter_get_nb_threads(ctx)));
 }
 
 static AVFilterBufferRef *get_video_buffer(AVFilterLink *link, int perms, int w, int h)
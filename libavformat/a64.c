@@ -159,7 +159,7 @@ static int a64_write_trailer(struct AVFormatContext *s)
     /* need to flush last packet? */
     if(c->interleaved) a64_write_packet(s, &pkt);
     /* discard backed up packet */
-    if(c->prev_pkt.data) av_destruct_packet(&c->prev_pkt);
+    av_free_packet(&c->prev_pkt);
     return 0;
 }
 
@@ -277,6 +277,8 @@ typedef struct AVFormatParameters {
 #define AVFMT_TS_NONSTRICT  0x8000 /**< Format does not require strictly
                                           increasing timestamps, but they must
                                           still be monotonic */
+#define AVFMT_ALLOW_PARTIAL 0x10000 /**< Format accepts packets with
+                                          AV_PKT_FLAG_PARTIAL set */
 
 typedef struct AVOutputFormat {
     const char *name;
@@ -647,6 +649,21 @@ typedef struct AVStream {
      * NOT PART OF PUBLIC API
      */
     int request_probe;
+
+    /**
+     * first packet of this stream queued by av_interleave_packet_per_dts(),
+     * the queue continues through AVPacketList.next up to
+     * last_in_packet_buffer.
+     * used internally, NOT PART OF PUBLIC API, dont read or write from outside of libav*
+     */
+    struct AVPacketList *first_in_packet_buffer;
+
+    /**
+     * the last packet written to this stream had AV_PKT_FLAG_PARTIAL set,
+     * the next one continues its frame.
+     * used internally, NOT PART OF PUBLIC API, dont read or write from outside of libav*
+     */
+    int partial_pkt;
 } AVStream;
 
 #define AV_PROGRAM_RUNNING 1
@@ -888,6 +905,24 @@ typedef struct AVFormatContext {
      * This will be moved into demuxer private options. Thus no API/ABI compatibility
      */
     int ts_id;
+
+    /**
+     * Indices of the streams which have packets queued by
+     * av_interleave_packet_per_dts(), as a binary min-heap ordered by the
+     * dts of their first queued packet, packets with equal dts in the order
+     * they were queued.
+     * NOT PART OF PUBLIC API
+     */
+    int *interleave_heap;
+    int nb_interleave_heap;
+    unsigned int interleave_heap_size;
+
+    /**
+     * Sequence number of the next packet queued by
+     * av_interleave_packet_per_dts().
+     * NOT PART OF PUBLIC API
+     */
+    int64_t interleave_seq;
 } AVFormatContext;
 
 typedef struct AVPacketList {
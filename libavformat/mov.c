@@ -2495,8 +2495,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 #if CONFIG_DV_DEMUXER
         if (mov->dv_demux && sc->dv_audio_container) {
-            dv_produce_packet(mov->dv_demux, pkt, pkt->data, pkt->size, pkt->pos);
-            av_free(pkt->data);
+            AVPacket dv_pkt = *pkt;
+            dv_produce_packet(mov->dv_demux, pkt, dv_pkt.data, dv_pkt.size, dv_pkt.pos);
+            av_free_packet(&dv_pkt);
             pkt->size = 0;
             ret = dv_get_packet(mov->dv_demux, pkt);
             if (ret < 0)
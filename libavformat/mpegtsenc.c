@@ -207,6 +207,7 @@ typedef struct MpegTSWriteStream {
     int payload_flags;
     uint8_t payload[DEFAULT_PES_PAYLOAD_SIZE];
     ADTSContext *adts;
+    int pes_partial; ///< the last PES packet is not complete, the next payload continues it
 } MpegTSWriteStream;
 
 static void mpegts_write_pat(AVFormatContext *s)
@@ -726,11 +727,13 @@ static uint8_t *get_ts_payload_start(uint8_t *pkt)
 /* Add a pes header to the front of payload, and segment into an integer number of
  * ts packets. The final ts packet is padded using an over-sized adaptation header
  * to exactly fill the last ts packet.
- * NOTE: 'payload' contains a complete PES payload.
+ * NOTE: 'payload' contains a complete PES payload, unless 'partial' is set, then
+ * the PES packet is left open with an unspecified length and the payload of the
+ * next call is appended to it without a new PES header.
  */
 static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
                              const uint8_t *payload, int payload_size,
-                             int64_t pts, int64_t dts, int key)
+                             int64_t pts, int64_t dts, int key, int partial)
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
@@ -741,7 +744,8 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int64_t pcr = -1; /* avoid warning */
     int64_t delay = av_rescale(s->max_delay, 90000, AV_TIME_BASE);
 
-    is_start = 1;
+    is_start = !ts_st->pes_partial;
+    ts_st->pes_partial = partial;
     while (payload_size > 0) {
         retransmit_si_info(s);
 
@@ -845,7 +849,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             len = payload_size + header_len + 3;
             if (private_code != 0)
                 len++;
-            if (len > 0xffff)
+            if (len > 0xffff || partial)
                 len = 0;
             *q++ = len >> 8;
             *q++ = len;
@@ -935,7 +939,7 @@ static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
     ts_st->first_pts_check = 0;
 
-    if (st->codec->codec_id == CODEC_ID_H264) {
+    if (st->codec->codec_id == CODEC_ID_H264 && !ts_st->pes_partial) {
         const uint8_t *p = buf, *buf_end = p+size;
         uint32_t state = -1;
 
@@ -992,7 +996,8 @@ static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
 
     if (st->codec->codec_type != AVMEDIA_TYPE_AUDIO) {
         // for video and subtitle, write a single pes packet
-        mpegts_write_pes(s, st, buf, size, pts, dts, pkt->flags & AV_PKT_FLAG_KEY);
+        mpegts_write_pes(s, st, buf, size, pts, dts, pkt->flags & AV_PKT_FLAG_KEY,
+                         pkt->flags & AV_PKT_FLAG_PARTIAL);
         av_free(data);
         return 0;
     }
@@ -1000,7 +1005,7 @@ static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
     if (ts_st->payload_index + size > DEFAULT_PES_PAYLOAD_SIZE) {
         mpegts_write_pes(s, st, ts_st->payload, ts_st->payload_index,
                          ts_st->payload_pts, ts_st->payload_dts,
-                         ts_st->payload_flags & AV_PKT_FLAG_KEY);
+                         ts_st->payload_flags & AV_PKT_FLAG_KEY, 0);
         ts_st->payload_index = 0;
     }
 
@@ -1033,7 +1038,7 @@ static int mpegts_write_end(AVFormatContext *s)
         if (ts_st->payload_index > 0) {
             mpegts_write_pes(s, st, ts_st->payload, ts_st->payload_index,
                              ts_st->payload_pts, ts_st->payload_dts,
-                             ts_st->payload_flags & AV_PKT_FLAG_KEY);
+                             ts_st->payload_flags & AV_PKT_FLAG_KEY, 0);
         }
         av_freep(&ts_st->adts);
     }
@@ -1061,5 +1066,6 @@ AVOutputFormat ff_mpegts_muxer = {
     .write_header      = mpegts_write_header,
     .write_packet      = mpegts_write_packet,
     .write_trailer     = mpegts_write_end,
+    .flags             = AVFMT_ALLOW_PARTIAL,
     .priv_class = &mpegts_muxer_class,
 };
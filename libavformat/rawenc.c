@@ -117,7 +117,7 @@ AVOutputFormat ff_h261_muxer = {
     .audio_codec       = CODEC_ID_NONE,
     .video_codec       = CODEC_ID_H261,
     .write_packet      = ff_raw_write_packet,
-    .flags= AVFMT_NOTIMESTAMPS,
+    .flags= AVFMT_NOTIMESTAMPS | AVFMT_ALLOW_PARTIAL,
 };
 #endif
 
@@ -130,7 +130,7 @@ AVOutputFormat ff_h263_muxer = {
     .audio_codec       = CODEC_ID_NONE,
     .video_codec       = CODEC_ID_H263,
     .write_packet      = ff_raw_write_packet,
-    .flags= AVFMT_NOTIMESTAMPS,
+    .flags= AVFMT_NOTIMESTAMPS | AVFMT_ALLOW_PARTIAL,
 };
 #endif
 
@@ -166,7 +166,7 @@ AVOutputFormat ff_m4v_muxer = {
     .audio_codec       = CODEC_ID_NONE,
     .video_codec       = CODEC_ID_MPEG4,
     .write_packet      = ff_raw_write_packet,
-    .flags= AVFMT_NOTIMESTAMPS,
+    .flags= AVFMT_NOTIMESTAMPS | AVFMT_ALLOW_PARTIAL,
 };
 #endif
 
@@ -228,7 +228,7 @@ AVOutputFormat ff_mpeg1video_muxer = {
     .audio_codec       = CODEC_ID_NONE,
     .video_codec       = CODEC_ID_MPEG1VIDEO,
     .write_packet      = ff_raw_write_packet,
-    .flags= AVFMT_NOTIMESTAMPS,
+    .flags= AVFMT_NOTIMESTAMPS | AVFMT_ALLOW_PARTIAL,
 };
 #endif
 
@@ -240,7 +240,7 @@ AVOutputFormat ff_mpeg2video_muxer = {
     .audio_codec       = CODEC_ID_NONE,
     .video_codec       = CODEC_ID_MPEG2VIDEO,
     .write_packet      = ff_raw_write_packet,
-    .flags= AVFMT_NOTIMESTAMPS,
+    .flags= AVFMT_NOTIMESTAMPS | AVFMT_ALLOW_PARTIAL,
 };
 #endif
 
@@ -233,7 +233,7 @@ void ff_rtp_send_data(AVFormatContext *s1, const uint8_t *buf1, int len, int m)
 
     /* build the RTP header */
     avio_w8(s1->pb, (RTP_VERSION << 6));
-    avio_w8(s1->pb, (s->payload_type & 0x7f) | ((m & 0x01) << 7));
+    avio_w8(s1->pb, (s->payload_type & 0x7f) | ((m & !s->partial & 0x01) << 7));
     avio_wb16(s1->pb, s->seq);
     avio_wb32(s1->pb, s->timestamp);
     avio_wb32(s1->pb, s->ssrc);
@@ -389,6 +389,7 @@ static int rtp_write_packet(AVFormatContext *s1, AVPacket *pkt)
         s->first_packet = 0;
     }
     s->cur_timestamp = s->base_timestamp + pkt->pts;
+    s->partial = !!(pkt->flags & AV_PKT_FLAG_PARTIAL);
 
     switch(st->codec->codec_id) {
     case CODEC_ID_PCM_MULAW:
@@ -470,5 +471,6 @@ AVOutputFormat ff_rtp_muxer = {
     .write_header      = rtp_write_header,
     .write_packet      = rtp_write_packet,
     .write_trailer     = rtp_write_trailer,
+    .flags             = AVFMT_ALLOW_PARTIAL,
     .priv_class = &rtp_muxer_class,
 };
@@ -59,6 +59,20 @@ struct RTPMuxContext {
     int nal_length_size;
 
     int flags;
+
+    /**
+     * The packet being sent has AV_PKT_FLAG_PARTIAL set, the marker bit
+     * is only set at the end of the last packet of a frame.
+     */
+    int partial;
+
+    /**
+     * Picture coding type and temporal reference of the current MPEG-1/2
+     * picture, the picture header is only present in the first of the
+     * partial packets of a frame.
+     */
+    int frame_type;
+    int temporal_reference;
 };
 
 typedef struct RTPMuxContext RTPMuxContext;
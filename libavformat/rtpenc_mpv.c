@@ -25,20 +25,32 @@
 #include "rtpenc.h"
 
 /* NOTE: a single frame must be passed with sequence header if
-   needed. XXX: use slices. */
+   needed, or a frame split into partial packets at slice boundaries. */
 void ff_rtp_send_mpegvideo(AVFormatContext *s1, const uint8_t *buf1, int size)
 {
     RTPMuxContext *s = s1->priv_data;
     int len, h, max_packet_size;
     uint8_t *q;
-    const uint8_t *end = buf1 + size;
-    int begin_of_slice, end_of_slice, frame_type, temporal_reference;
+    const uint8_t *r, *end = buf1 + size;
+    int begin_of_slice, end_of_slice, start_code;
 
     max_packet_size = s->max_payload_size;
     begin_of_slice = 1;
     end_of_slice = 0;
-    frame_type = 0;
-    temporal_reference = 0;
+
+    /* parse the picture header, it precedes the first slice */
+    r = buf1;
+    while (r < end) {
+        start_code = -1;
+        r = ff_find_start_code(r, end, &start_code);
+        if (start_code == 0x100 && end - r >= 2) {
+            s->frame_type         = (r[1] & 0x38) >> 3;
+            s->temporal_reference = (int)r[0] << 2 | r[1] >> 6;
+            break;
+        }
+        if (start_code >= 0x101 && start_code <= 0x1AF)
+            break;
+    }
 
     while (size > 0) {
         int begin_of_sequence;
@@ -50,8 +62,7 @@ void ff_rtp_send_mpegvideo(AVFormatContext *s1, const uint8_t *buf1, int size)
             len = size;
             end_of_slice = 1;
         } else {
-            const uint8_t *r, *r1;
-            int start_code;
+            const uint8_t *r1;
 
             r1 = buf1;
             while (1) {
@@ -59,10 +70,6 @@ void ff_rtp_send_mpegvideo(AVFormatContext *s1, const uint8_t *buf1, int size)
                 r = ff_find_start_code(r1, end, &start_code);
                 if((start_code & 0xFFFFFF00) == 0x100) {
                     /* New start code found */
-                    if (start_code == 0x100) {
-                        frame_type = (r[1] & 0x38) >> 3;
-                        temporal_reference = (int)r[0] << 2 | r[1] >> 6;
-                    }
                     if (start_code == 0x1B8) {
                         begin_of_sequence = 1;
                     }
@@ -90,11 +97,11 @@ void ff_rtp_send_mpegvideo(AVFormatContext *s1, const uint8_t *buf1, int size)
         }
 
         h = 0;
-        h |= temporal_reference << 16;
+        h |= s->temporal_reference << 16;
         h |= begin_of_sequence << 13;
         h |= begin_of_slice << 12;
         h |= end_of_slice << 11;
-        h |= frame_type << 8;
+        h |= s->frame_type << 8;
 
         q = s->buf;
         *q++ = h >> 24;
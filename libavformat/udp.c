@@ -29,7 +29,7 @@
 #include "avformat.h"
 #include "avio_internal.h"
 #include "libavutil/parseutils.h"
-#include "libavutil/fifo.h"
+#include "libavutil/spsc_fifo.h"
 #include <unistd.h>
 #include "internal.h"
 #include "network.h"
@@ -60,10 +60,10 @@ typedef struct {
 
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
-    AVFifoBuffer *fifo;
-    int circular_buffer_error;
+    FFSPSCFifo *fifo;
 #if HAVE_PTHREADS
     pthread_t circular_buffer_thread;
+    volatile int circular_buffer_exit;
 #endif
 } UDPContext;
 
@@ -312,65 +312,76 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if HAVE_PTHREADS
 static void *circular_buffer_task( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
     fd_set rfds;
     struct timeval tv;
+    uint8_t tmp[UDP_MAX_PKT_SIZE];
 
-    for(;;) {
+    while (!s->circular_buffer_exit) {
+        uint8_t *dst;
         int left;
         int ret;
         int len;
 
         if (url_interrupt_cb()) {
-            s->circular_buffer_error = EINTR;
+            ff_spsc_fifo_close(s->fifo, AVERROR(EINTR));
             return NULL;
         }
 
         FD_ZERO(&rfds);
         FD_SET(s->udp_fd, &rfds);
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
         ret = select(s->udp_fd + 1, &rfds, NULL, NULL, &tv);
         if (ret < 0) {
             if (ff_neterrno() == AVERROR(EINTR))
                 continue;
-            s->circular_buffer_error = EIO;
+            ff_spsc_fifo_close(s->fifo, AVERROR(EIO));
             return NULL;
         }
 
         if (!(ret > 0 && FD_ISSET(s->udp_fd, &rfds)))
             continue;
 
-        /* How much do we have left to the end of the buffer */
-        /* Whats the minimum we can read so that we dont comletely fill the buffer */
-        left = av_fifo_space(s->fifo);
-        left = FFMIN(left, s->fifo->end - s->fifo->wptr);
-
-        /* No Space left, error, what do we do now */
-        if( !left) {
-            av_log(h, AV_LOG_ERROR, "circular_buffer: OVERRUN\n");
-            s->circular_buffer_error = EIO;
-            return NULL;
+        /* Receive in place if a maximum sized datagram fits before the end
+         * of the buffer, otherwise go through tmp so that the datagram is
+         * not truncated and can wrap around */
+        dst = ff_spsc_fifo_write_ptr(s->fifo, &left);
+        if (left < UDP_MAX_PKT_SIZE) {
+            dst  = tmp;
+            left = sizeof(tmp);
         }
 
-        len = recv(s->udp_fd, s->fifo->wptr, left, 0);
+        len = recv(s->udp_fd, dst, left, 0);
         if (len < 0) {
             if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = EIO;
+                ff_spsc_fifo_close(s->fifo, AVERROR(EIO));
                 return NULL;
             }
+            continue;
+        }
+
+        if (dst != tmp) {
+            ff_spsc_fifo_write_commit(s->fifo, len);
+        } else {
+            /* check first, a datagram must not be queued partially */
+            if (ff_spsc_fifo_space(s->fifo) < len) {
+                /* No Space left, error, what do we do now */
+                av_log(h, AV_LOG_ERROR, "circular_buffer: OVERRUN\n");
+                ff_spsc_fifo_close(s->fifo, AVERROR(EIO));
+                return NULL;
+            }
+            ff_spsc_fifo_write(s->fifo, tmp, len);
         }
-        s->fifo->wptr += len;
-        if (s->fifo->wptr >= s->fifo->end)
-            s->fifo->wptr = s->fifo->buffer;
-        s->fifo->wndx += len;
     }
 
     return NULL;
 }
+#endif
 
 /* put it in UDP context */
 /* return non zero if error */
@@ -514,7 +525,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 #if HAVE_PTHREADS
     if (!is_output && s->circular_buffer_size) {
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        s->fifo = ff_spsc_fifo_alloc(s->circular_buffer_size);
+        if (!s->fifo)
+            goto fail;
         if (pthread_create(&s->circular_buffer_thread, NULL, circular_buffer_task, h)) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed\n");
             goto fail;
@@ -526,7 +539,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
-    av_fifo_free(s->fifo);
+    ff_spsc_fifo_freep(&s->fifo);
     av_free(s);
     return AVERROR(EIO);
 }
@@ -535,31 +548,19 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 {
     UDPContext *s = h->priv_data;
     int ret;
-    int avail;
-    fd_set rfds;
-    struct timeval tv;
 
     if (s->fifo) {
-
         do {
-            avail = av_fifo_size(s->fifo);
-            if (avail) { // >=size) {
-
-                // Maximum amount available
-                size = FFMIN( avail, size);
-                av_fifo_generic_read(s->fifo, buf, size, NULL);
-                return size;
-            }
-            else {
-                FD_ZERO(&rfds);
-                FD_SET(s->udp_fd, &rfds);
-                tv.tv_sec = 1;
-                tv.tv_usec = 0;
-                ret = select(s->udp_fd + 1, &rfds, NULL, NULL, &tv);
-                if (ret<0)
-                    return ret;
-            }
-        } while( 1);
+            ret = ff_spsc_fifo_wait(s->fifo, h->flags & AVIO_FLAG_NONBLOCK ? 0 : 100000);
+            if (ret < 0)
+                return ret;
+            if (ret)
+                return ff_spsc_fifo_read(s->fifo, buf, size);
+            if (h->flags & AVIO_FLAG_NONBLOCK)
+                return AVERROR(EAGAIN);
+            if (url_interrupt_cb())
+                return AVERROR(EINTR);
+        } while (1);
     }
 
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
@@ -597,10 +598,16 @@ static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
 
+#if HAVE_PTHREADS
+    if (s->fifo) {
+        s->circular_buffer_exit = 1;
+        pthread_join(s->circular_buffer_thread, NULL);
+    }
+#endif
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr);
     closesocket(s->udp_fd);
-    av_fifo_free(s->fifo);
+    ff_spsc_fifo_freep(&s->fifo);
     av_free(s);
     return 0;
 }
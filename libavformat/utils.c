@@ -267,7 +267,7 @@ AVInputFormat *av_find_input_format(const char *short_name)
 
 int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
-    int ret= av_new_packet(pkt, size);
+    int ret= ff_packet_pool_new_packet(pkt, size);
 
     if(ret<0)
         return ret;
@@ -1311,8 +1311,8 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
                     return ret;
             }
 
-            if(av_dup_packet(add_to_pktbuf(&s->packet_buffer, pkt,
-                                           &s->packet_buffer_end)) < 0)
+            if(ff_packet_pool_dup_packet(add_to_pktbuf(&s->packet_buffer, pkt,
+                                                       &s->packet_buffer_end)) < 0)
                 return AVERROR(ENOMEM);
         }else{
             assert(!s->packet_buffer);
@@ -2389,7 +2389,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         }
 
         pkt= add_to_pktbuf(&ic->packet_buffer, &pkt1, &ic->packet_buffer_end);
-        if ((ret = av_dup_packet(pkt)) < 0)
+        if ((ret = ff_packet_pool_dup_packet(pkt)) < 0)
             goto find_stream_info_err;
 
         read_size += pkt->size;
@@ -2671,6 +2671,12 @@ void avformat_free_context(AVFormatContext *s)
             av_parser_close(st->parser);
             av_free_packet(&st->cur_pkt);
         }
+        while (st->first_in_packet_buffer) {
+            AVPacketList *pktl = st->first_in_packet_buffer;
+            st->first_in_packet_buffer = pktl->next;
+            av_free_packet(&pktl->pkt);
+            av_free(pktl);
+        }
         av_dict_free(&st->metadata);
         av_free(st->index_entries);
         av_free(st->codec->extradata);
@@ -2694,6 +2700,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_freep(&s->streams);
+    av_freep(&s->interleave_heap);
     av_free(s);
 }
 
@@ -3076,6 +3083,13 @@ static int compute_pkt_fields2(AVFormatContext *s, AVStream *st, AVPacket *pkt){
 /*    if(pkt->pts == AV_NOPTS_VALUE && pkt->dts == AV_NOPTS_VALUE)
         return AVERROR(EINVAL);*/
 
+    if (st->partial_pkt) {
+        /* the packet continues the frame of the previous one */
+        pkt->dts = st->cur_dts;
+        st->partial_pkt = !!(pkt->flags & AV_PKT_FLAG_PARTIAL);
+        return 0;
+    }
+
     /* duration field */
     if (pkt->duration == 0) {
         compute_frame_duration(&num, &den, st, NULL, pkt);
@@ -3119,6 +3133,7 @@ static int compute_pkt_fields2(AVFormatContext *s, AVStream *st, AVPacket *pkt){
 //    av_log(s, AV_LOG_DEBUG, "av_write_frame: pts2:%"PRId64" dts2:%"PRId64"\n", pkt->pts, pkt->dts);
     st->cur_dts= pkt->dts;
     st->pts.val= pkt->dts;
+    st->partial_pkt = !!(pkt->flags & AV_PKT_FLAG_PARTIAL);
 
     /* update pts */
     switch (st->codec->codec_type) {
@@ -3141,16 +3156,31 @@ static int compute_pkt_fields2(AVFormatContext *s, AVStream *st, AVPacket *pkt){
     return 0;
 }
 
+static int check_partial_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    if ((pkt->flags & AV_PKT_FLAG_PARTIAL) && !(s->oformat->flags & AVFMT_ALLOW_PARTIAL)) {
+        av_log(s, AV_LOG_ERROR, "Partial packets are not supported by the %s muxer\n",
+               s->oformat->name);
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
 int av_write_frame(AVFormatContext *s, AVPacket *pkt)
 {
-    int ret = compute_pkt_fields2(s, s->streams[pkt->stream_index], pkt);
+    int ret = check_partial_packet(s, pkt);
+
+    if (ret < 0)
+        return ret;
+
+    ret = compute_pkt_fields2(s, s->streams[pkt->stream_index], pkt);
 
     if(ret<0 && !(s->oformat->flags & AVFMT_NOTIMESTAMPS))
         return ret;
 
     ret= s->oformat->write_packet(s, pkt);
 
-    if (ret >= 0)
+    if (ret >= 0 && !(pkt->flags & AV_PKT_FLAG_PARTIAL))
         s->streams[pkt->stream_index]->nb_frames++;
     return ret;
 }
@@ -3163,7 +3193,7 @@ void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
     this_pktl = av_mallocz(sizeof(AVPacketList));
     this_pktl->pkt= *pkt;
     pkt->destruct= NULL;             // do not free original but only the copy
-    av_dup_packet(&this_pktl->pkt);  // duplicate the packet if it uses non-alloced memory
+    ff_packet_pool_dup_packet(&this_pktl->pkt);  // duplicate the packet if it uses non-alloced memory
 
     if(s->streams[pkt->stream_index]->last_in_packet_buffer){
         next_point = &(s->streams[pkt->stream_index]->last_in_packet_buffer->next);
@@ -3191,16 +3221,96 @@ next_non_null:
     *next_point= this_pktl;
 }
 
-static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacket *pkt)
+/**
+ * Packet queued by av_interleave_packet_per_dts(), the sequence number
+ * keeps packets with equal dts in the order they were queued.
+ */
+typedef struct InterleavePacketList {
+    AVPacketList list;
+    int64_t seq;
+} InterleavePacketList;
+
+/**
+ * Return 1 if the first queued packet of stream a is to be muxed before
+ * the one of stream b.
+ */
+static int interleave_heap_less(AVFormatContext *s, int a, int b)
 {
-    AVStream *st = s->streams[ pkt ->stream_index];
-    AVStream *st2= s->streams[ next->stream_index];
-    int comp = av_compare_ts(next->dts, st2->time_base, pkt->dts,
-                             st->time_base);
+    InterleavePacketList *pa = (InterleavePacketList *)s->streams[a]->first_in_packet_buffer;
+    InterleavePacketList *pb = (InterleavePacketList *)s->streams[b]->first_in_packet_buffer;
+    int comp = av_compare_ts(pa->list.pkt.dts, s->streams[a]->time_base,
+                             pb->list.pkt.dts, s->streams[b]->time_base);
 
     if (comp == 0)
-        return pkt->stream_index < next->stream_index;
-    return comp > 0;
+        return pa->seq < pb->seq;
+    return comp < 0;
+}
+
+static void interleave_heap_push(AVFormatContext *s, int stream_index)
+{
+    int *heap = s->interleave_heap;
+    int i = s->nb_interleave_heap++;
+
+    while (i && interleave_heap_less(s, stream_index, heap[(i - 1) >> 1])) {
+        heap[i] = heap[(i - 1) >> 1];
+        i = (i - 1) >> 1;
+    }
+    heap[i] = stream_index;
+}
+
+static void interleave_heap_sift_down(AVFormatContext *s, int i)
+{
+    int *heap = s->interleave_heap;
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->nb_interleave_heap)
+            break;
+        if (child + 1 < s->nb_interleave_heap &&
+            interleave_heap_less(s, heap[child + 1], heap[child]))
+            child++;
+        if (!interleave_heap_less(s, heap[child], heap[i]))
+            break;
+        FFSWAP(int, heap[i], heap[child]);
+        i = child;
+    }
+}
+
+/**
+ * Append pkt to the queue of its stream. A stream whose queue was empty
+ * enters the heap, the position of the others does not change as their
+ * first packet stays the same.
+ */
+static int interleave_add_packet_per_dts(AVFormatContext *s, AVPacket *pkt)
+{
+    AVStream *st = s->streams[pkt->stream_index];
+    InterleavePacketList *ipktl;
+    AVPacketList *this_pktl;
+    int *heap;
+
+    heap = av_fast_realloc(s->interleave_heap, &s->interleave_heap_size,
+                           s->nb_streams * sizeof(*heap));
+    if (!heap)
+        return AVERROR(ENOMEM);
+    s->interleave_heap = heap;
+
+    ipktl = av_mallocz(sizeof(*ipktl));
+    if (!ipktl)
+        return AVERROR(ENOMEM);
+    ipktl->seq = s->interleave_seq++;
+    this_pktl = &ipktl->list;
+    this_pktl->pkt= *pkt;
+    pkt->destruct= NULL;             // do not free original but only the copy
+    ff_packet_pool_dup_packet(&this_pktl->pkt);  // duplicate the packet if it uses non-alloced memory
+
+    if (st->last_in_packet_buffer) {
+        st->last_in_packet_buffer->next = this_pktl;
+    } else {
+        st->first_in_packet_buffer = this_pktl;
+        interleave_heap_push(s, pkt->stream_index);
+    }
+    st->last_in_packet_buffer = this_pktl;
+    return 0;
 }
 
 int av_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush){
@@ -3209,28 +3319,48 @@ int av_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out, AVPacket *pk
     int i;
 
     if(pkt){
-        ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts);
+        int ret = interleave_add_packet_per_dts(s, pkt);
+        if (ret < 0)
+            return ret;
     }
 
-    for(i=0; i < s->nb_streams; i++)
-        stream_count+= !!s->streams[i]->last_in_packet_buffer;
+    /* packets added by ff_interleave_add_packet() with a custom order */
+    if (s->packet_buffer) {
+        for(i=0; i < s->nb_streams; i++)
+            stream_count+= !!s->streams[i]->last_in_packet_buffer;
 
-    if(stream_count && (s->nb_streams == stream_count || flush)){
-        pktl= s->packet_buffer;
-        *out= pktl->pkt;
+        if(s->nb_streams == stream_count || flush){
+            pktl= s->packet_buffer;
+            *out= pktl->pkt;
+
+            s->packet_buffer= pktl->next;
+            if(!s->packet_buffer)
+                s->packet_buffer_end= NULL;
+
+            if(s->streams[out->stream_index]->last_in_packet_buffer == pktl)
+                s->streams[out->stream_index]->last_in_packet_buffer= NULL;
+            av_freep(&pktl);
+            return 1;
+        }
+    } else if (s->nb_interleave_heap &&
+               (s->nb_streams == s->nb_interleave_heap || flush)) {
+        AVStream *st = s->streams[s->interleave_heap[0]];
 
-        s->packet_buffer= pktl->next;
-        if(!s->packet_buffer)
-            s->packet_buffer_end= NULL;
+        pktl = st->first_in_packet_buffer;
+        *out = pktl->pkt;
 
-        if(s->streams[out->stream_index]->last_in_packet_buffer == pktl)
-            s->streams[out->stream_index]->last_in_packet_buffer= NULL;
+        st->first_in_packet_buffer = pktl->next;
+        if (!st->first_in_packet_buffer) {
+            st->last_in_packet_buffer = NULL;
+            s->interleave_heap[0] = s->interleave_heap[--s->nb_interleave_heap];
+        }
+        interleave_heap_sift_down(s, 0);
         av_freep(&pktl);
         return 1;
-    }else{
-        av_init_packet(out);
-        return 0;
     }
+
+    av_init_packet(out);
+    return 0;
 }
 
 /**
@@ -3259,6 +3389,8 @@ int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt){
 
     av_dlog(s, "av_interleaved_write_frame size:%d dts:%"PRId64" pts:%"PRId64"\n",
             pkt->size, pkt->dts, pkt->pts);
+    if((ret = check_partial_packet(s, pkt)) < 0)
+        return ret;
     if((ret = compute_pkt_fields2(s, st, pkt)) < 0 && !(s->oformat->flags & AVFMT_NOTIMESTAMPS))
         return ret;
 
@@ -3272,7 +3404,7 @@ int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt){
             return ret;
 
         ret= s->oformat->write_packet(s, &opkt);
-        if (ret >= 0)
+        if (ret >= 0 && !(opkt.flags & AV_PKT_FLAG_PARTIAL))
             s->streams[opkt.stream_index]->nb_frames++;
 
         av_free_packet(&opkt);
@@ -3298,7 +3430,7 @@ int av_write_trailer(AVFormatContext *s)
             break;
 
         ret= s->oformat->write_packet(s, &pkt);
-        if (ret >= 0)
+        if (ret >= 0 && !(pkt.flags & AV_PKT_FLAG_PARTIAL))
             s->streams[pkt.stream_index]->nb_frames++;
 
         av_free_packet(&pkt);
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2011 The FFmpeg project
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "atomic.h"
+
+#if !HAVE_SYNC_VAL_COMPARE_AND_SWAP
+
+#if HAVE_PTHREADS
+
+#include <pthread.h>
+
+static pthread_mutex_t atomic_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define ATOMIC_LOCK()   pthread_mutex_lock(&atomic_lock)
+#define ATOMIC_UNLOCK() pthread_mutex_unlock(&atomic_lock)
+
+#elif HAVE_W32THREADS
+
+#include <windows.h>
+
+static volatile LONG atomic_lock;
+
+#define ATOMIC_LOCK()   while (InterlockedExchange(&atomic_lock, 1)) Sleep(0)
+#define ATOMIC_UNLOCK() InterlockedExchange(&atomic_lock, 0)
+
+#else
+
+/* without threads there is nothing to serialize against */
+#define ATOMIC_LOCK()
+#define ATOMIC_UNLOCK()
+
+#endif
+
+void ff_memory_barrier(void)
+{
+    ATOMIC_LOCK();
+    ATOMIC_UNLOCK();
+}
+
+int ff_atomic_int_get(volatile int *ptr)
+{
+    int res;
+
+    ATOMIC_LOCK();
+    res = *ptr;
+    ATOMIC_UNLOCK();
+    return res;
+}
+
+void ff_atomic_int_set(volatile int *ptr, int val)
+{
+    ATOMIC_LOCK();
+    *ptr = val;
+    ATOMIC_UNLOCK();
+}
+
+int ff_atomic_int_add_and_fetch(volatile int *ptr, int inc)
+{
+    int res;
+
+    ATOMIC_LOCK();
+    *ptr += inc;
+    res = *ptr;
+    ATOMIC_UNLOCK();
+    return res;
+}
+
+int64_t ff_atomic_int64_add_and_fetch(volatile int64_t *ptr, int64_t inc)
+{
+    int64_t res;
+
+    ATOMIC_LOCK();
+    *ptr += inc;
+    res = *ptr;
+    ATOMIC_UNLOCK();
+    return res;
+}
+
+void *ff_atomic_ptr_cas(void * volatile *ptr, void *oldval, void *newval)
+{
+    void *ret;
+
+    ATOMIC_LOCK();
+    ret = *ptr;
+    if (ret == oldval)
+        *ptr = newval;
+    ATOMIC_UNLOCK();
+    return ret;
+}
+
+#endif /* !HAVE_SYNC_VAL_COMPARE_AND_SWAP */
+
+#ifdef TEST
+#include <assert.h>
+#include <stddef.h>
+
+int main(void)
+{
+    volatile int val = 1;
+    volatile int64_t val64 = 1;
+    int res;
+    void * volatile ptr = NULL;
+    int a, b;
+
+    res = ff_atomic_int_add_and_fetch(&val, 1);
+    assert(res == 2);
+    ff_atomic_int_set(&val, 3);
+    res = ff_atomic_int_get(&val);
+    assert(res == 3);
+    assert(ff_atomic_int64_add_and_fetch(&val64, 1LL << 40) == (1LL << 40) + 1);
+
+    assert(ff_atomic_ptr_cas(&ptr, NULL, &a) == NULL);
+    assert(ff_atomic_ptr_cas(&ptr, &b, &b) == &a);
+    assert(ptr == &a);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2011 The FFmpeg project
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * internal atomic operations
+ *
+ * All operations imply a full memory barrier. The compiler builtins are
+ * used when available, otherwise the operations are serialized with a
+ * global mutex.
+ */
+
+#ifndef AVUTIL_ATOMIC_H
+#define AVUTIL_ATOMIC_H
+
+#include <stdint.h>
+#include "config.h"
+
+#if HAVE_SYNC_VAL_COMPARE_AND_SWAP
+
+static inline void ff_memory_barrier(void)
+{
+    __sync_synchronize();
+}
+
+static inline int ff_atomic_int_get(volatile int *ptr)
+{
+    __sync_synchronize();
+    return *ptr;
+}
+
+static inline void ff_atomic_int_set(volatile int *ptr, int val)
+{
+    *ptr = val;
+    __sync_synchronize();
+}
+
+static inline int ff_atomic_int_add_and_fetch(volatile int *ptr, int inc)
+{
+    return __sync_add_and_fetch(ptr, inc);
+}
+
+static inline int64_t ff_atomic_int64_add_and_fetch(volatile int64_t *ptr, int64_t inc)
+{
+    return __sync_add_and_fetch(ptr, inc);
+}
+
+static inline void *ff_atomic_ptr_cas(void * volatile *ptr, void *oldval, void *newval)
+{
+    return __sync_val_compare_and_swap(ptr, oldval, newval);
+}
+
+#else
+
+/**
+ * Issue a full memory barrier.
+ */
+void ff_memory_barrier(void);
+
+/**
+ * Load the current value stored in an atomic integer.
+ */
+int ff_atomic_int_get(volatile int *ptr);
+
+/**
+ * Store a new value in an atomic integer.
+ */
+void ff_atomic_int_set(volatile int *ptr, int val);
+
+/**
+ * Add a value to an atomic integer.
+ *
+ * @return the new value of the atomic integer
+ */
+int ff_atomic_int_add_and_fetch(volatile int *ptr, int inc);
+
+/**
+ * Add a value to an atomic 64-bit integer.
+ *
+ * @return the new value of the atomic integer
+ */
+int64_t ff_atomic_int64_add_and_fetch(volatile int64_t *ptr, int64_t inc);
+
+/**
+ * Atomic pointer compare and swap.
+ *
+ * @param ptr pointer to the pointer to operate on
+ * @param oldval value to compare to *ptr
+ * @param newval value to store in *ptr if it equals oldval
+ * @return the value of *ptr before the comparison
+ */
+void *ff_atomic_ptr_cas(void * volatile *ptr, void *oldval, void *newval);
+
+#endif /* HAVE_SYNC_VAL_COMPARE_AND_SWAP */
+
+#endif /* AVUTIL_ATOMIC_H */
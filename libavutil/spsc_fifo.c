@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2011 The FFmpeg project
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+#include "atomic.h"
+#include "common.h"
+#include "error.h"
+#include "mem.h"
+#include "spsc_fifo.h"
+
+#define CACHE_LINE_SIZE 64
+
+/*
+ * The indices run over [0, 2 * size) so that a full FIFO can be told apart
+ * from an empty one without requiring a power of two size.
+ */
+struct FFSPSCFifo {
+    uint8_t *buffer;
+    int size;
+
+    /* written by the producer only */
+    volatile int windex;
+    volatile int error;
+    uint8_t pad0[CACHE_LINE_SIZE];
+
+    /* written by the consumer only */
+    volatile int rindex;
+    volatile int waiting;
+    uint8_t pad1[CACHE_LINE_SIZE];
+
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+FFSPSCFifo *ff_spsc_fifo_alloc(unsigned int size)
+{
+    FFSPSCFifo *f;
+
+    if (!size || size > INT_MAX / 2)
+        return NULL;
+    f = av_mallocz(sizeof(*f));
+    if (!f)
+        return NULL;
+    f->buffer = av_malloc(size);
+    if (!f->buffer) {
+        av_free(f);
+        return NULL;
+    }
+    f->size = size;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->cond, NULL);
+#endif
+    return f;
+}
+
+void ff_spsc_fifo_freep(FFSPSCFifo **f)
+{
+    if (!*f)
+        return;
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&(*f)->lock);
+    pthread_cond_destroy(&(*f)->cond);
+#endif
+    av_free((*f)->buffer);
+    av_freep(f);
+}
+
+static inline int fifo_fill(FFSPSCFifo *f, int windex, int rindex)
+{
+    int fill = windex - rindex;
+    return fill < 0 ? fill + 2 * f->size : fill;
+}
+
+static inline int fifo_advance(FFSPSCFifo *f, int index, int size)
+{
+    index += size;
+    return index >= 2 * f->size ? index - 2 * f->size : index;
+}
+
+static inline int fifo_pos(FFSPSCFifo *f, int index)
+{
+    return index >= f->size ? index - f->size : index;
+}
+
+int ff_spsc_fifo_size(FFSPSCFifo *f)
+{
+    int fill = fifo_fill(f, f->windex, f->rindex);
+    /* pairs with the barrier in ff_spsc_fifo_write_commit(), the data
+     * must not be read before the index covering it */
+    ff_memory_barrier();
+    return fill;
+}
+
+int ff_spsc_fifo_space(FFSPSCFifo *f)
+{
+    int space = f->size - fifo_fill(f, f->windex, f->rindex);
+    /* pairs with the barrier in ff_spsc_fifo_read(), the space must not
+     * be overwritten before the consumer is done reading it */
+    ff_memory_barrier();
+    return space;
+}
+
+uint8_t *ff_spsc_fifo_write_ptr(FFSPSCFifo *f, int *size)
+{
+    int pos   = fifo_pos(f, f->windex);
+    int space = ff_spsc_fifo_space(f);
+    *size = FFMIN(space, f->size - pos);
+    return f->buffer + pos;
+}
+
+static void fifo_wake(FFSPSCFifo *f)
+{
+#if HAVE_PTHREADS
+    /* the consumer sets waiting before checking the fill level, and the
+     * index was published before this check, so one of both sides is
+     * guaranteed to see the other */
+    if (ff_atomic_int_get(&f->waiting)) {
+        pthread_mutex_lock(&f->lock);
+        pthread_cond_signal(&f->cond);
+        pthread_mutex_unlock(&f->lock);
+    }
+#endif
+}
+
+void ff_spsc_fifo_write_commit(FFSPSCFifo *f, int size)
+{
+    ff_memory_barrier();
+    f->windex = fifo_advance(f, f->windex, size);
+    fifo_wake(f);
+}
+
+int ff_spsc_fifo_write(FFSPSCFifo *f, const uint8_t *buf, int size)
+{
+    int written = 0;
+    int space   = ff_spsc_fifo_space(f);
+
+    size = FFMIN(size, space);
+    while (written < size) {
+        int pos = fifo_pos(f, fifo_advance(f, f->windex, written));
+        int len = FFMIN(size - written, f->size - pos);
+        memcpy(f->buffer + pos, buf + written, len);
+        written += len;
+    }
+    if (written)
+        ff_spsc_fifo_write_commit(f, written);
+    return written;
+}
+
+void ff_spsc_fifo_close(FFSPSCFifo *f, int error)
+{
+    f->error = error ? error : AVERROR_EOF;
+    ff_memory_barrier();
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&f->lock);
+    pthread_cond_signal(&f->cond);
+    pthread_mutex_unlock(&f->lock);
+#endif
+}
+
+int ff_spsc_fifo_read(FFSPSCFifo *f, uint8_t *buf, int size)
+{
+    int done  = 0;
+    int avail = ff_spsc_fifo_size(f);
+
+    size = FFMIN(size, avail);
+    while (done < size) {
+        int pos = fifo_pos(f, fifo_advance(f, f->rindex, done));
+        int len = FFMIN(size - done, f->size - pos);
+        memcpy(buf + done, f->buffer + pos, len);
+        done += len;
+    }
+    ff_memory_barrier();
+    f->rindex = fifo_advance(f, f->rindex, done);
+    return done;
+}
+
+int ff_spsc_fifo_wait(FFSPSCFifo *f, int64_t timeout)
+{
+    int avail = ff_spsc_fifo_size(f);
+
+#if HAVE_PTHREADS
+    if (!avail && !f->error && timeout > 0) {
+        struct timeval tv;
+        struct timespec ts;
+        int64_t t;
+
+        gettimeofday(&tv, NULL);
+        t = tv.tv_sec * 1000000LL + tv.tv_usec + timeout;
+        ts.tv_sec  = t / 1000000;
+        ts.tv_nsec = t % 1000000 * 1000;
+
+        pthread_mutex_lock(&f->lock);
+        ff_atomic_int_set(&f->waiting, 1);
+        while (!(avail = ff_spsc_fifo_size(f)) && !f->error)
+            if (pthread_cond_timedwait(&f->cond, &f->lock, &ts))
+                break;
+        ff_atomic_int_set(&f->waiting, 0);
+        pthread_mutex_unlock(&f->lock);
+    }
+#endif
+
+    if (!avail && f->error) {
+        /* data may have been committed right before the close */
+        avail = ff_spsc_fifo_size(f);
+        if (!avail)
+            return f->error;
+    }
+    return avail;
+}
+
+#ifdef TEST
+#undef printf
+
+#define TOTAL (1 << 22)
+
+static void *producer(void *arg)
+{
+    FFSPSCFifo *f = arg;
+    uint8_t buf[1000];
+    int i, n = 0;
+
+    while (n < TOTAL) {
+        int len = FFMIN(sizeof(buf), TOTAL - n);
+        if (n & 1) {
+            uint8_t *ptr = ff_spsc_fifo_write_ptr(f, &len);
+            len = FFMIN(len, TOTAL - n);
+            for (i = 0; i < len; i++)
+                ptr[i] = (n + i) * 7;
+            ff_spsc_fifo_write_commit(f, len);
+        } else {
+            for (i = 0; i < len; i++)
+                buf[i] = (n + i) * 7;
+            len = ff_spsc_fifo_write(f, buf, len);
+        }
+        n += len;
+    }
+    ff_spsc_fifo_close(f, 0);
+    return NULL;
+}
+
+int main(void)
+{
+    FFSPSCFifo *f;
+    uint8_t buf[777];
+    int i, n = 0, ret;
+#if HAVE_PTHREADS
+    pthread_t thread;
+
+    f = ff_spsc_fifo_alloc(4093);
+    pthread_create(&thread, NULL, producer, f);
+#else
+    f = ff_spsc_fifo_alloc(TOTAL);
+    producer(f);
+#endif
+
+    while ((ret = ff_spsc_fifo_wait(f, 1000000)) >= 0) {
+        ret = ff_spsc_fifo_read(f, buf, sizeof(buf));
+        for (i = 0; i < ret; i++) {
+            if (buf[i] != (uint8_t)((n + i) * 7)) {
+                printf("mismatch at byte %d\n", n + i);
+                return 1;
+            }
+        }
+        n += ret;
+    }
+#if HAVE_PTHREADS
+    pthread_join(thread, NULL);
+#endif
+    printf("read %d bytes, %s\n", n, ret == AVERROR_EOF ? "eof" : "error");
+    ff_spsc_fifo_freep(&f);
+    return n != TOTAL;
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2011 The FFmpeg project
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * lock-free single producer, single consumer byte FIFO
+ *
+ * Unlike AVFifoBuffer, one thread may write to the FIFO while another one
+ * reads from it without any external locking. The read and write indices
+ * are only ever modified by their owning thread and live in distinct cache
+ * lines. A mutex and condition variable are only touched when the consumer
+ * actually has to sleep waiting for data.
+ */
+
+#ifndef AVUTIL_SPSC_FIFO_H
+#define AVUTIL_SPSC_FIFO_H
+
+#include <stdint.h>
+
+typedef struct FFSPSCFifo FFSPSCFifo;
+
+/**
+ * Allocate a FIFO able to hold size bytes.
+ * @return the FIFO or NULL in case of memory allocation failure
+ */
+FFSPSCFifo *ff_spsc_fifo_alloc(unsigned int size);
+
+/**
+ * Free a FIFO and set *f to NULL.
+ * Neither the producer nor the consumer may access it any more.
+ */
+void ff_spsc_fifo_freep(FFSPSCFifo **f);
+
+/**
+ * Return the number of bytes which can be read from the FIFO.
+ * Only meaningful for the consumer, the producer may add data at any time.
+ */
+int ff_spsc_fifo_size(FFSPSCFifo *f);
+
+/**
+ * Return the number of bytes which can be written to the FIFO.
+ * Only meaningful for the producer, the consumer may drain data at any time.
+ */
+int ff_spsc_fifo_space(FFSPSCFifo *f);
+
+/**
+ * Write up to size bytes to the FIFO, waking up a waiting consumer.
+ * Producer side.
+ * @return the number of bytes written, less than size if the FIFO is full
+ */
+int ff_spsc_fifo_write(FFSPSCFifo *f, const uint8_t *buf, int size);
+
+/**
+ * Get a pointer to the contiguous free space at the write position, so
+ * that data can be produced in place, e.g. by recv(). Producer side.
+ * @param size set to the number of bytes which can be written at the
+ *             returned position
+ */
+uint8_t *ff_spsc_fifo_write_ptr(FFSPSCFifo *f, int *size);
+
+/**
+ * Make size bytes written at ff_spsc_fifo_write_ptr() available to the
+ * consumer and wake it up if it is waiting. Producer side.
+ */
+void ff_spsc_fifo_write_commit(FFSPSCFifo *f, int size);
+
+/**
+ * Signal the consumer that no more data will be written, e.g. because
+ * of an error. Producer side.
+ * @param error the error code (<= 0) ff_spsc_fifo_wait() returns once
+ *              the FIFO has been drained
+ */
+void ff_spsc_fifo_close(FFSPSCFifo *f, int error);
+
+/**
+ * Read up to size bytes from the FIFO. Consumer side.
+ * @return the number of bytes read, less than size if the FIFO held less
+ */
+int ff_spsc_fifo_read(FFSPSCFifo *f, uint8_t *buf, int size);
+
+/**
+ * Wait until data is available in the FIFO. Consumer side.
+ * @param timeout maximum time to wait in microseconds
+ * @return the number of bytes which can be read, 0 on timeout or the
+ *         error passed to ff_spsc_fifo_close() if the FIFO is closed and
+ *         empty
+ */
+int ff_spsc_fifo_wait(FFSPSCFifo *f, int64_t timeout);
+
+#endif /* AVUTIL_SPSC_FIFO_H */
@@ -0,0 +1,113 @@
+/*
+ * Runtime switchable timer probes
+ * Copyright (c) 2011 The FFmpeg project
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include "atomic.h"
+#include "common.h"
+#include "log.h"
+#include "timer.h"
+
+int ff_timer_probes_enabled;
+
+static FFTimerProbe * volatile probe_list;
+
+void ff_timer_probes_enable(int enable)
+{
+    ff_timer_probes_enabled = enable;
+}
+
+void ff_timer_probe_register(FFTimerProbe *probe)
+{
+    FFTimerProbe *head;
+
+    if (ff_atomic_int_add_and_fetch(&probe->registered, 1) != 1)
+        return;
+    do {
+        head        = probe_list;
+        probe->next = head;
+    } while (ff_atomic_ptr_cas((void * volatile *)&probe_list, head, probe) != head);
+}
+
+void ff_timer_probe_add(FFTimerProbe *probe, uint64_t cycles)
+{
+    FFTimerProbeShard *shard;
+    uintptr_t stack = (uintptr_t)&shard;
+    int bucket;
+
+    if (!probe->registered)
+        ff_timer_probe_register(probe);
+
+    /* distinct threads run on distinct stacks, hash the stack address to
+     * keep them on distinct shards most of the time */
+    shard  = &probe->shard[((uint32_t)(stack >> 16) * 2654435761U) >> 29];
+    bucket = cycles >> 31 ? 31 : av_log2(cycles);
+
+    ff_atomic_int64_add_and_fetch(&shard->calls, 1);
+    ff_atomic_int64_add_and_fetch(&shard->cycles, cycles);
+    ff_atomic_int64_add_and_fetch(&shard->histogram[bucket], 1);
+}
+
+void ff_timer_probes_dump(void *avcl, int level)
+{
+    FFTimerProbe *probe;
+    int i, j;
+
+    for (probe = probe_list; probe; probe = probe->next) {
+        FFTimerProbeShard sum = { 0 };
+        int64_t count = 0;
+        int p50 = 0, p90 = 0, p99 = 0;
+
+        for (i = 0; i < FF_TIMER_PROBE_SHARDS; i++) {
+            sum.calls  += probe->shard[i].calls;
+            sum.cycles += probe->shard[i].cycles;
+            for (j = 0; j < FF_TIMER_PROBE_BUCKETS; j++)
+                sum.histogram[j] += probe->shard[i].histogram[j];
+        }
+        if (!sum.calls) {
+            av_log(avcl, level, "%s: 0 runs\n", probe->name);
+            continue;
+        }
+        for (j = 0; j < FF_TIMER_PROBE_BUCKETS; j++) {
+            count += sum.histogram[j];
+            if (count * 2   <= sum.calls) p50 = j + 1;
+            if (count * 10  <= sum.calls * 9)  p90 = j + 1;
+            if (count * 100 <= sum.calls * 99) p99 = j + 1;
+        }
+
+        av_log(avcl, level, "%s: %"PRId64" runs, %"PRId64" cycles, %"PRId64" cycles/run, "
+               "p50 < %"PRIu64" p90 < %"PRIu64" p99 < %"PRIu64" cycles\n",
+               probe->name, sum.calls, sum.cycles, sum.cycles / sum.calls,
+               UINT64_C(2) << p50, UINT64_C(2) << p90, UINT64_C(2) << p99);
+        for (j = 0; j < FF_TIMER_PROBE_BUCKETS; j++)
+            if (sum.histogram[j])
+                av_log(avcl, level, "    [%10"PRIu64", %10"PRIu64"): %"PRId64"\n",
+                       j ? UINT64_C(1) << j : 0, UINT64_C(2) << j, sum.histogram[j]);
+    }
+}
+
+void ff_timer_probes_reset(void)
+{
+    FFTimerProbe *probe;
+
+    for (probe = probe_list; probe; probe = probe->next)
+        memset(probe->shard, 0, sizeof(probe->shard));
+}
@@ -70,4 +70,94 @@ tend= AV_READ_TIME();\
 #define STOP_TIMER(id) {}
 #endif
 
+/**
+ * Runtime switchable timer probes.
+ *
+ * Unlike START_TIMER/STOP_TIMER, probes can be left compiled in around hot
+ * code: while probes are disabled (the default) they cost a single load and
+ * branch. Once enabled with ff_timer_probes_enable(), every run is counted
+ * into one of several per-probe shards, picked from the calling thread's
+ * stack address, with atomic adds, so slice and frame threads can be
+ * profiled together. The totals and a log2 histogram of the cycle counts
+ * are printed by ff_timer_probes_dump().
+ *
+ * FF_TIMER_PROBE_START() declares the start timestamp, so it has to be
+ * the last declaration of its block, before any statement.
+ *
+ * Usage:
+ * @code
+ * FF_TIMER_PROBE(foo_probe, "foo");
+ *
+ * void foo(void)
+ * {
+ *     int x;
+ *     FF_TIMER_PROBE_START(foo_probe);
+ *     ...
+ *     FF_TIMER_PROBE_STOP(foo_probe);
+ * }
+ * @endcode
+ */
+#define FF_TIMER_PROBE_SHARDS  8
+#define FF_TIMER_PROBE_BUCKETS 32
+
+typedef struct FFTimerProbeShard {
+    int64_t calls;
+    int64_t cycles;
+    /** histogram[i] counts the runs that took [2^i, 2^(i+1)) cycles */
+    int64_t histogram[FF_TIMER_PROBE_BUCKETS];
+    /** keep the counters of adjacent shards in distinct cache lines */
+    int64_t padding[8];
+} FFTimerProbeShard;
+
+typedef struct FFTimerProbe {
+    const char *name;
+    struct FFTimerProbe *next;
+    volatile int registered;
+    FFTimerProbeShard shard[FF_TIMER_PROBE_SHARDS];
+} FFTimerProbe;
+
+extern int ff_timer_probes_enabled;
+
+/**
+ * Enable or disable all timer probes.
+ */
+void ff_timer_probes_enable(int enable);
+
+/**
+ * Add a probe to the list printed by ff_timer_probes_dump().
+ * Probes are registered automatically the first time they are hit, this
+ * only needs to be called to list probes which never ran.
+ */
+void ff_timer_probe_register(FFTimerProbe *probe);
+
+/**
+ * Account one run of cycles cycles to probe.
+ */
+void ff_timer_probe_add(FFTimerProbe *probe, uint64_t cycles);
+
+/**
+ * Print the statistics of all registered probes with av_log().
+ */
+void ff_timer_probes_dump(void *avcl, int level);
+
+/**
+ * Reset the statistics of all registered probes.
+ * Runs accounted concurrently may be partially lost.
+ */
+void ff_timer_probes_reset(void);
+
+#ifdef AV_READ_TIME
+#define FF_TIMER_PROBE(var, name) static FFTimerProbe var = { name }
+#define FF_TIMER_PROBE_START(var) \
+    uint64_t var ## _tstart = ff_timer_probes_enabled ? AV_READ_TIME() : 0
+#define FF_TIMER_PROBE_STOP(var) do {                                   \
+    if (var ## _tstart)                                                 \
+        ff_timer_probe_add(&var, AV_READ_TIME() - var ## _tstart);      \
+} while (0)
+#else
+#define FF_TIMER_PROBE(var, name) extern int ff_timer_probes_enabled
+#define FF_TIMER_PROBE_START(var)
+#define FF_TIMER_PROBE_STOP(var) do { } while (0)
+#endif
+
 #endif /* AVUTIL_TIMER_H */
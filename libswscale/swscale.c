@@ -67,6 +67,7 @@ untested special converters
 #include "libavutil/mathematics.h"
 #include "libavutil/bswap.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/timer.h"
 
 
 #define RGB2YUV_SHIFT 15
@@ -2484,6 +2485,8 @@ find_c_packed_planar_out_funcs(SwsContext *c,
 #define DEBUG_SWSCALE_BUFFERS 0
 #define DEBUG_BUFFERS(...) if (DEBUG_SWSCALE_BUFFERS) av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
+FF_TIMER_PROBE(swscale_probe, "swScale");
+
 static int swScale(SwsContext *c, const uint8_t* src[],
                    int srcStride[], int srcSliceY,
                    int srcSliceH, uint8_t* dst[], int dstStride[])
@@ -2538,6 +2541,7 @@ static int swScale(SwsContext *c, const uint8_t* src[],
     int chrBufIndex= c->chrBufIndex;
     int lastInLumBuf= c->lastInLumBuf;
     int lastInChrBuf= c->lastInChrBuf;
+    FF_TIMER_PROBE_START(swscale_probe);
 
     if (isPacked(c->srcFormat)) {
         src[0]=
@@ -2749,6 +2753,7 @@ static int swScale(SwsContext *c, const uint8_t* src[],
     c->lastInLumBuf= lastInLumBuf;
     c->lastInChrBuf= lastInChrBuf;
 
+    FF_TIMER_PROBE_STOP(swscale_probe);
     return dstY - lastDstY;
 }
 
@@ -97,6 +97,11 @@ do_video_encoding h263.avi "-qscale 10 -s 352x288 -an -vcodec h263"
 do_video_decoding
 fi
 
+if [ -n "$do_h263ir" ] ; then
+do_video_encoding h263-ir.avi "-qscale 10 -g 12 -flags2 +intra_refresh -s 352x288 -an -vcodec h263"
+do_video_decoding
+fi
+
 if [ -n "$do_h263p" ] ; then
 do_video_encoding h263p.avi "-qscale 2 -flags +umv+aiv+aic -s 352x288 -an -vcodec h263p -ps 300"
 do_video_decoding
@@ -115,6 +120,12 @@ fi
 if [ -n "$do_rc" ] ; then
 do_video_encoding mpeg4-rc.avi "-b 400k -bf 2 -an -vcodec mpeg4"
 do_video_decoding
+
+do_video_encoding mpeg4-lookahead.avi "-b 400k -bf 2 -lookahead 8 -an -vcodec mpeg4"
+do_video_decoding
+
+do_video_encoding mpeg4-2pass-seg.avi "-b 2000k -bf 2 -pass_segments 2 -passlogfile ${outfile}mpeg4-2pass-seg -an -vcodec mpeg4"
+do_video_decoding
 fi
 
 if [ -n "$do_mpeg4adv" ] ; then
@@ -131,9 +142,22 @@ do_video_encoding mpeg4-Q.avi "-qscale 7 -flags +mv4+qpel -mbd 2 -bf 2 -cmp 1 -s
 do_video_decoding
 fi
 
+if [ -n "$do_mpeg4ir" ] ; then
+do_video_encoding mpeg4-ir.avi "-b 400k -g 12 -flags +mv4 -flags2 +intra_refresh -mbd bits -an -vcodec mpeg4"
+do_video_decoding
+fi
+
+if [ -n "$do_mpeg4pa" ] ; then
+do_video_encoding mpeg4-pa.avi "-b 400k -preanalysis 1 -sc_threshold -90 -an -vcodec mpeg4"
+do_video_decoding
+fi
+
 if [ -n "$do_mpeg4thread" ] ; then
 do_video_encoding mpeg4-thread.avi "-b 500k -flags +mv4+part+aic -trellis 1 -mbd bits -ps 200 -bf 2 -an -vcodec mpeg4 -threads 2"
 do_video_decoding
+
+do_video_encoding mpeg4-bstrategy.avi "-qscale 8 -bf 3 -b_strategy 2 -an -vcodec mpeg4 -threads 2"
+do_video_decoding
 fi
 
 if [ -n "$do_error" ] ; then
@@ -156,6 +180,12 @@ do_video_encoding mjpeg.avi "-qscale 9 -an -vcodec mjpeg -pix_fmt yuvj420p"
 do_video_decoding "" "-pix_fmt yuv420p"
 fi
 
+if [ -n "$do_mjpegthread" ] ; then
+do_video_encoding mjpeg-rst.avi "-qscale 9 -an -vcodec mjpeg -pix_fmt yuvj420p -restart_rows 2"
+do_video_decoding "-threads 3 -thread_type slice" "-pix_fmt yuv420p"
+do_video_decoding "-threads 3 -thread_type frame" "-pix_fmt yuv420p"
+fi
+
 if [ -n "$do_ljpeg" ] ; then
 do_video_encoding ljpeg.avi "-an -vcodec ljpeg -strict -1"
 do_video_decoding
@@ -166,6 +196,11 @@ do_video_encoding jpegls.avi "-an -vcodec jpegls -vtag MJPG -sws_flags neighbor+
 do_video_decoding "" "-pix_fmt yuv420p  -sws_flags area+bitexact"
 fi
 
+if [ -n "$do_pngthread" ] ; then
+do_video_encoding png-thread.avi "-an -vcodec png -sws_flags neighbor+full_chroma_int+accurate_rnd+bitexact"
+do_video_decoding "-threads 3 -thread_type frame" "-pix_fmt yuv420p -sws_flags area+bitexact"
+fi
+
 if [ -n "$do_rv10" ] ; then
 do_video_encoding rv10.rm "-qscale 10 -an"
 do_video_decoding
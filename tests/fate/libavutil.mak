@@ -8,6 +8,11 @@ fate-aes: libavutil/aes-test$(EXESUF)
 fate-aes: CMD = run libavutil/aes-test
 fate-aes: REF = /dev/null
 
+FATE_TESTS += fate-atomic
+fate-atomic: libavutil/atomic-test$(EXESUF)
+fate-atomic: CMD = run libavutil/atomic-test
+fate-atomic: REF = /dev/null
+
 FATE_TESTS += fate-base64
 fate-base64: libavutil/base64-test$(EXESUF)
 fate-base64: CMD = run libavutil/base64-test
@@ -32,3 +37,7 @@ fate-md5: CMD = run libavutil/md5-test
 FATE_TESTS += fate-sha
 fate-sha: libavutil/sha-test$(EXESUF)
 fate-sha: CMD = run libavutil/sha-test
+
+FATE_TESTS += fate-spsc_fifo
+fate-spsc_fifo: libavutil/spsc_fifo-test$(EXESUF)
+fate-spsc_fifo: CMD = run libavutil/spsc_fifo-test
@@ -222,3 +222,11 @@ fate-musepack7: FUZZ = 1
 FATE_TESTS += fate-iirfilter
 fate-iirfilter: libavcodec/iirfilter-test$(EXESUF)
 fate-iirfilter: CMD = run libavcodec/iirfilter-test
+
+FATE_TESTS += fate-cabac
+fate-cabac: libavcodec/cabac-test$(EXESUF)
+fate-cabac: CMD = run libavcodec/cabac-test
+
+FATE_TESTS += fate-me-cmp
+fate-me-cmp: libavcodec/me-cmp-test$(EXESUF)
+fate-me-cmp: CMD = run libavcodec/me-cmp-test
@@ -69,6 +69,22 @@ do_lavfi_pixfmts "pad"     "500:400:20:20"
 do_lavfi_pixfmts "scale"   "200:100"
 do_lavfi_pixfmts "vflip"   ""
 
+if [ -n "$do_hqdn3d" ]; then
+    for pix_fmt in yuv420p yuv422p yuv420p9 yuv420p10 yuv422p10 yuv420p16; do
+        out_fmt=$pix_fmt
+        test $pix_fmt = ${pix_fmt%p} && out_fmt=${pix_fmt}le
+        for threads in 1 3; do
+            do_video_filter ${pix_fmt}_t$threads "slicify=random,format=$pix_fmt,hqdn3d=4:3:6:4.5" -pix_fmt $out_fmt -filter_threads $threads
+        done
+    done
+    # signed PCM read as 16 bit video has full scale steps at zero crossings
+    for threads in 1 3; do
+        printf '%-20s' fullscale16_t$threads
+        run_ffmpeg $DEC_OPTS -f rawvideo -pix_fmt yuv420p16le -s 128x96 -i $pcm_src $ENC_OPTS \
+            -vf hqdn3d=4:3:6:6 -filter_threads $threads -vcodec rawvideo -pix_fmt yuv420p16le -f nut md5:
+    done
+fi
+
 if [ -n "$do_pixdesc" ]; then
     pix_fmts="$($ffmpeg -pix_fmts list 2>/dev/null | sed -ne '9,$p' | grep '^IO' | cut -d' ' -f2 | sort)"
     for pix_fmt in $pix_fmts; do